@@ -4,9 +4,73 @@
 
 #include <paths/long/large/Lines.h>
 #include "GFADump.h"
+#include "GFAWriter.h"
+#include "paths/FrozenHBV.h"
 
+template <class PathVec>
+void CountSegmentReads(FrozenHBV const &g, PathVec const &paths, std::vector<uint64_t> &counts){
+    int64_t const nEdges=g.E();
+    //counted on the canonical edge, min(e,inv[e]), so a read whose path takes both strands counts once
+    auto canonical=[&g](int e){ return std::min(e,g.Inv(e)); };
+    std::vector<uint64_t> reads(nEdges,0);
+    int64_t const nPaths=paths.size();
+    #pragma omp parallel for schedule(dynamic,10000)
+    for (int64_t id=0;id<nPaths;++id){
+        auto const &path=paths[id];
+        for (size_t i=0;i<path.size();++i){
+            int e=path[i];
+            if (e<0 || e>=nEdges)
+                FatalErr("The path of read " << id << " has edge " << e << ", but the graph has only " << nEdges
+                         << " edges: the paths don't belong to this graph.");
+            int c=canonical(e);
+            if (std::none_of(path.begin(),path.begin()+i,[&](int f){ return canonical(f)==c; })){
+                #pragma omp atomic
+                reads[c]+=1;
+            }
+        }
+    }
+    counts.resize(nEdges);
+    #pragma omp parallel for schedule(static,10000)
+    for (int64_t e=0;e<nEdges;++e)
+        counts[e]=reads[canonical(e)];
+}
+
+void WriteGFALinks(GFAWriter &out, FrozenHBV const &g, std::vector<char> const &is_rc){
+    out.write(g.E(), [&](size_t e, std::string& buf) {
+        //only process the canonical edge
+        if (is_rc[e]) return;
+
+        std::vector<uint64_t> all_next;
+        for (auto n:g.Next(e)) all_next.push_back(n);
+        for (auto pi:g.Prev(g.Inv(e))) all_next.push_back(g.Inv(pi));
+        std::sort(all_next.begin(),all_next.end());
+        all_next.erase(std::unique(all_next.begin(),all_next.end()),all_next.end());
+
+        for (auto n:all_next){
+            //only process if the canonical of the connection is greater (i.e. only processing "canonical connections")
+            uint64_t cn=(is_rc[n] ? g.Inv(n) : n);
+            if (cn<e) continue;
+            GFAWriter::appendLink(buf, e, true, cn, cn==n);
+        }
+
+        std::vector<uint64_t> all_prev;
+        for (auto p:g.Prev(e)) all_prev.push_back(p);
+        for (auto ni:g.Next(g.Inv(e))) all_prev.push_back(g.Inv(ni));
+        std::sort(all_prev.begin(),all_prev.end());
+        all_prev.erase(std::unique(all_prev.begin(),all_prev.end()),all_prev.end());
+
+        for (auto p:all_prev){
+            //only process if the canonical of the connection is greater (i.e. only processing "canonical connections")
+            uint64_t cp=(is_rc[p] ? g.Inv(p) : p);
+            if (cp<e) continue;
+            GFAWriter::appendLink(buf, e, false, cp, cp!=p);
+        }
+    });
+}
+
+template <class PathVec>
 void GFADump (std::string filename, const HyperBasevector &hb, const vec<int> &inv, const
-ReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lines){
+PathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lines, bool read_tags, bool path_lines){
 
     std::vector<std::string> colour_names={
             "aliceblue",
@@ -151,57 +215,61 @@ ReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lin
     };
     std::cout<<std::endl<<std::endl<<std::endl<<"============GFA DUMP STARTING============"<<std::endl;
     std::cout<<"Graph has "<< hb.EdgeObjectCount() <<" edges"<<std::endl;
+    int64_t const nEdges=hb.EdgeObjectCount();
+    FrozenHBV g(hb,&inv);
+
+    //edges that are the reverse complement of their canonical form are only written through their inv
+    std::vector<char> is_rc(nEdges);
+    #pragma omp parallel for schedule(static,10000)
+    for (int64_t e=0;e<nEdges;++e)
+        is_rc[e]=(hb.EdgeObject(e).getCanonicalForm()==CanonicalForm::REV);
+
+    std::vector<uint64_t> read_counts;
+    if (read_tags) {
+        std::cout<<"Counting reads on segments"<<std::endl;
+        CountSegmentReads(g, paths, read_counts);
+    }
+    auto segment_tags=[&read_counts](uint64_t e){ return read_counts.empty() ? nullptr : &read_counts[e]; };
+
     vec<vec<vec<vec<int>>>> lines;
-    vec<int> to_left, to_right;
-    hb.ToLeft(to_left), hb.ToRight(to_right);
-    std::vector<int64_t> colour(hb.EdgeObjectCount(), -1);
+    std::vector<int64_t> colour(nEdges, -1);
 
     if (find_lines) {
-        Ofstream(gfa_out, filename + "_lines.gfa");
         FindLines(hb, inv, lines, MAX_CELL_PATHS, MAX_DEPTH);
         SortLines(lines, hb, inv);
 
-
-        gfa_out << "H\tVN:Z:1.0" << std::endl;
-        std::vector<int64_t> canonical_included(hb.EdgeObjectCount(), -1);
+        //The walk over the lines decides what goes in the file, and in which order; the records are only
+        //turned into text afterwards, in parallel. A segment record is (edge,colour), a link (from,to).
+        struct Record { uint64_t a, b; bool a_fw, b_fw, segment; };
+        std::vector<Record> records;
+        std::vector<int64_t> canonical_included(nEdges, -1);
 
         int64_t current_colour = 1;
         //TODO: Dump the overlaps correctly
         //First step, mark Edges as used if they appear in a line
-        for (auto line : lines) {
+        for (auto const& line : lines) {
             std::vector<std::pair<uint64_t, bool>> prev_segment_end_edges;
-            for (auto segment : line) {//or cell, or bubble
+            for (auto const& segment : line) {//or cell, or bubble
                 std::vector<std::pair<uint64_t, bool>> end_edges;
-                for (auto path : segment) {//or unitig?-ish
+                for (auto const& path : segment) {//or unitig?-ish
                     if (path.empty()) {//empty path (i.e., gap!)
                         end_edges = prev_segment_end_edges;//HACK to not disconnect
                     }
                     else {
                         int64_t prev_in_path = -1;
-                        bool prev_in_path_fw;
+                        bool prev_in_path_fw = false;
                         for (auto edge: path) {
                             if (canonical_included[edge] == -1) {
-                                uint64_t ce = edge;
-                                auto eo=hb.EdgeObject(edge);
-                                if (eo.getCanonicalForm()==CanonicalForm::REV) {
-                                    ce = inv[edge];
-                                    eo=hb.EdgeObject(ce);
-                                }
+                                uint64_t ce = (is_rc[edge] ? inv[edge] : edge);
                                 canonical_included[edge] = ce;
                                 canonical_included[inv[edge]] = ce;
-                                gfa_out << "S\tedge" << ce << "\t" << hb.EdgeObject(ce) << "\tCL:z:" <<
-                                colour_names[current_colour % colour_names.size()] << std::endl;
+                                records.push_back({ce, uint64_t(current_colour), true, true, true});
                                 colour[ce] = current_colour;
                                 colour[inv[ce]] = current_colour;
-                                //std::cout<<"edge"<<ce<<": "<<colour_names[current_colour%colour_names.size()]<<std::endl;
-                            } //else {
-                            //colour[canonical_included[edge]]=0;
-                            //std::cout<<"edge"<<canonical_included[edge]<<": black"<<std::endl;
-                            //}
+                            }
                             if (prev_in_path != -1) {
-                                gfa_out << "L\tedge" << prev_in_path << (prev_in_path_fw ? "\t+\tedge" : "\t-\tedge") <<
-                                canonical_included[edge] << ((canonical_included[edge] == edge) ? "\t+" : "\t-") <<
-                                "\t0M" << std::endl;
+                                records.push_back({uint64_t(prev_in_path), uint64_t(canonical_included[edge]),
+                                                   prev_in_path_fw, canonical_included[edge] == edge, false});
                             }
                             prev_in_path = canonical_included[edge];
                             prev_in_path_fw = (canonical_included[edge] == edge);
@@ -210,9 +278,8 @@ ReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lin
                         //Connect all previous elements to the first element in the path
                         uint64_t ce = canonical_included[path[0]];
                         bool ce_fw = (ce == path[0]);
-                        for (auto pe:prev_segment_end_edges) {
-                            gfa_out << "L\tedge" << pe.first << (pe.second ? "\t+\tedge" : "\t-\tedge") << ce <<
-                            (ce_fw ? "\t+" : "\t-") << "\t0M" << std::endl;
+                        for (auto const& pe:prev_segment_end_edges) {
+                            records.push_back({pe.first, ce, pe.second, ce_fw, false});
                         }
                         //add last element in the path to the end_elements
                         end_edges.push_back(std::make_pair(prev_in_path, prev_in_path_fw));
@@ -223,68 +290,52 @@ ReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lin
             }
             ++current_colour;
         }
-    }
-    Ofstream(gfa_raw_out,filename+"_raw.gfa");
-    std::cout<<"Dumping edges"<<std::endl;
-    for (auto ei=0;ei<hb.EdgeObjectCount();++ei){
-        auto eo=hb.EdgeObject(ei);
-        if (eo.getCanonicalForm()==CanonicalForm::REV) continue;
-        gfa_raw_out << "S\tedge" << ei <<"\t"<< eo
-        << "\tCL:z:"<< (colour[ei]>0 ? colour_names[colour[ei]%colour_names.size()] : "black" )
-         << std::endl;
-
-    }
-    std::cout<<"Dumping connections"<<std::endl;
-    std::vector<std::vector<uint64_t>> next_edges,prev_edges;
-    //TODO: this is stupid duplication of the digraph class, but it's so weird!!!
-    prev_edges.resize(to_left.size());
-    next_edges.resize(to_right.size());
-    for (auto e=0;e<to_left.size();++e){
-
-        uint64_t prev_node=to_left[e];
-
-        prev_edges[e].resize(hb.ToSize(prev_node));
-        for (int i=0;i<hb.ToSize(prev_node);++i){
-            prev_edges[e][i]=hb.EdgeObjectIndexByIndexTo(prev_node,i);
-        }
 
-        uint64_t next_node=to_right[e];
-
-        next_edges[e].resize(hb.FromSize(next_node));
-        for (int i=0;i<hb.FromSize(next_node);++i){
-            next_edges[e][i]=hb.EdgeObjectIndexByIndexFrom(next_node,i);
+        GFAWriter gfa_out(filename + "_lines.gfa");
+        gfa_out.put("H\tVN:Z:1.0\n");
+        gfa_out.write(records.size(), [&](size_t idx, std::string& out) {
+            Record const& r = records[idx];
+            if (r.segment)
+                GFAWriter::appendSegment(out, r.a, hb.EdgeObject(r.a),
+                                         colour_names[r.b % colour_names.size()].c_str(), segment_tags(r.a));
+            else
+                GFAWriter::appendLink(out, r.a, r.a_fw, r.b, r.b_fw);
+        });
+        if (path_lines) {
+            //each line as a path, through the first path of each of its cells, passing over gaps
+            gfa_out.write(lines.size(), [&](size_t idx, std::string& out) {
+                std::vector<std::pair<uint64_t, bool>> segments;
+                for (auto const& segment : lines[idx]) {
+                    if (segment.empty() or segment[0].empty()) continue;
+                    for (auto edge : segment[0])
+                        segments.push_back(std::make_pair(canonical_included[edge], canonical_included[edge] == edge));
+                }
+                if (!segments.empty()) GFAWriter::appendPath(out, "line" + std::to_string(idx), segments);
+            });
         }
     }
-    for (uint64_t e=0;e<next_edges.size();e++) {
-        //only process the canonical edge
-        auto eo=hb.EdgeObject(e);
-        if (eo.getCanonicalForm()==CanonicalForm::REV) continue;
 
-        std::set<uint64_t> all_next;
-        all_next.insert(next_edges[e].begin(),next_edges[e].end());
-        for (auto pi:prev_edges[inv[e]]) all_next.insert(inv[pi]);
-
-        for (auto n:all_next){
-            //only process if the canonical of the connection is greater (i.e. only processing "canonical connections")
-
-            uint64_t cn=(hb.EdgeObject(n).getCanonicalForm()!=CanonicalForm::REV ? n:inv[n]);
-            if (cn<e) continue;
-            gfa_raw_out << "L\tedge" << e << "\t+\tedge" << cn << (cn==n ? "\t+" : "\t-") << "\t0M" << std::endl;
-        }
+    GFAWriter gfa_raw_out(filename+"_raw.gfa");
+    std::cout<<"Dumping edges"<<std::endl;
+    gfa_raw_out.write(nEdges, [&](size_t ei, std::string& out) {
+        if (is_rc[ei]) return;
+        GFAWriter::appendSegment(out, ei, hb.EdgeObject(ei),
+                                 colour[ei]>0 ? colour_names[colour[ei]%colour_names.size()].c_str() : "black",
+                                 segment_tags(ei));
+    });
+    std::cout<<"Dumping connections"<<std::endl;
+    WriteGFALinks(gfa_raw_out, g, is_rc);
+    gfa_raw_out.close();
 
-        std::set<uint64_t> all_prev;
-        all_prev.insert(prev_edges[e].begin(),prev_edges[e].end());
-        for (auto ni:next_edges[inv[e]]) all_prev.insert(inv[ni]);
 
-        for (auto p:all_prev){
-            //only process if the canonical of the connection is greater (i.e. only processing "canonical connections")
-            uint64_t cp=(hb.EdgeObject(p).getCanonicalForm()!=CanonicalForm::REV?p:inv[p]);
-            if (cp<e) continue;
-            gfa_raw_out << "L\tedge" << e << "\t-\tedge" << cp << (cp==p ? "\t-" : "\t+") << "\t0M" << std::endl;
-        }
-    }
+    std::cout<<"============GFA DUMP ENDED============"<<std::endl<<std::endl<<std::endl<<std::endl;
 
+}
 
-    std::cout<<"============GFA DUMP ENDED============"<<std::endl<<std::endl<<std::endl<<std::endl;
+template void GFADump (std::string filename, const HyperBasevector &hb, const vec<int> &inv, const
+ReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lines, bool read_tags, bool path_lines);
+template void GFADump (std::string filename, const HyperBasevector &hb, const vec<int> &inv, const
+MappedReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lines, bool read_tags, bool path_lines);
 
-}
\ No newline at end of file
+template void CountSegmentReads(FrozenHBV const &g, ReadPathVec const &paths, std::vector<uint64_t> &counts);
+template void CountSegmentReads(FrozenHBV const &g, MappedReadPathVec const &paths, std::vector<uint64_t> &counts);
@@ -5,7 +5,26 @@
 #ifndef W2RAP_CONTIGGER_GFADUMP_H
 #define W2RAP_CONTIGGER_GFADUMP_H
 
+class FrozenHBV;
+class GFAWriter;
+
+// PathVec is ReadPathVec or MappedReadPathVec.
+// Writes <filename>_raw.gfa and, if find_lines, <filename>_lines.gfa. With read_tags, each segment gets an RC tag, the
+// number of reads whose paths touch it; with path_lines, each line found is also written to _lines.gfa as a P
+// record.
+template <class PathVec>
 void GFADump (std::string filename, const HyperBasevector &hb, const vec<int> &inv, const
-ReadPathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lines);
+PathVec &paths, const int MAX_CELL_PATHS, const int MAX_DEPTH, bool find_lines,
+bool read_tags=false, bool path_lines=false);
+
+//Per edge, the number of reads whose paths touch it or its reverse complement, each read counted once. (Paths
+//don't say how far a read reaches into its last edge, so there is no count of the k-mers covered.) g needs the
+//involution; a path with an edge g doesn't have is fatal.
+template <class PathVec>
+void CountSegmentReads(FrozenHBV const &g, PathVec const &paths, std::vector<uint64_t> &counts);
+
+//The L records of _raw.gfa: every connection between canonical segments, once. is_rc[e] is true for the edges
+//written through their inv. g needs the involution.
+void WriteGFALinks(GFAWriter &out, FrozenHBV const &g, std::vector<char> const &is_rc);
 
 #endif //W2RAP_CONTIGGER_GFADUMP_H
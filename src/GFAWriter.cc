@@ -0,0 +1,70 @@
+//
+// GFAWriter.cc: GFA output formatted in parallel and written in large sequential blocks.
+//
+
+#include "GFAWriter.h"
+#include "system/System.h"
+#include <omp.h>
+
+GFAWriter::GFAWriter( std::string const& filename, size_t items_per_block )
+    : mFilename(filename), mOut(filename.c_str(), std::ios::out | std::ios::binary),
+      mItemsPerBlock(std::max(items_per_block,size_t(1))),
+      mBuffers(2*std::max(omp_get_max_threads(),1))
+{
+    if ( !mOut )
+        FatalErr("Can't open " << filename << " for writing.");
+}
+
+void GFAWriter::put( std::string const& text )
+{
+    mOut.write(text.data(),text.size());
+}
+
+void GFAWriter::close()
+{
+    if ( !mOut.is_open() ) return;
+    mOut.close();
+    if ( !mOut )
+        FatalErr("Failed writing " << mFilename << '.');
+    std::vector<std::string>().swap(mBuffers);
+}
+
+void GFAWriter::appendSegment( std::string& out, uint64_t edge, basevector const& seq, char const* colour,
+                               uint64_t const* read_count )
+{
+    out += "S\tedge";
+    out += std::to_string(edge);
+    out += '\t';
+    size_t pos = out.size();
+    out.resize(pos+seq.size());
+    std::transform(seq.begin(),seq.end(),out.begin()+pos,BaseToCharMapper());
+    out += "\tCL:z:";
+    out += colour;
+    if ( read_count )
+    {   out += "\tRC:i:";
+        out += std::to_string(*read_count); }
+    out += '\n';
+}
+
+void GFAWriter::appendLink( std::string& out, uint64_t from, bool from_fw, uint64_t to, bool to_fw )
+{
+    out += "L\tedge";
+    out += std::to_string(from);
+    out += from_fw ? "\t+\tedge" : "\t-\tedge";
+    out += std::to_string(to);
+    out += to_fw ? "\t+\t0M\n" : "\t-\t0M\n";
+}
+
+void GFAWriter::appendPath( std::string& out, std::string const& name,
+                            std::vector<std::pair<uint64_t,bool>> const& segments )
+{
+    out += "P\t";
+    out += name;
+    out += '\t';
+    for ( size_t idx = 0; idx != segments.size(); ++idx )
+    {   if ( idx ) out += ',';
+        out += "edge";
+        out += std::to_string(segments[idx].first);
+        out += segments[idx].second ? '+' : '-'; }
+    out += "\t*\n";
+}
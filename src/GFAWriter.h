@@ -0,0 +1,73 @@
+//
+// GFAWriter.h: GFA output formatted in parallel and written in large sequential blocks.
+//
+
+#ifndef W2RAP_CONTIGGER_GFAWRITER_H
+#define W2RAP_CONTIGGER_GFAWRITER_H
+
+#include "Basevector.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Records are produced by a caller-supplied formatter, one item (an edge, a line, ...) at a time.  The items are
+// cut into blocks, a round of blocks is formatted in parallel, each into its own buffer, and the buffers are then
+// written in block order, so the file is byte for byte what formatting the items one after another would give.
+class GFAWriter
+{
+public:
+    explicit GFAWriter( std::string const& filename, size_t items_per_block = 4096 );
+    ~GFAWriter() { close(); }
+
+    GFAWriter( GFAWriter const& ) = delete;
+    GFAWriter& operator=( GFAWriter const& ) = delete;
+
+    // Calls format(idx,buf) for each idx in [0,nItems), appending the records for item idx to buf, and writes
+    // the results in item order.  format must be safe to call from several threads at once.
+    template <class F>
+    void write( size_t nItems, F format )
+    {
+        size_t const nBlocks = (nItems+mItemsPerBlock-1)/mItemsPerBlock;
+        for ( size_t first = 0; first < nBlocks; first += mBuffers.size() )
+        {
+            size_t const last = std::min(nBlocks,first+mBuffers.size());
+            #pragma omp parallel for schedule(dynamic,1)
+            for ( size_t blk = first; blk < last; ++blk )
+            {   std::string& buf = mBuffers[blk-first];
+                buf.clear();
+                size_t const end = std::min(nItems,(blk+1)*mItemsPerBlock);
+                for ( size_t idx = blk*mItemsPerBlock; idx != end; ++idx )
+                    format(idx,buf); }
+            for ( size_t blk = first; blk < last; ++blk )
+                put(mBuffers[blk-first]);
+        }
+    }
+
+    // Writes text as it stands.
+    void put( std::string const& text );
+
+    // Flushes and closes the file, dying if any of it couldn't be written.
+    void close();
+
+    // "S\tedge<edge>\t<seq>\tCL:z:<colour>", then "\tRC:i:<read_count>" if read_count is given, and a newline.
+    static void appendSegment( std::string& out, uint64_t edge, basevector const& seq, char const* colour,
+                               uint64_t const* read_count = nullptr );
+
+    // "L\tedge<from>\t<+|->\tedge<to>\t<+|->\t0M" and a newline.
+    static void appendLink( std::string& out, uint64_t from, bool from_fw, uint64_t to, bool to_fw );
+
+    // "P\t<name>\tedge<e1><+|->,edge<e2><+|->,...\t*" and a newline.
+    static void appendPath( std::string& out, std::string const& name,
+                            std::vector<std::pair<uint64_t,bool>> const& segments );
+
+private:
+    std::string mFilename;
+    std::ofstream mOut;
+    size_t mItemsPerBlock;
+    std::vector<std::string> mBuffers; // one round's worth
+};
+
+#endif //W2RAP_CONTIGGER_GFAWRITER_H
@@ -248,6 +248,14 @@ public:
       while ( src != end ) *dest++ = rcByte(*--src);
       return result; }
 
+    /// the same for 64 bits at a time, without the table:  complement, reverse
+    /// the bytes, then swap the nybbles and the bases within each byte
+    static unsigned long rc( unsigned long val )
+    { static_assert(sizeof(val) == 8, "64-bit unsigned long assumed");
+      val = __builtin_bswap64(~val);
+      val = ((val >> 4) & 0x0F0F0F0F0F0F0F0Ful) | ((val & 0x0F0F0F0F0F0F0F0Ful) << 4);
+      return ((val >> 2) & 0x3333333333333333ul) | ((val & 0x3333333333333333ul) << 2); }
+
     static Base const A;
     static Base const C;
     static Base const G;
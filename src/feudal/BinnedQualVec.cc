@@ -0,0 +1,112 @@
+//
+// BinnedQualVec.cc: every read's quality scores binned to four bits, in one flat array.
+//
+
+#include "feudal/BinnedQualVec.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <omp.h>
+
+void BinnedQualVec::build( VecPQVec const& quals )
+{
+    // Count the scores, and note the read lengths.
+
+    size_t const nReads = quals.size();
+    mStarts.assign(nReads+1,0);
+    int const nThreads = omp_get_max_threads();
+    std::vector<uint64_t> hists(256*nThreads,0);
+    #pragma omp parallel
+    {
+        uint64_t* hist = &hists[256*omp_get_thread_num()];
+        qvec qv;
+        #pragma omp for schedule(dynamic,10000)
+        for ( size_t id = 0; id < nReads; ++id )
+        {   quals[id].unpack(&qv);
+            mStarts[id+1] = qv.size();
+            for ( unsigned char q : qv ) ++hist[q]; }
+    }
+    std::partial_sum(mStarts.begin(),mStarts.end(),mStarts.begin());
+
+    // Choose the levels:  one per score while there are more than sixteen bins, merge the adjacent pair whose
+    // merging adds least to the squared error.
+
+    struct Bin { unsigned lo, hi; uint64_t n, sum; };
+    std::vector<Bin> bins;
+    for ( unsigned q = 0; q != 256; ++q )
+    {   uint64_t n = 0;
+        for ( int thread = 0; thread != nThreads; ++thread ) n += hists[256*thread+q];
+        if ( n ) bins.push_back(Bin{q,q,n,n*q}); }
+    mExact = bins.size() <= 16;
+    while ( bins.size() > 16 )
+    {   size_t best = 0;
+        double bestCost = std::numeric_limits<double>::max();
+        for ( size_t idx = 0; idx+1 < bins.size(); ++idx )
+        {   Bin const& a = bins[idx];
+            Bin const& b = bins[idx+1];
+            double diff = double(a.sum)/a.n - double(b.sum)/b.n;
+            double cost = diff*diff*a.n*b.n/(a.n+b.n);
+            if ( cost < bestCost ) { bestCost = cost; best = idx; } }
+        Bin& a = bins[best];
+        Bin const& b = bins[best+1];
+        a.hi = b.hi;
+        a.n += b.n;
+        a.sum += b.sum;
+        bins.erase(bins.begin()+best+1); }
+    unsigned char code[256] = {};
+    memset(mLevels,0,sizeof(mLevels));
+    for ( size_t idx = 0; idx != bins.size(); ++idx )
+    {   Bin const& bin = bins[idx];
+        mLevels[idx] = (bin.sum+bin.n/2)/bin.n;
+        std::fill(code+bin.lo,code+bin.hi+1,idx); }
+
+    // Bin them.  Only a read's first and last nibbles can share a byte with another read.
+
+    mNibbles.assign((mStarts.back()+1)/2,0);
+    #pragma omp parallel
+    {
+        qvec qv;
+        #pragma omp for schedule(dynamic,10000)
+        for ( size_t id = 0; id < nReads; ++id )
+        {   quals[id].unpack(&qv);
+            uint64_t idx = mStarts[id];
+            size_t const last = qv.size()-1;
+            for ( size_t pos = 0; pos != qv.size(); ++pos, ++idx )
+            {   unsigned char val = code[qv[pos]] << ((idx&1)<<2);
+                unsigned char& byte = mNibbles[idx>>1];
+                if ( pos == 0 || pos == last )
+                {
+                    #pragma omp atomic
+                    byte |= val;
+                }
+                else
+                    byte |= val; } }
+    }
+}
+
+void BinnedQualVec::unpack( size_t id, qvec* pQV ) const
+{
+    uint64_t idx = mStarts[id];
+    unsigned const nQs = mStarts[id+1]-idx;
+    pQV->resize(nQs);
+    for ( unsigned pos = 0; pos != nQs; ++pos, ++idx )
+        (*pQV)[pos] = mLevels[nibble(idx)];
+}
+
+void BinnedQualVec::restore( VecPQVec& quals ) const
+{
+    ForceAssert(mExact);
+    size_t const nReads = size();
+    size_t const batchSize = 100000ul*omp_get_max_threads();
+    std::vector<qvec> batch;
+    quals.clear();
+    quals.reserve(nReads);
+    for ( size_t first = 0; first < nReads; first += batchSize )
+    {   size_t const last = std::min(nReads,first+batchSize);
+        batch.resize(last-first);
+        #pragma omp parallel for schedule(dynamic,10000)
+        for ( size_t id = first; id < last; ++id )
+            unpack(id,&batch[id-first]);
+        convertAppendParallel(batch.begin(),batch.end(),quals); }
+}
@@ -0,0 +1,70 @@
+//
+// BinnedQualVec.h: every read's quality scores binned to four bits, in one flat array.
+//
+
+#ifndef BINNEDQUALVEC_H
+#define BINNEDQUALVEC_H
+
+#include "Qualvector.h"
+#include "feudal/PQVec.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The quality scores of a read set, at half a byte a base, for the scorers that look a read's qualities up over
+// and over again:  unpacking from here is a table lookup per base, where a PQVec has to be decoded block by block.
+// The sixteen levels are chosen from the data.  If there are no more distinct scores than that (as with the binned
+// qualities of current Illumina instruments) nothing is lost; otherwise adjacent scores are merged, closest first
+// and weighted by their counts, and a bin stands for the mean score of the bases in it.
+class BinnedQualVec
+{
+public:
+    BinnedQualVec() : mExact(true) {}
+    explicit BinnedQualVec( VecPQVec const& quals ) { build(quals); }
+
+    BinnedQualVec( BinnedQualVec const& ) = delete;
+    BinnedQualVec& operator=( BinnedQualVec const& ) = delete;
+
+    // (Re)builds from quals, in parallel, decoding each of them twice:  once to count scores, once to bin them.
+    void build( VecPQVec const& quals );
+
+    size_t size() const { return mStarts.empty() ? 0 : mStarts.size()-1; }
+    bool empty() const { return !size(); }
+
+    // true if binning changed no score
+    bool exact() const { return mExact; }
+
+    unsigned readSize( size_t id ) const { return mStarts[id+1]-mStarts[id]; }
+
+    // the (binned) score of read id at pos
+    unsigned char operator()( size_t id, unsigned pos ) const
+    { return mLevels[nibble(mStarts[id]+pos)]; }
+
+    // the (binned) scores of read id, as PQVec::unpack would give them
+    void unpack( size_t id, qvec* pQV ) const;
+
+    // Re-encodes every read's scores into quals, in parallel, so that the PQVecs can be dropped while this
+    // stands in for them.  Only possible when exact().
+    void restore( VecPQVec& quals ) const;
+
+    // bytes held
+    size_t allocSize() const
+    { return mStarts.capacity()*sizeof(uint64_t)+mNibbles.capacity(); }
+
+private:
+    unsigned nibble( uint64_t idx ) const { return (mNibbles[idx>>1] >> ((idx&1)<<2)) & 0xf; }
+
+    std::vector<uint64_t> mStarts;       // the first nibble of each read, and one past the last read's
+    std::vector<unsigned char> mNibbles; // two to a byte, the low one first
+    unsigned char mLevels[16];           // the score each nibble stands for
+    bool mExact;
+};
+
+// Read id's qualities:  from binned if there is one, otherwise from quals.
+inline void UnpackQuals( VecPQVec const& quals, BinnedQualVec const* binned, size_t id, qvec* pQV )
+{
+    if ( binned ) binned->unpack(id,pQV);
+    else quals[id].unpack(pQV);
+}
+
+#endif // BINNEDQUALVEC_H
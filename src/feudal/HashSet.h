@@ -776,6 +776,11 @@ public:
         if ( *itr ) (*itr)->clear();
       return *this; }
 
+    /// Delete all values, and size the table afresh for cap of them.  No
+    /// locking, as for clear.
+    HashSet& reset( size_t cap, double maxLoadFactor=.75 )
+    { destroy(); init(cap,maxLoadFactor); return *this; }
+
     bool isEmptyPosition( PPHHS ppHHS ) const
     { size_type idx = ppHHS - mppHHS;
       return idx < mCapacity && !*ppHHS; }
@@ -21,6 +21,23 @@ using std::cout;
 using std::endl;
 
 MempoolFinder* MempoolFinder::gpInstance;
+#ifdef MEMPOOL_ARENA
+thread_local unsigned short MempoolArena::gCurPoolID;
+
+// An arena's free lists and spare chunks.  Every block it hands out is a whole
+// number of grains, and starts on a grain, so that a freed block will do for
+// any later request of the same number of grains.
+struct Mempool::Arena
+{
+    static size_t const GRAIN = 16;
+    static size_t nGrains( size_t siz ) { return siz ? (siz+GRAIN-1)/GRAIN : 1; }
+
+    std::vector<void*> mFreeLists; // by number of grains, linked through each block's first word
+    Chunk* mpSpareChunk;           // rewound chunks, waiting to be used again
+    size_t mMaxRetainedSize;
+};
+size_t const Mempool::Arena::GRAIN;
+#endif
 
 void* Mempool::allocate( size_t siz, size_t alignmentReq )
 {
@@ -33,6 +50,10 @@ void* Mempool::allocate( size_t siz, size_t alignmentReq )
     }
 
     SpinLocker locker(*this);
+#ifdef MEMPOOL_ARENA
+    if ( mpArena )
+        return arenaAllocate(siz,alignmentReq);
+#endif
     void* result;
     if ( !mpChunk || !(result = mpChunk->allocate(siz,alignmentReq)) )
     {
@@ -70,6 +91,18 @@ void Mempool::free( void* ppp, size_t siz )
         return;
     }
 
+#ifdef MEMPOOL_ARENA
+    if ( mpArena )
+    {
+        SpinLocker locker(*this);
+        if ( mpArena )
+        {
+            arenaFree(ppp,siz);
+            return;
+        }
+    }
+#endif
+
     Chunk* pPre = 0;
     Chunk* pChunk = 0;
 
@@ -104,6 +137,11 @@ void Mempool::free( void* ppp, size_t siz )
 
 void Mempool::preAllocate( size_t nBytes )
 {
+#ifdef MEMPOOL_ARENA
+    if ( mpArena ) // an arena's rewound chunks do the job of a preallocation
+        return;
+#endif
+
     char* ppp = new char[nBytes+sizeof(Chunk)];
 #ifdef TRACK_MEMUSE
     mpMemUse->alloc(nBytes);
@@ -125,6 +163,147 @@ void Mempool::preAllocate( size_t nBytes )
     }
 }
 
+#ifdef MEMPOOL_ARENA
+void Mempool::beginArena( size_t maxRetainedSize )
+{
+    SpinLocker locker(*this);
+    if ( mpArena ) // an arena that ended with blocks still in use
+    {
+        mpArena->mMaxRetainedSize = maxRetainedSize;
+        return;
+    }
+    ForceAssertEq(mTotalSize,0ul);
+    mpArena = new Arena{std::vector<void*>(),0,maxRetainedSize};
+}
+
+void Mempool::endArena()
+{
+    SpinLocker locker(*this);
+    if ( !mpArena )
+        return;
+    // retain nothing:  the arena ends as soon as everything in it has been freed
+    mpArena->mMaxRetainedSize = 0;
+    if ( mFreeSize >= mTotalSize )
+        rewindArena();
+    else
+        cout << "Warning: Mempool arena ended with " << bytesInUse() <<
+                " bytes in use." << std::endl;
+}
+
+// with the lock held
+void* Mempool::arenaAllocate( size_t siz, size_t alignmentReq )
+{
+    AssertLe(alignmentReq,Arena::GRAIN);
+    size_t nGrains = Arena::nGrains(siz);
+    siz = nGrains*Arena::GRAIN;
+    std::vector<void*>& freeLists = mpArena->mFreeLists;
+    void* result;
+    if ( nGrains < freeLists.size() && (result = freeLists[nGrains]) )
+    {
+        freeLists[nGrains] = *static_cast<void**>(result);
+        mFreeSize -= siz;
+        return result;
+    }
+
+    // (Chunk::allocate checks for room before aligning)
+    result = mpChunk ? mpChunk->align(Arena::GRAIN) : 0;
+    if ( !mpChunk || static_cast<char*>(result)+siz > mpChunk->mEnd )
+    {
+        if ( mpArena->mpSpareChunk )
+        {
+            Chunk* pChunk = mpArena->mpSpareChunk;
+            mpArena->mpSpareChunk = pChunk->mpNext;
+            pChunk->mpNext = mpChunk;
+            mpChunk = pChunk;
+        }
+        else
+        {
+            void* ppp = new char[mChunkSize+sizeof(Chunk)];
+            mpChunk = new (ppp) Chunk(mpChunk,mChunkSize);
+#ifdef TRACK_MEMUSE
+            mpMemUse->alloc(mChunkSize);
+#endif
+            mTotalSize += mChunkSize;
+            mFreeSize += mChunkSize;
+        }
+        result = mpChunk->align(Arena::GRAIN);
+    }
+    mpChunk->mFree = static_cast<char*>(result) + siz;
+
+    mFreeSize -= siz;
+    AssertLe(mFreeSize,mTotalSize);
+    return result;
+}
+
+// with the lock held
+void Mempool::arenaFree( void* ppp, size_t siz )
+{
+    size_t nGrains = Arena::nGrains(siz);
+    mFreeSize += nGrains*Arena::GRAIN;
+    AssertLe(mFreeSize,mTotalSize);
+    if ( mFreeSize >= mTotalSize )
+    {
+        rewindArena();
+        return;
+    }
+    std::vector<void*>& freeLists = mpArena->mFreeLists;
+    if ( nGrains >= freeLists.size() )
+        freeLists.resize(nGrains+1);
+    *static_cast<void**>(ppp) = freeLists[nGrains];
+    freeLists[nGrains] = ppp;
+}
+
+// with the lock held, and nothing in use:  empties the free lists, and puts
+// every chunk, emptied, on the spare list, as far as mMaxRetainedSize allows
+void Mempool::rewindArena()
+{
+    std::fill(mpArena->mFreeLists.begin(),mpArena->mFreeLists.end(),nullptr);
+    Chunk* pChunk = mpChunk;
+    mpChunk = 0;
+    if ( pChunk )
+    {
+        Chunk* pLast = pChunk;
+        while ( pLast->mpNext )
+            pLast = pLast->mpNext;
+        pLast->mpNext = mpArena->mpSpareChunk;
+    }
+    else
+        pChunk = mpArena->mpSpareChunk;
+    mpArena->mpSpareChunk = 0;
+
+    size_t retainedSize = 0;
+    Chunk* pExcess = 0;
+    while ( pChunk )
+    {
+        Chunk* pNext = pChunk->mpNext;
+        if ( retainedSize + pChunk->size() <= mpArena->mMaxRetainedSize )
+        {
+            pChunk->mFree = static_cast<char*>(pChunk->start());
+            pChunk->mpNext = mpArena->mpSpareChunk;
+            mpArena->mpSpareChunk = pChunk;
+            retainedSize += pChunk->size();
+        }
+        else
+        {
+            pChunk->mpNext = pExcess;
+            pExcess = pChunk;
+        }
+        pChunk = pNext;
+    }
+#ifdef TRACK_MEMUSE
+    mpMemUse->free(mTotalSize-retainedSize);
+#endif
+    mTotalSize = mFreeSize = retainedSize;
+    if ( pExcess )
+        killChunkChain(pExcess);
+    if ( !mpArena->mMaxRetainedSize ) // ended
+    {
+        delete mpArena;
+        mpArena = 0;
+    }
+}
+#endif
+
 void Mempool::killChunkChain( Chunk* pChunk )
 {
     if ( pChunk->mpNext )
@@ -75,6 +75,19 @@ public:
 #endif
 
     void setChunkSize( size_t chunkSize ) { mChunkSize = chunkSize; }
+
+#ifdef MEMPOOL_ARENA
+    /// Makes a fresh pool into an arena (see MempoolArena).  An arena keeps
+    /// the blocks freed into it on free lists by size, and hands them out
+    /// again.  When everything in it has been freed, it rewinds its chunks
+    /// for reuse instead of giving them back to the heap, keeping no more than
+    /// maxRetainedSize bytes of them.
+    void beginArena( size_t maxRetainedSize );
+
+    /// Ends an arena:  its chunks go back to the heap now, or, if some of its
+    /// memory is still in use, as soon as that has been freed.
+    void endArena();
+#endif
     size_t getMaxEnchunkableSize() const
     { return mChunkSize/MIN_ALLOCS_PER_CHUNK; }
 
@@ -133,6 +146,12 @@ private:
     };
 
     void preAllocate( size_t nBytes );
+#ifdef MEMPOOL_ARENA
+    struct Arena;
+    void* arenaAllocate( size_t siz, size_t alignmentReq );
+    void arenaFree( void* ppp, size_t siz );
+    void rewindArena();
+#endif
     bool tooBig( size_t siz ) const { return siz > getMaxEnchunkableSize(); }
     void killChunkChain( Chunk* );
     static void reportUnusedPreallocation( Chunk* );
@@ -145,9 +164,12 @@ private:
     size_t mRefCount;
 #ifdef TRACK_MEMUSE
     MemUse* mpMemUse = nullptr;
-#else
+#elif !defined(MEMPOOL_ARENA)
     size_t mPadding; //bump to 64 bytes to avoid cache-line sharing
 #endif
+#ifdef MEMPOOL_ARENA
+    Arena* mpArena = nullptr; // null unless this pool is an arena
+#endif
 
     // 2Mb less a little in case exact powers of 2 are inefficient
     static size_t const DEFAULT_CHUNK_SIZE = 2*1024*1024 - 24 - sizeof(Chunk);
@@ -214,6 +236,84 @@ private:
     static MempoolFinder* gpInstance;
 };
 
+#ifdef MEMPOOL_ARENA
+/// A pool that one thread uses as scratch space for a unit of work that
+/// allocates and frees a lot, like a local assembly.  While a Scope on an arena
+/// is alive, the MempoolAllocators that its thread default-constructs, and the
+/// MempoolOwners it makes, draw from the arena instead of from the heap or from
+/// a pool of their own.  Memory freed during the work is reused by the work,
+/// and once all of it has been freed the arena's chunks are rewound for the
+/// next unit of work.  Anything that has to outlive the work must be built
+/// under a Suspend.
+class MempoolArena
+{
+public:
+    explicit MempoolArena( size_t maxRetainedSize = DEFAULT_MAX_RETAINED_SIZE )
+    : mPoolID(MempoolFinder::getInstance().allocatePool())
+    { Mempool* pPool = getPool();
+      pPool->ref();
+      pPool->beginArena(maxRetainedSize); }
+
+    MempoolArena( MempoolArena const& )=delete;
+    MempoolArena& operator=( MempoolArena const& )=delete;
+
+    ~MempoolArena()
+    { Mempool* pPool = getPool();
+      pPool->endArena();
+      if ( !pPool->deref() )
+        MempoolFinder::getInstance().freePool(mPoolID); }
+
+    size_t bytesInUse() const { return getPool()->bytesInUse(); }
+
+    /// Routes the calling thread's default allocations to an arena.
+    class Scope
+    {
+    public:
+        explicit Scope( MempoolArena& arena ) : mSavedPoolID(gCurPoolID)
+        { gCurPoolID = arena.mPoolID; }
+
+        Scope( Scope const& )=delete;
+        Scope& operator=( Scope const& )=delete;
+
+        ~Scope() { gCurPoolID = mSavedPoolID; }
+
+    private:
+        unsigned short mSavedPoolID;
+    };
+
+    /// Sends the calling thread's default allocations back to the heap, to
+    /// build something that outlives an enclosing Scope.
+    class Suspend
+    {
+    public:
+        Suspend() : mSavedPoolID(gCurPoolID) { gCurPoolID = 0; }
+
+        Suspend( Suspend const& )=delete;
+        Suspend& operator=( Suspend const& )=delete;
+
+        ~Suspend() { gCurPoolID = mSavedPoolID; }
+
+    private:
+        unsigned short mSavedPoolID;
+    };
+
+    /// The pool the calling thread allocates from by default:  0 (i.e., the
+    /// heap) unless a Scope is alive.
+    static unsigned short currentPoolID() { return gCurPoolID; }
+
+    // eight default-sized chunks
+    static size_t const DEFAULT_MAX_RETAINED_SIZE = 16*1024*1024;
+
+private:
+    Mempool* getPool() const
+    { return MempoolFinder::getInstance().resolvePool(mPoolID); }
+
+    unsigned short mPoolID;
+
+    static thread_local unsigned short gCurPoolID;
+};
+#endif
+
 template <class T>
 class MempoolAllocator
 {
@@ -232,7 +332,11 @@ public:
         typedef MempoolAllocator<U> other;
     };
 
+#ifndef MEMPOOL_ARENA
     MempoolAllocator() : mPoolID(0) {}
+#else
+    MempoolAllocator() : mPoolID(MempoolArena::currentPoolID()) {}
+#endif
     template<typename U> MempoolAllocator( MempoolAllocator<U> const& that )
     : mPoolID(that.poolID())
     {}
@@ -296,7 +400,11 @@ class MempoolOwner : public MempoolAllocator<T>
     typedef MempoolAllocator<T> Base;
 public:
     MempoolOwner()
+#ifndef MEMPOOL_ARENA
     : Base(Base::finder().allocatePool())
+#else
+    : Base(ownPoolID())
+#endif
     { this->getPool()->ref(); }
 
     MempoolOwner( MempoolOwner const& mo )
@@ -310,6 +418,14 @@ public:
     friend void swap( MempoolOwner& alloc1, MempoolOwner& alloc2 )
     { swap(static_cast<Base&>(alloc1),static_cast<Base&>(alloc2)); }
 
+#ifdef MEMPOOL_ARENA
+private:
+    // inside an arena's Scope, share the arena rather than taking a new pool
+    static unsigned short ownPoolID()
+    { unsigned short poolID = MempoolArena::currentPoolID();
+      return poolID ? poolID : Base::finder().allocatePool(); }
+#endif
+
 //[GONZA] required by others but private, commenting the provate part to share the operator
 //JUST COMMENTED, operator can be inherited?
 //private:
@@ -32,6 +32,7 @@
 #include "Set.h"
 #include "VecUtilities.h"
 #include "graph/Digraph.h"
+#include "graph/EdgePaths.h"
 #include <cstddef>
 
 template<class E> vec<int> digraphE<E>:: EdgesBoundedBy( const int e1, const int e2,
@@ -1842,67 +1843,8 @@ template<class E>
 Bool digraphE<E>::EdgePaths( const vec<int>& left, const vec<int>& right,
      const int v, const int w, vec< vec<int> >& paths, const int max_copies, 
      const int max_paths, const int max_iterations ) const
-{    
-     // Pretest to determine if the computation will explode.  This only works if
-     // max_copies is not set.
-
-     if ( max_copies < 0 && ( max_paths >= 0 || max_iterations >= 0 ) )
-     {    vec<int> subs;
-          int path_count = 0;
-          for ( int i = 0; i < From(v).isize( ); i++ )
-          {    int e = EdgeObjectIndexByIndexFrom( v, i );
-               subs.push_back(e);    }
-          int iterations = 0;
-          while( subs.nonempty( ) )
-          {    if ( max_iterations > 0 && ++iterations > max_iterations ) 
-                    return False;
-               int p = subs.back( );
-               subs.pop_back( );
-               int x = right[p];
-               if ( x == w ) 
-               {    if ( max_paths >= 0 && ++path_count > max_paths ) 
-                         return False;    }
-               else
-               {    for ( int j = 0; j < From(x).isize( ); j++ )
-                    {    int e = EdgeObjectIndexByIndexFrom( x, j );
-                         subs.push_back(e);    }    }    }    }
-
-     // Now do the computation for real.
-
-     vec< vec<int> > subs;
-     paths.clear( );
-     for ( int i = 0; i < From(v).isize( ); i++ )
-     {    int e = EdgeObjectIndexByIndexFrom( v, i );
-          vec<int> one;
-          one.push_back(e);
-          subs.push_back(one);    }
-     int iterations = 0;
-     while( subs.nonempty( ) )
-     {    if ( max_iterations > 0 && ++iterations > max_iterations ) return False;
-          vec<int> p = subs.back( );
-          subs.resize( subs.isize( ) - 1 );
-          int x = right[ p.back( ) ];
-          if ( x == w ) 
-          {    paths.push_back(p);
-               if ( max_paths >= 0 && paths.isize( ) > max_paths ) return False;    }
-          else
-          {    for ( int j = 0; j < From(x).isize( ); j++ )
-               {    int e = EdgeObjectIndexByIndexFrom( x, j );
-                    vec<int> pp(p);
-                    pp.push_back(e);
-                    if ( max_copies >= 0 )
-                    {    vec<int> pps(pp);
-                         Sort(pps);
-                         Bool fail = False;
-                         for ( int r = 0; r < pps.isize( ); r++ )
-                         {    int s = pps.NextDiff(r);
-                              if ( s - r > max_copies )
-                              {    fail = True;
-                                   break;    }
-                              r = s - 1;    }
-                         if (fail) continue;    }
-                    subs.push_back(pp);    }    }    }
-     return True;    }
+{    return EdgePathsIn( [this]( int x ) -> const vec<int>& { return FromEdgeObj(x); },
+          right, v, w, paths, max_copies, max_paths, max_iterations );    }
 
 template<class E>
 Bool digraphE<E>::EdgePaths( const int v, const int w, vec< vec<int> >& paths,
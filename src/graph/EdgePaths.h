@@ -0,0 +1,77 @@
+//
+// EdgePaths.h: the body of digraphE::EdgePaths, for any graph that can list the edges leaving a vertex.
+//
+
+#ifndef EDGE_PATHS_H
+#define EDGE_PATHS_H
+
+#include "CoreTools.h"
+
+// Find all paths from vertex v to w, as lists of edges, searching depth-first.  from_edges(x) gives the edges
+// leaving vertex x (anything with isize() and operator[]), and right[e] the vertex edge e enters.  The limits
+// are those of digraphE::EdgePaths, which this is the body of.
+
+template <class FromEdges, class Right>
+Bool EdgePathsIn( const FromEdges& from_edges, const Right& right,
+     const int v, const int w, vec< vec<int> >& paths, const int max_copies,
+     const int max_paths, const int max_iterations )
+{
+     // Pretest to determine if the computation will explode.  This only works if
+     // max_copies is not set.
+
+     if ( max_copies < 0 && ( max_paths >= 0 || max_iterations >= 0 ) )
+     {    vec<int> subs;
+          int path_count = 0;
+          for ( int i = 0; i < from_edges(v).isize( ); i++ )
+               subs.push_back( from_edges(v)[i] );
+          int iterations = 0;
+          while( subs.nonempty( ) )
+          {    if ( max_iterations > 0 && ++iterations > max_iterations )
+                    return False;
+               int p = subs.back( );
+               subs.pop_back( );
+               int x = right[p];
+               if ( x == w )
+               {    if ( max_paths >= 0 && ++path_count > max_paths )
+                         return False;    }
+               else
+               {    for ( int j = 0; j < from_edges(x).isize( ); j++ )
+                         subs.push_back( from_edges(x)[j] );    }    }    }
+
+     // Now do the computation for real.
+
+     vec< vec<int> > subs;
+     paths.clear( );
+     for ( int i = 0; i < from_edges(v).isize( ); i++ )
+     {    vec<int> one;
+          one.push_back( from_edges(v)[i] );
+          subs.push_back(one);    }
+     int iterations = 0;
+     while( subs.nonempty( ) )
+     {    if ( max_iterations > 0 && ++iterations > max_iterations ) return False;
+          vec<int> p = subs.back( );
+          subs.resize( subs.isize( ) - 1 );
+          int x = right[ p.back( ) ];
+          if ( x == w )
+          {    paths.push_back(p);
+               if ( max_paths >= 0 && paths.isize( ) > max_paths ) return False;    }
+          else
+          {    for ( int j = 0; j < from_edges(x).isize( ); j++ )
+               {    int e = from_edges(x)[j];
+                    vec<int> pp(p);
+                    pp.push_back(e);
+                    if ( max_copies >= 0 )
+                    {    vec<int> pps(pp);
+                         Sort(pps);
+                         Bool fail = False;
+                         for ( int r = 0; r < pps.isize( ); r++ )
+                         {    int s = pps.NextDiff(r);
+                              if ( s - r > max_copies )
+                              {    fail = True;
+                                   break;    }
+                              r = s - 1;    }
+                         if (fail) continue;    }
+                    subs.push_back(pp);    }    }    }
+     return True;    }
+
+#endif
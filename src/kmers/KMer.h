@@ -161,7 +161,23 @@ public:
       if ( UNUSED_TRAILING_BITS ) *oItr = val << UNUSED_TRAILING_BITS;
       return *this; }
 
-    CanonicalForm getCanonicalForm() const { return CF<K>::getForm(begin()); }
+    // For even K, compares the kmer with its rc a word at a time, rather than
+    // a base at a time from each end.  The first word of the rc, which comes
+    // from the last word or two of the kmer, usually settles it.
+    CanonicalForm getCanonicalForm() const
+    { if ( K&1 ) return CF<K>::getForm(begin());
+      storage_type rc0 = Base::rc(mVal[STORAGE_UNITS_PER_KMER-1]);
+      if ( UNUSED_TRAILING_BITS )
+      { rc0 <<= UNUSED_TRAILING_BITS;
+        if ( STORAGE_UNITS_PER_KMER != 1 )
+          rc0 |= Base::rc(mVal[STORAGE_UNITS_PER_KMER-2]) >>
+                  ((BITS_PER_STORAGE_UNIT-UNUSED_TRAILING_BITS)%BITS_PER_STORAGE_UNIT); }
+      if ( mVal[0] != rc0 )
+        return mVal[0] < rc0 ? CanonicalForm::FWD : CanonicalForm::REV;
+      KMer krc(*this); krc.rc();
+      int result = compare(*this,krc);
+      return result < 0 ? CanonicalForm::FWD :
+              result > 0 ? CanonicalForm::REV : CanonicalForm::PALINDROME; }
 
     /// On return, the form will be FWD or PALINDROME.  The return value
     /// is the form of the kmer before canonicalization.
@@ -170,9 +186,10 @@ public:
       if ( result == CanonicalForm::REV ) rc();
       return result; }
 
-    bool isFwd() const { return CF<K>::isFwd(begin()); }
-    bool isRev() const { return CF<K>::isRev(begin()); }
-    bool isPalindrome() const { return CF<K>::isPalindrome(begin()); }
+    bool isFwd() const { return getCanonicalForm() == CanonicalForm::FWD; }
+    bool isRev() const { return getCanonicalForm() == CanonicalForm::REV; }
+    bool isPalindrome() const
+    { return (K&1) ? false : getCanonicalForm() == CanonicalForm::PALINDROME; }
 
     KMer& toPredecessor( value_type val )
     { AssertLt(val,4u);
@@ -206,12 +223,8 @@ public:
     { storage_type* beg(mVal);
       storage_type* end(beg+STORAGE_UNITS_PER_KMER);
       if ( STORAGE_UNITS_PER_KMER != 1 ) std::reverse(beg,end);
-      while ( beg != end )
-      { unsigned char* i1(reinterpret_cast<unsigned char*>(beg));
-        unsigned char* e1(reinterpret_cast<unsigned char*>(++beg));
-        while ( i1 != e1 )
-        { unsigned char tmp = Base::rcByte(*--e1);
-          *e1 = Base::rcByte(*i1); *i1++ = tmp; } }
+      for ( storage_type* itr(beg); itr != end; ++itr )
+        *itr = Base::rc(*itr);
       if ( UNUSED_TRAILING_BITS )
       { if ( STORAGE_UNITS_PER_KMER == 1 )
           mVal[0] = mVal[0] << UNUSED_TRAILING_BITS;
@@ -192,18 +192,69 @@ public:
     KmerDict& operator=( KmerDict const& ) = delete;
 
     Entry const* findEntryCanonical( KMer<K> const& kmer ) const
-    { return mKSet.lookup(kmer); }
+    { if ( isSorted() ) return sortedLookup(kmer,sortedBegin(kmer),sortedEnd(kmer));
+      if ( isFrozen() ) return frozenLookup(kmer,frozenHash(kmer));
+      return mKSet.lookup(kmer); }
 
     /// Returns null pointer if kmer isn't in dictionary.
     Entry const* findEntry( KMer<K> const& kmer ) const
-    { return mKSet.lookup( kmer.getCanonicalForm() == CanonicalForm::REV ?
-                            KMer<K>(kmer).rc() :
-                            kmer ); }
+    { return findEntryCanonical( kmer.getCanonicalForm() == CanonicalForm::REV ?
+                                    KMer<K>(kmer).rc() :
+                                    kmer ); }
+
+    /// Looks up each of the kmers in [beg,end), writing the entry (or a null
+    /// pointer) for each to out.  When the dictionary is frozen the lookups
+    /// are pipelined, with the table slots and then the entries prefetched a
+    /// batch at a time, so that their cache misses overlap.
+    void findEntries( KMer<K> const* beg, KMer<K> const* end,
+                        Entry const** out ) const;
+
+    /// Looks up every kmer of the sequence [itr,end), which must be at least K
+    /// long:  pResults gets end-itr-K+1 entries (or null pointers).
+    template <class Itr>
+    void findEntries( Itr itr, Itr const& end,
+                        std::vector<Entry const*>* pResults ) const;
+
+    /// Hints that kmer will soon be looked up.
+    void prefetch( KMer<K> const& kmer ) const
+    { if ( !isFrozen() ) return;
+      KMer<K> canon(kmer);
+      if ( canon.getCanonicalForm() == CanonicalForm::REV ) canon.rc();
+      if ( isSorted() ) __builtin_prefetch(&mSortedIndex[sortedPrefix(canon)]);
+      else __builtin_prefetch(&mFrozen[frozenSlot(frozenHash(canon))]); }
+
+    /// Builds a flat, read-only index of the entries:  an open-addressed table
+    /// of pointers to them, probed linearly, each tagged with 16 bits of its
+    /// kmer's hash so that a probe rarely has to look at an entry that isn't
+    /// the one it's after.  While the dictionary is frozen, lookups go through
+    /// the index, and cost a short run of slots (usually in one cache line)
+    /// and the entry itself.  KDefs may still be modified, but nothing can be
+    /// added or removed until the dictionary is thawed.  A sorted dictionary
+    /// is frozen already.
+    void freeze();
+
+    /// Replaces the contents of the dictionary with *pEntries, which must be
+    /// canonical, distinct, and sorted, and which are taken over (*pEntries is
+    /// left empty).  No hash set is built:  the dictionary is left frozen, and
+    /// lookups are binary searches of the array, narrowed by an index on the
+    /// kmers' leading bases.  This is the cheap way to get a dictionary from
+    /// sorted kmer counts.
+    void freezeSorted( std::vector<Entry>* pEntries );
+
+    /// Discards the index built by freeze(), or moves the entries of a sorted
+    /// dictionary into the hash set, so that the dictionary can be modified
+    /// again.  Either way, pointers to entries are invalidated.
+    void thaw();
+
+    bool isFrozen() const { return !mFrozen.empty() || isSorted(); }
+
+    /// Whether the entries are held in a sorted array, rather than a hash set.
+    bool isSorted() const { return !mSortedIndex.empty(); }
 
     /// Applies functor to entry, which will be added if not present.
     template <class Func>
     void applyCanonical( KMer<K> const& kmer, Func const& func )
-    { mKSet.apply(kmer,func); }
+    { Assert(!isFrozen()); mKSet.apply(kmer,func); }
 
     /// Returns null pointer if kmer isn't in dictionary.
     KDef* lookup( KMer<K> const& kmer )
@@ -216,22 +267,23 @@ public:
 
     /// Canonicalizes and inserts kmer, if necessary.
     KDef& operator[]( KMer<K> const& kmer )
-    { Entry const* pEnt;
+    { Assert(!isFrozen());
+      Entry const* pEnt;
       if ( kmer.getCanonicalForm() != CanonicalForm::REV ) pEnt = &mKSet[kmer];
       else pEnt = &mKSet[KMer<K>(kmer).rc()];
       return const_cast<KDef&>(pEnt->getKDef()); }
 
     /// Inserts a kmer known to be in canonical form.
     void insertCanonical( KMer<K> const& kmer )
-    { mKSet.add(kmer); }
+    { Assert(!isFrozen()); mKSet.add(kmer); }
 
     /// Inserts a canonical kmer, known to be novel, along with its entry info
     /// directly into the dictionary without further ado.
     void insertEntry( Entry const& entry )
-    { mKSet.insertUniqueValue(entry); }
+    { Assert(!isFrozen()); mKSet.insertUniqueValue(entry); }
 
     void insertEntryNoLocking( Entry const& entry )
-    { mKSet.insertUniqueValueNoLocking(entry); }
+    { Assert(!isFrozen()); mKSet.insertUniqueValueNoLocking(entry); }
 
     class BadKmerCountFunctor
     {
@@ -247,29 +299,35 @@ public:
       size_t mMinCount; size_t mMaxCount;
     };
 
-    /// Retain only entries with counts in the given range.
+    /// Retain only entries with counts in the given range.  Thaws the
+    /// dictionary.
     template <class Functor>
     void clean( Functor const& functor )
-    { mKSet.remove_if(functor);
+    { thaw();
+      mKSet.remove_if(functor);
       recomputeAdjacencies(); }
 
-    OCItr begin() const { return mKSet.begin(); }
-    OCItr end() const { return mKSet.end(); }
-    OCItr cbegin() { return mKSet.cbegin(); }
-    OCItr cend() { return mKSet.cend(); }
-    OItr begin() { return mKSet.begin(); }
-    OItr end() { return mKSet.end(); }
+    // these iterate over the hash set, which a sorted dictionary doesn't use:
+    // thaw() it first
+    OCItr begin() const { ForceAssert(!isSorted()); return mKSet.begin(); }
+    OCItr end() const { ForceAssert(!isSorted()); return mKSet.end(); }
+    OCItr cbegin() { ForceAssert(!isSorted()); return mKSet.cbegin(); }
+    OCItr cend() { ForceAssert(!isSorted()); return mKSet.cend(); }
+    OItr begin() { ForceAssert(!isSorted()); return mKSet.begin(); }
+    OItr end() { ForceAssert(!isSorted()); return mKSet.end(); }
 
-    OItr mbegin() { return mKSet.begin(); }
-    OItr mend() { return mKSet.end(); }
+    OItr mbegin() { ForceAssert(!isSorted()); return mKSet.begin(); }
+    OItr mend() { ForceAssert(!isSorted()); return mKSet.end(); }
 
-    size_t size() const { return mKSet.size(); }
+    size_t size() const { return isSorted() ? mSorted.size() : mKSet.size(); }
 
     void remove( KMer<K> const& kmer )
-    { mKSet.remove( kmer.getCanonicalForm() == CanonicalForm::REV ?
+    { Assert(!isFrozen());
+      mKSet.remove( kmer.getCanonicalForm() == CanonicalForm::REV ?
                             KMer<K>(kmer).rc() : kmer ); }
 
-    void removeCanonical( KMer<K> const& kmer ) { mKSet.remove(kmer); }
+    void removeCanonical( KMer<K> const& kmer )
+    { Assert(!isFrozen()); mKSet.remove(kmer); }
 
     void process( VirtualMasterVec<bvec> const& reads,
                         bool validate = false,
@@ -281,73 +339,299 @@ public:
                         unsigned nThreads = getConfiguredNumThreads(),
                         size_t batchSize = 10000 );
 
-    void clear() { mKSet.clear(); }
+    void clear() { discardFrozen(); mKSet.clear(); }
 
     friend void swap( KmerDict& kd1, KmerDict& kd2 )
-    { swap(kd1.mKSet,kd2.mKSet); }
+    { swap(kd1.mKSet,kd2.mKSet); kd1.mFrozen.swap(kd2.mFrozen);
+      kd1.mSorted.swap(kd2.mSorted); kd1.mSortedIndex.swap(kd2.mSortedIndex);
+      std::swap(kd1.mSortedShift,kd2.mSortedShift); }
 
+    // compares the hash sets, so neither may be sorted
     friend bool operator==( KmerDict const& kd1, KmerDict const& kd2 )
-    { return kd1.mKSet == kd2.mKSet; }
+    { ForceAssert(!kd1.isSorted() && !kd2.isSorted());
+      return kd1.mKSet == kd2.mKSet; }
 
     friend bool operator!=( KmerDict const& kd1, KmerDict const& kd2 )
     { return !(kd1==kd2); }
 
     void writeBinary( BinaryWriter& writer ) const
-    { writer.write(mKSet); }
+    { ForceAssert(!isSorted()); writer.write(mKSet); }
 
     void readBinary( BinaryReader& reader )
-    { reader.read(&mKSet); }
+    { discardFrozen(); reader.read(&mKSet); }
 
     static size_t externalSizeof() { return 0; }
 
     template <class Proc>
     void parallelForEachHHS( Proc const& proc ) const
-    { mKSet.parallelForEachHHS(proc); }
+    { ForceAssert(!isSorted()); mKSet.parallelForEachHHS(proc); }
+
+    /// Calls proc(Entry const&) for each entry, in parallel, whether the entries
+    /// are in the hash set or a sorted array.  Each thread has its own copy of
+    /// proc.
+    template <class Proc>
+    void parallelForEachEntry( Proc const& proc ) const;
 
     void recomputeAdjacencies()
-    { parallelForEachHHS(AdjProc(*this)); }
+    { parallelForEachEntry(AdjProc(*this)); }
 
     void nullEntries()
-    { parallelForEachHHS(
-                []( typename Set::HHS const& hhs )
-                { for ( Entry const& entry : hhs )
-                    const_cast<Entry&>(entry).getKDef().setNull(); }); }
+    { parallelForEachEntry(
+                []( Entry const& entry )
+                { const_cast<Entry&>(entry).getKDef().setNull(); }); }
 
 private:
+    static unsigned long const TAG_MASK = 0xfffful << 48;
+
+    // the kmer's hash, finalized so that the slot (from its high bits) and
+    // the tag (its low bits) are independent
+    static unsigned long frozenHash( KMer<K> const& kmer )
+    { unsigned long hash = kmer.hash();
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdul;
+      hash ^= hash >> 33;
+      return hash; }
+
+    size_t frozenSlot( unsigned long hash ) const
+    { return (static_cast<unsigned __int128>(hash)*mFrozen.size()) >> 64; }
+
+    Entry const* frozenProbe( KMer<K> const& kmer, unsigned long hash,
+                                size_t idx ) const
+    { unsigned long tag = hash << 48;
+      size_t nnn = mFrozen.size();
+      unsigned long slot;
+      while ( (slot = mFrozen[idx]) )
+      { if ( (slot & TAG_MASK) == tag )
+        { Entry const* pEnt = reinterpret_cast<Entry const*>(slot & ~TAG_MASK);
+          if ( static_cast<KMer<K> const&>(*pEnt) == kmer ) return pEnt; }
+        if ( ++idx == nnn ) idx = 0; }
+      return nullptr; }
+
+    Entry const* frozenLookup( KMer<K> const& kmer, unsigned long hash ) const
+    { return frozenProbe(kmer,hash,frozenSlot(hash)); }
+
+    // the leading bases of a kmer, which index the sorted array
+    size_t sortedPrefix( KMer<K> const& kmer ) const
+    { typedef typename KMer<K>::storage_type S;
+      return *reinterpret_cast<S const*>(&kmer) >> mSortedShift; }
+
+    Entry const* sortedBegin( KMer<K> const& kmer ) const
+    { return mSorted.data()+mSortedIndex[sortedPrefix(kmer)]; }
+
+    Entry const* sortedEnd( KMer<K> const& kmer ) const
+    { return mSorted.data()+mSortedIndex[sortedPrefix(kmer)+1]; }
+
+    static Entry const* sortedLookup( KMer<K> const& kmer,
+                                        Entry const* beg, Entry const* end )
+    { Entry const* itr = std::lower_bound(beg,end,kmer,
+              []( KMer<K> const& k1, KMer<K> const& k2 ) { return k1 < k2; });
+      return itr != end && static_cast<KMer<K> const&>(*itr) == kmer ?
+                itr : nullptr; }
+
+    void discardFrozen()
+    { std::vector<unsigned long>().swap(mFrozen);
+      std::vector<Entry>().swap(mSorted);
+      std::vector<size_t>().swap(mSortedIndex); }
+
+    template <class Proc>
+    class HHSProc
+    {
+    public:
+        HHSProc( Proc const& proc ) : mProc(proc) {}
+
+        void operator()( typename Set::HHS const& hhs )
+        { for ( Entry const& entry : hhs ) mProc(entry); }
+
+    private:
+        Proc mProc;
+    };
+
     class AdjProc
     {
     public:
         AdjProc( KmerDict& dict ) : mDict(dict) {}
 
-        void operator()( typename Set::HHS const& hhs )
-        { for ( auto itr=hhs.begin(),end=hhs.end(); itr != end; ++itr )
-          { KDef& kDef = const_cast<KDef&>(itr->getKDef());
-            KMerContext context = kDef.getContext();
-            if ( context.getSuccessors() )
-            { KMer<K> kmer(*itr);
-              kmer.toSuccessor(0);
-              for ( unsigned succCode = 0; succCode < 4u; ++succCode )
-              { if ( context.isSuccessor(succCode) )
-                { kmer.setBack(succCode);
-                  if ( !mDict.findEntry(kmer) )
-                    context.removeSuccessor(succCode); } } }
-            if ( context.getPredecessors() )
-            { KMer<K> kmer(*itr);
-              kmer.toPredecessor(0);
-              for ( unsigned predCode = 0; predCode < 4u; ++predCode )
-              { if ( context.isPredecessor(predCode) )
-                { kmer.setFront(predCode);
-                  if ( !mDict.findEntry(kmer) )
-                    context.removePredecessor(predCode); } } }
-            kDef.setContext(context); } }
+        void operator()( Entry const& entry )
+        { KDef& kDef = const_cast<KDef&>(entry.getKDef());
+          KMerContext context = kDef.getContext();
+          if ( context.getSuccessors() )
+          { KMer<K> kmer(entry);
+            kmer.toSuccessor(0);
+            for ( unsigned succCode = 0; succCode < 4u; ++succCode )
+            { if ( context.isSuccessor(succCode) )
+              { kmer.setBack(succCode);
+                if ( !mDict.findEntry(kmer) )
+                  context.removeSuccessor(succCode); } } }
+          if ( context.getPredecessors() )
+          { KMer<K> kmer(entry);
+            kmer.toPredecessor(0);
+            for ( unsigned predCode = 0; predCode < 4u; ++predCode )
+            { if ( context.isPredecessor(predCode) )
+              { kmer.setFront(predCode);
+                if ( !mDict.findEntry(kmer) )
+                  context.removePredecessor(predCode); } } }
+          kDef.setContext(context); }
 
     private:
         KmerDict& mDict;
     };
 
     Set mKSet;
+    std::vector<unsigned long> mFrozen;
+    std::vector<Entry> mSorted;
+    std::vector<size_t> mSortedIndex;
+    unsigned mSortedShift;
 };
 
+template <unsigned K>
+void KmerDict<K>::freeze()
+{
+    if ( isSorted() ) return;
+    // about 70% full:  long enough runs of empty slots that misses end quickly
+    size_t nSlots = mKSet.size()*10/7 + 2;
+    std::vector<unsigned long> slots(nSlots,0ul);
+    mFrozen.swap(slots);
+    unsigned long* pSlots = mFrozen.data();
+    parallelForEachHHS(
+        [this,pSlots,nSlots]( typename Set::HHS const& hhs )
+        { for ( Entry const& entry : hhs )
+          { unsigned long ptr = reinterpret_cast<unsigned long>(&entry);
+            ForceAssertEq(ptr & TAG_MASK,0ul);
+            unsigned long hash = frozenHash(entry);
+            unsigned long val = ptr | hash << 48;
+            size_t idx = frozenSlot(hash);
+            while ( !__sync_bool_compare_and_swap(pSlots+idx,0ul,val) )
+              if ( ++idx == nSlots ) idx = 0; } });
+}
+
+template <unsigned K>
+void KmerDict<K>::freezeSorted( std::vector<Entry>* pEntries )
+{
+    discardFrozen();
+    mKSet.reset(0);
+    mSorted.swap(*pEntries);
+
+    // index on enough leading bases to leave a handful of entries per prefix
+    size_t nnn = mSorted.size();
+    unsigned nBases = 1;
+    while ( nBases < std::min(K,15u) && (16ul << 2*nBases) <= nnn ) ++nBases;
+    mSortedShift = 64 - 2*nBases;
+    size_t nPrefixes = 1ul << 2*nBases;
+    mSortedIndex.resize(nPrefixes+1);
+    Entry const* entries = mSorted.data();
+    #pragma omp parallel for schedule(static,10000)
+    for ( size_t prefix = 0; prefix <= nPrefixes; ++prefix )
+    { // the first entry with a prefix at least this one
+      size_t lo = 0, hi = nnn;
+      while ( lo < hi )
+      { size_t mid = lo + (hi-lo)/2;
+        if ( sortedPrefix(entries[mid]) < prefix ) lo = mid+1;
+        else hi = mid; }
+      mSortedIndex[prefix] = lo; }
+}
+
+template <unsigned K>
+void KmerDict<K>::thaw()
+{
+    std::vector<unsigned long>().swap(mFrozen);
+    if ( !isSorted() ) return;
+    size_t nnn = mSorted.size();
+    mKSet.reset(nnn);
+    Entry const* entries = mSorted.data();
+    #pragma omp parallel for schedule(static,10000)
+    for ( size_t idx = 0; idx < nnn; ++idx )
+        mKSet.insertUniqueValue(entries[idx]);
+    discardFrozen();
+}
+
+template <unsigned K>
+template <class Proc>
+void KmerDict<K>::parallelForEachEntry( Proc const& proc ) const
+{
+    if ( !isSorted() )
+    { mKSet.parallelForEachHHS(HHSProc<Proc>(proc));
+      return; }
+    size_t nnn = mSorted.size();
+    Entry const* entries = mSorted.data();
+    #pragma omp parallel
+    {   Proc p(proc);
+        #pragma omp for schedule(dynamic,10000)
+        for ( size_t idx = 0; idx < nnn; ++idx )
+            p(entries[idx]);
+    }
+}
+
+template <unsigned K>
+void KmerDict<K>::findEntries( KMer<K> const* beg, KMer<K> const* end,
+                                Entry const** out ) const
+{
+    if ( !isFrozen() )
+    { while ( beg != end ) *out++ = findEntry(*beg++);
+      return; }
+
+    size_t const BATCH = 16;
+    KMer<K> kmers[BATCH];
+    unsigned long hashes[BATCH];
+    size_t slots[BATCH];
+    Entry const* ranges[BATCH][2];
+    while ( beg != end )
+    {
+        size_t nnn = std::min(BATCH,size_t(end-beg));
+        for ( size_t idx = 0; idx != nnn; ++idx )
+        { KMer<K>& kmer = kmers[idx];
+          kmer = *beg++;
+          if ( kmer.getCanonicalForm() == CanonicalForm::REV ) kmer.rc(); }
+        if ( isSorted() )
+        { // prefetch the index, then the middle of each range, then search
+          for ( size_t idx = 0; idx != nnn; ++idx )
+          { slots[idx] = sortedPrefix(kmers[idx]);
+            __builtin_prefetch(&mSortedIndex[slots[idx]]); }
+          for ( size_t idx = 0; idx != nnn; ++idx )
+          { Entry const* rBeg = mSorted.data()+mSortedIndex[slots[idx]];
+            Entry const* rEnd = mSorted.data()+mSortedIndex[slots[idx]+1];
+            ranges[idx][0] = rBeg; ranges[idx][1] = rEnd;
+            __builtin_prefetch(rBeg+(rEnd-rBeg)/2); }
+          for ( size_t idx = 0; idx != nnn; ++idx )
+            *out++ = sortedLookup(kmers[idx],ranges[idx][0],ranges[idx][1]);
+          continue; }
+        for ( size_t idx = 0; idx != nnn; ++idx )
+        { KMer<K> const& kmer = kmers[idx];
+          hashes[idx] = frozenHash(kmer);
+          slots[idx] = frozenSlot(hashes[idx]);
+          __builtin_prefetch(&mFrozen[slots[idx]]); }
+        for ( size_t idx = 0; idx != nnn; ++idx )
+        { unsigned long slot = mFrozen[slots[idx]];
+          if ( (slot & TAG_MASK) == hashes[idx] << 48 )
+            __builtin_prefetch(reinterpret_cast<void const*>(slot & ~TAG_MASK)); }
+        for ( size_t idx = 0; idx != nnn; ++idx )
+          *out++ = frozenProbe(kmers[idx],hashes[idx],slots[idx]);
+    }
+}
+
+template <unsigned K>
+template <class Itr>
+void KmerDict<K>::findEntries( Itr itr, Itr const& end,
+                                std::vector<Entry const*>* pResults ) const
+{
+    size_t nKmers = end-itr-K+1;
+    pResults->resize(nKmers);
+    size_t const BATCH = 64;
+    KMer<K> kmers[BATCH];
+    KMer<K> kmer(itr);
+    itr += K;
+    Entry const** out = pResults->data();
+    for ( size_t done = 0; done != nKmers; )
+    {
+        size_t nnn = std::min(BATCH,nKmers-done);
+        for ( size_t idx = 0; idx != nnn; ++idx )
+        { kmers[idx] = kmer;
+          if ( itr != end ) kmer.toSuccessor(*itr++); }
+        findEntries(kmers,kmers+nnn,out);
+        out += nnn;
+        done += nnn;
+    }
+}
+
 template <unsigned K>
 struct Serializability< KmerDict<K> >
 { typedef SelfSerializable type; };
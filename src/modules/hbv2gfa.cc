@@ -6,12 +6,91 @@
 #include "ParallelVecUtilities.h"
 #include "tclap/CmdLine.h"
 #include "GFADump.h"
+#include "GFAWriter.h"
+#include "paths/FrozenHBV.h"
+#include "paths/HBVCheckpoint.h"
+
+//N10..N90 of the canonical edge sizes, and NG10..NG90 too if genome_size isn't 0. Sorts e_sizes.
+void PrintGraphStats(std::vector<uint64_t> &e_sizes, uint64_t canonical_size, uint64_t genome_size){
+    std::sort(e_sizes.begin(),e_sizes.end());
+    auto ns=e_sizes.rbegin();
+    int64_t cs=0;
+    std::cout<<"Canonical graph sequences size: "<<canonical_size<<std::endl;
+    for (auto i=10;i<100;i+=10){
+        while (((double)(cs * 100.0))/ canonical_size < i)
+            cs+=*ns++;
+        std::cout<<"N"<<i<<": "<<*(ns-1)<<std::endl;
+    }
+    if (genome_size) {
+        ns=e_sizes.rbegin();
+        cs=0;
+        std::cout<<std::endl<<"User provided size: "<<genome_size<<std::endl;
+        for (auto i = 10; i < 100; i += 10) {
+            while (((double) (cs * 100.0)) / genome_size < i and ns!=e_sizes.rend())
+                cs += *ns++;
+            if (ns==e_sizes.rend())
+                std::cout << "NG" << i << ": n/a" << std::endl;
+            else
+                std::cout<<"NG" << i << ": " << *(ns-1) << std::endl;
+        }
+    }
+}
+
+//Stats and _raw.gfa straight from a checkpoint: the bases are decoded a batch at a time, and each batch is measured
+//and written as it comes, so neither the HyperBasevector nor the paths (unless read_tags) are ever held in memory.
+//Needs the checkpoint's involution unless stats_only.
+void StreamGFA(std::string const &out_prefix, std::string const &in_prefix, HBVCheckpointReader const &reader,
+               bool stats_only, bool read_tags, uint64_t genome_size){
+    FrozenHBV g;
+    std::vector<uint64_t> read_counts;
+    if (!stats_only) {
+        reader.readTopology(g);
+        if (read_tags) {
+            std::cout<<"Counting reads on segments"<<std::endl;
+            MappedReadPathVec paths(in_prefix + ".paths");
+            CountSegmentReads(g, paths, read_counts);
+        }
+    }
+    std::unique_ptr<GFAWriter> gfa_raw_out;
+    if (!stats_only) gfa_raw_out.reset(new GFAWriter(out_prefix+"_raw.gfa"));
+
+    std::vector<char> is_rc(reader.nEdges());
+    std::vector<uint64_t> e_sizes;
+    uint64_t total_size=0,canonical_size=0;
+    std::cout<<"Streaming edges"<<std::endl;
+    reader.forEachEdgeBatch([&](size_t first, vec<basevector> const &edges){
+        #pragma omp parallel for schedule(static,10000)
+        for (size_t i=0;i<edges.size();++i)
+            is_rc[first+i]=(edges[i].getCanonicalForm()==CanonicalForm::REV);
+        for (size_t i=0;i<edges.size();++i){
+            total_size+=edges[i].size();
+            if (!is_rc[first+i]){
+                canonical_size+=edges[i].size();
+                e_sizes.push_back(edges[i].size());
+            }
+        }
+        if (gfa_raw_out)
+            gfa_raw_out->write(edges.size(), [&](size_t i, std::string& out) {
+                if (is_rc[first+i]) return;
+                GFAWriter::appendSegment(out, first+i, edges[i], "black", read_counts.empty() ? nullptr : &read_counts[first+i]);
+            });
+    });
+
+    std::cout<<"=== Graph stats === "<<std::endl;
+    PrintGraphStats(e_sizes, canonical_size, genome_size);
+
+    if (gfa_raw_out) {
+        std::cout<<"Dumping connections"<<std::endl;
+        WriteGFALinks(*gfa_raw_out, g, is_rc);
+        gfa_raw_out->close();
+    }
+}
 
 int main(const int argc, const char * argv[]) {
 
     std::string out_prefix;
     std::string in_prefix;
-    bool find_lines, stats_only;
+    bool find_lines, stats_only, read_tags, path_lines, streaming;
 
     uint64_t genome_size;
     //========== Command Line Option Parsing ==========
@@ -29,6 +108,12 @@ int main(const int argc, const char * argv[]) {
                                                             "Find lines", false,false,"bool",cmd);
         TCLAP::ValueArg<bool>         statsOnly_Arg        ("","stats_only",
                                                             "Compute stats only (do not dump GFA)", false,false,"bool",cmd);
+        TCLAP::ValueArg<bool>         readTags_Arg        ("","read_tags",
+                                                            "Add RC read count tags to the segments", false,false,"bool",cmd);
+        TCLAP::ValueArg<bool>         pathLines_Arg        ("","path_lines",
+                                                            "Write the lines as P records (with --find_lines)", false,false,"bool",cmd);
+        TCLAP::ValueArg<bool>         streaming_Arg        ("","streaming",
+                                                            "Stream the edges from the checkpoint instead of loading the graph (not with --find_lines)", false,false,"bool",cmd);
         cmd.parse(argc, argv);
 
         // Get the value parsed by each arg.
@@ -37,63 +122,64 @@ int main(const int argc, const char * argv[]) {
         find_lines = find_linesArg.getValue();
         genome_size = 1000UL * genomeSize_Arg.getValue();
         stats_only = statsOnly_Arg.getValue();
+        read_tags = readTags_Arg.getValue();
+        path_lines = pathLines_Arg.getValue();
+        streaming = streaming_Arg.getValue();
 
     } catch (TCLAP::ArgException &e)  // catch any exceptions
     {
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
         return 1;
     }
+    std::string const hbv_file = in_prefix + ".hbv";
+    if (streaming) {
+        if (find_lines)
+            std::cout << "Finding lines needs the whole graph, not streaming." << std::endl;
+        else if (!IsHBVCheckpoint(hbv_file))
+            std::cout << hbv_file << " isn't a checkpoint, not streaming." << std::endl;
+        else {
+            HBVCheckpointReader reader(hbv_file);
+            if (stats_only or reader.hasInvolution()) {
+                StreamGFA(out_prefix, in_prefix, reader, stats_only, read_tags, genome_size);
+                return 0;
+            }
+            std::cout << hbv_file << " has no involution stored, not streaming." << std::endl;
+        }
+    }
+
     HyperBasevector hbv;
-    ReadPathVec paths;
     vec<int> inv;
 
-    std::cout << "Reading graph and paths..." << std::endl;
-    BinaryReader::readFile(in_prefix + ".hbv", &hbv);
-    hbv.Involution(inv);
+    std::cout << "Reading graph..." << std::endl;
+    LoadHBVCheckpoint(hbv, inv, hbv_file);
     TestInvolution(hbv,inv);
-    LoadReadPathVec(paths,(in_prefix + ".paths").c_str());
     std::cout << "   DONE!" << std::endl;
 
     std::cout<<"=== Graph stats === "<<std::endl;
     std::vector<uint64_t> e_sizes;
-    uint64_t total_size,canonical_size;
+    uint64_t total_size=0,canonical_size=0;
 
     for (int e=0;e<hbv.EdgeObjectCount();e++){
-        auto eo=hbv.EdgeObject(e);
+        auto const &eo=hbv.EdgeObject(e);
         total_size+=eo.size();
         if (eo.getCanonicalForm()==CanonicalForm::FWD or eo.getCanonicalForm()==CanonicalForm::PALINDROME){
             canonical_size+=eo.size();
             e_sizes.push_back(eo.size());
         }
     }
-    std::sort(e_sizes.begin(),e_sizes.end());
-    auto ns=e_sizes.rbegin();
-    int64_t cs=0;
-    std::cout<<"Canonical graph sequences size: "<<canonical_size<<std::endl;
-    for (auto i=10;i<100;i+=10){
-        while (((double)(cs * 100.0))/ canonical_size < i)
-            cs+=*ns++;
-        std::cout<<"N"<<i<<": "<<*(ns-1)<<std::endl;
-    }
-    if (genome_size) {
-        ns=e_sizes.rbegin();
-        cs=0;
-        std::cout<<std::endl<<"User provided size: "<<genome_size<<std::endl;
-        for (auto i = 10; i < 100; i += 10) {
-            while (((double) (cs * 100.0)) / genome_size < i and ns!=e_sizes.rend())
-                cs += *ns++;
-            if (ns==e_sizes.rend())
-                std::cout << "NG" << i << ": n/a" << std::endl;
-            else
-                std::cout<<"NG" << i << ": " << *(ns-1) << std::endl;
-        }
-    }
+    PrintGraphStats(e_sizes, canonical_size, genome_size);
 
     int MAX_CELL_PATHS = 50;
     int MAX_DEPTH = 10;
     if (!stats_only) {
         std::cout << "Dumping gfa" << std::endl;
-        GFADump(out_prefix, hbv, inv, paths, MAX_CELL_PATHS, MAX_DEPTH, find_lines);
+        //the paths are only read for the tags
+        if (read_tags) {
+            MappedReadPathVec paths(in_prefix + ".paths");
+            GFADump(out_prefix, hbv, inv, paths, MAX_CELL_PATHS, MAX_DEPTH, find_lines, read_tags, path_lines);
+        }
+        else
+            GFADump(out_prefix, hbv, inv, ReadPathVec(), MAX_CELL_PATHS, MAX_DEPTH, find_lines, read_tags, path_lines);
     }
 
     return 0;
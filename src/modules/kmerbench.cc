@@ -0,0 +1,156 @@
+//
+// kmerbench.cc: k-mers/sec for the KMer<K> kernels the small-K graph build leans on, against the
+// table-driven, base-at-a-time versions they replaced.
+//
+
+#include "tclap/CmdLine.h"
+#include "system/System.h"
+#include "kmers/KMer.h"
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+typedef std::vector<unsigned char> Seq;
+
+// the old KMer::rc, a byte at a time through the table
+template <unsigned K>
+void legacyRC( KMer<K>& kmer )
+{
+    typedef typename KMer<K>::storage_type S;
+    unsigned const nWords = sizeof(kmer)/sizeof(S);
+    unsigned const unusedBits = 2*(4*sizeof(S)*nWords-K);
+    S* beg = reinterpret_cast<S*>(&kmer);
+    S* end = beg+nWords;
+    std::reverse(beg,end);
+    for ( S* itr = beg; itr != end; ++itr )
+    {   unsigned char* i1 = reinterpret_cast<unsigned char*>(itr);
+        unsigned char* e1 = reinterpret_cast<unsigned char*>(itr+1);
+        while ( i1 != e1 )
+        { unsigned char tmp = Base::rcByte(*--e1);
+          *e1 = Base::rcByte(*i1); *i1++ = tmp; } }
+    if ( unusedBits )
+    {   S prev = 0;
+        while ( end-- != beg )
+        { S cur = *end;
+          *end = (cur << unusedBits) | prev;
+          prev = cur >> (8*sizeof(S)-unusedBits); } }
+}
+
+// the old KMer::getCanonicalForm, a base at a time from each end
+template <unsigned K>
+CanonicalForm legacyForm( KMer<K> const& kmer )
+{ return CF<K>::getForm(kmer.begin()); }
+
+// every bit of the kmer, so that none of the work can be optimized away
+template <unsigned K>
+unsigned long wordSum( KMer<K> const& kmer )
+{
+    typedef typename KMer<K>::storage_type S;
+    S const* beg = reinterpret_cast<S const*>(&kmer);
+    return std::accumulate(beg,beg+sizeof(kmer)/sizeof(S),0ul);
+}
+
+template <class F>
+void report( char const* what, unsigned K, size_t nKmers, F func )
+{
+    double start = WallClockTime();
+    unsigned long checksum = func();
+    double secs = WallClockTime()-start;
+    std::cout << "K=" << std::setw(3) << K << "  " << std::setw(28) << std::left << what << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1) << nKmers/secs/1.e6 << " Mkmers/s"
+              << "  (checksum " << checksum << ')' << std::endl;
+}
+
+template <unsigned K>
+void bench( Seq const& seq )
+{
+    typedef KMer<K> Kmer;
+    size_t nKmers = seq.size()-K+1;
+
+    // rolling update, choosing the canonical form of each kmer as the graph build does
+    report("rolling canonical",K,nKmers,[&seq]()
+    {   Kmer kkk(seq.begin()), krc(kkk); krc.rc();
+        unsigned long sum = 0;
+        for ( auto itr = seq.begin()+K, end = seq.end(); ; ++itr )
+        {   Kmer const& canon = (K&1) ? (kkk.isRev() ? krc : kkk) : (krc < kkk ? krc : kkk);
+            sum += canon.hash();
+            if ( itr == end ) break;
+            kkk.toSuccessor(*itr); krc.toPredecessor(*itr^3); }
+        return sum; });
+
+    // rc and canonical form of each kmer from scratch, old and new
+    std::vector<Kmer> kmers;
+    kmers.reserve(std::min(nKmers,size_t(1000000)));
+    Kmer kkk(seq.begin());
+    for ( auto itr = seq.begin()+K; kmers.size() < kmers.capacity(); ++itr )
+    {   kmers.push_back(kkk); kkk.toSuccessor(*itr); }
+    size_t nReps = std::max(size_t(1),nKmers/kmers.size());
+    size_t nTotal = nReps*kmers.size();
+    report("rc (legacy)",K,nTotal,[&kmers,nReps]()
+    {   unsigned long sum = 0;
+        for ( size_t rep = 0; rep != nReps; ++rep )
+            for ( Kmer kmer : kmers ) { legacyRC(kmer); sum += wordSum(kmer); }
+        return sum; });
+    report("rc",K,nTotal,[&kmers,nReps]()
+    {   unsigned long sum = 0;
+        for ( size_t rep = 0; rep != nReps; ++rep )
+            for ( Kmer kmer : kmers ) { kmer.rc(); sum += wordSum(kmer); }
+        return sum; });
+    report("canonical form (legacy)",K,nTotal,[&kmers,nReps]()
+    {   unsigned long sum = 0;
+        for ( size_t rep = 0; rep != nReps; ++rep )
+            for ( Kmer const& kmer : kmers ) sum += int(legacyForm(kmer));
+        return sum; });
+    report("canonical form",K,nTotal,[&kmers,nReps]()
+    {   unsigned long sum = 0;
+        for ( size_t rep = 0; rep != nReps; ++rep )
+            for ( Kmer const& kmer : kmers ) sum += int(kmer.getCanonicalForm());
+        return sum; });
+    report("compare",K,nTotal,[&kmers,nReps]()
+    {   unsigned long sum = 0;
+        for ( size_t rep = 0; rep != nReps; ++rep )
+            for ( size_t idx = 1; idx < kmers.size(); ++idx ) sum += kmers[idx-1] < kmers[idx];
+        return sum; });
+
+    // the new kernels must agree with the old
+    for ( Kmer const& kmer : kmers )
+    {   Kmer k1(kmer), k2(kmer);
+        legacyRC(k1); k2.rc();
+        if ( k1 != k2 || legacyForm(kmer) != kmer.getCanonicalForm() )
+            FatalErr("K=" << K << ": new and legacy kernels disagree on " << kmer);
+    }
+}
+
+}
+
+int main(const int argc, const char * argv[]) {
+
+    uint64_t nBases;
+    try {
+        TCLAP::CmdLine cmd("", ' ', "0.1");
+        TCLAP::ValueArg<uint64_t> nBasesArg("n", "bases",
+             "Length of the random sequence to kmerize (default: 50M)", false, 50000000, "int", cmd);
+        cmd.parse(argc, argv);
+        nBases = nBasesArg.getValue();
+    } catch (TCLAP::ArgException &e)  // catch any exceptions
+    {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return 1;
+    }
+    if ( nBases < 1000 ) nBases = 1000;
+
+    Seq seq(nBases);
+    std::mt19937_64 rng(1);
+    for ( auto& base : seq ) base = rng() & 3;
+
+    bench<25>(seq);
+    bench<60>(seq);
+    bench<61>(seq);
+    bench<200>(seq);
+    return 0;
+}
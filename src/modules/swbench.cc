@@ -0,0 +1,124 @@
+//
+// swbench.cc: DP cells/sec for SmithWatAffine and SmithWatAffineBanded, scalar and SIMD, on pairs of random
+// sequences that differ by scattered substitutions and indels.
+//
+
+#include "tclap/CmdLine.h"
+#include "system/System.h"
+#include "pairwise_aligners/SmithWatAffine.h"
+#include "pairwise_aligners/SmithWatAffineSIMD.h"
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+typedef std::vector<basevector> Seqs;
+
+template <class F>
+void report( char const* what, double nCells, F func )
+{
+    double start = WallClockTime();
+    unsigned long checksum = func();
+    double secs = WallClockTime()-start;
+    std::cout << std::setw(32) << std::left << what << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1) << nCells/secs/1.e6 << " Mcells/s"
+              << "  (score sum " << checksum << ')' << std::endl;
+}
+
+// T from S, with a change at about one base in 50
+basevector mutate( basevector const& S, std::mt19937_64& rng )
+{
+    basevector T;
+    T.reserve(S.size()+S.size()/50+10);
+    for ( unsigned idx = 0; idx < S.size(); ++idx )
+    {
+        switch ( rng() % 150 )
+        {
+        case 0: T.push_back((S[idx]+1+rng()%3)&3); break;                     // substitution
+        case 1: break;                                                        // deletion
+        case 2: T.push_back(S[idx]); for ( int ins = rng()%5; ins >= 0; --ins ) T.push_back(rng()&3); break;
+        default: T.push_back(S[idx]); break;
+        }
+    }
+    return T;
+}
+
+}
+
+int main(const int argc, const char * argv[]) {
+
+    unsigned length, nPairs, bandwidth;
+    try {
+        TCLAP::CmdLine cmd("", ' ', "0.1");
+        TCLAP::ValueArg<unsigned> lengthArg("l", "length",
+             "Length of the sequences to align (default: 1000)", false, 1000, "int", cmd);
+        TCLAP::ValueArg<unsigned> pairsArg("p", "pairs",
+             "Number of pairs to align (default: 200)", false, 200, "int", cmd);
+        TCLAP::ValueArg<unsigned> bandwidthArg("b", "bandwidth",
+             "Bandwidth of the banded alignments (default: 50)", false, 50, "int", cmd);
+        cmd.parse(argc, argv);
+        length = std::max(10u,lengthArg.getValue());
+        nPairs = std::max(1u,pairsArg.getValue());
+        bandwidth = std::max(1u,bandwidthArg.getValue());
+    } catch (TCLAP::ArgException &e)  // catch any exceptions
+    {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return 1;
+    }
+
+    Seqs seqs1(nPairs), seqs2(nPairs);
+    std::mt19937_64 rng(1);
+    double nCells = 0., nBandCells = 0.;
+    for ( unsigned idx = 0; idx != nPairs; ++idx )
+    {   seqs1[idx].resize(length);
+        for ( unsigned pos = 0; pos != length; ++pos ) seqs1[idx].Set(pos,rng()&3);
+        seqs2[idx] = mutate(seqs1[idx],rng);
+        nCells += double(seqs1[idx].size())*seqs2[idx].size();
+        nBandCells += double(seqs1[idx].size())*std::min(seqs2[idx].size(),2*bandwidth+1); }
+
+    std::vector<alignment> scalar(nPairs), simd(nPairs);
+    std::vector<unsigned> scalarScores(nPairs), simdScores(nPairs), scoresOnly(nPairs);
+    report("SmithWatAffine",nCells,[&]()
+    {   unsigned long sum = 0;
+        for ( unsigned idx = 0; idx != nPairs; ++idx )
+            sum += scalarScores[idx] = SmithWatAffine(seqs1[idx],seqs2[idx],scalar[idx]);
+        return sum; });
+    SWAffineWorkspace ws;
+    report("SmithWatAffineSIMD",nCells,[&]()
+    {   unsigned long sum = 0;
+        for ( unsigned idx = 0; idx != nPairs; ++idx )
+            sum += simdScores[idx] = SmithWatAffineSIMD(seqs1[idx],seqs2[idx],simd[idx],true,true,3,12,1,&ws);
+        return sum; });
+    report("SmithWatAffineScoreSIMD",nCells,[&]()
+    {   unsigned long sum = 0;
+        for ( unsigned idx = 0; idx != nPairs; ++idx )
+            sum += scoresOnly[idx] = SmithWatAffineScoreSIMD(seqs1[idx],seqs2[idx],true,true,3,12,1,&ws);
+        return sum; });
+    for ( unsigned idx = 0; idx != nPairs; ++idx )
+        if ( scalarScores[idx] != simdScores[idx] || scalarScores[idx] != scoresOnly[idx]
+                || !(scalar[idx] == simd[idx]) )
+            FatalErr("SmithWatAffine and SmithWatAffineSIMD disagree on pair " << idx);
+
+    std::vector<align> scalarBanded(nPairs), simdBanded(nPairs);
+    std::vector<int> scalarErrs(nPairs), simdErrs(nPairs);
+    report("SmithWatAffineBanded",nBandCells,[&]()
+    {   unsigned long sum = 0;
+        for ( unsigned idx = 0; idx != nPairs; ++idx )
+            sum += scalarScores[idx] = SmithWatAffineBanded(seqs1[idx],seqs2[idx],0,bandwidth,
+                                                            scalarBanded[idx],scalarErrs[idx]);
+        return sum; });
+    report("SmithWatAffineBandedSIMD",nBandCells,[&]()
+    {   unsigned long sum = 0;
+        for ( unsigned idx = 0; idx != nPairs; ++idx )
+            sum += simdScores[idx] = SmithWatAffineBandedSIMD(seqs1[idx],seqs2[idx],0,bandwidth,
+                                                              simdBanded[idx],simdErrs[idx],3,12,1,&ws);
+        return sum; });
+    for ( unsigned idx = 0; idx != nPairs; ++idx )
+        if ( scalarScores[idx] != simdScores[idx] || scalarErrs[idx] != simdErrs[idx]
+                || !(scalarBanded[idx] == simdBanded[idx]) )
+            FatalErr("SmithWatAffineBanded and SmithWatAffineBandedSIMD disagree on pair " << idx);
+    return 0;
+}
@@ -11,7 +11,9 @@
 #include "MainTools.h"
 #include "PairsManager.h"
 #include "ParallelVecUtilities.h"
+#include "feudal/BinnedQualVec.h"
 #include "feudal/PQVec.h"
+#include "paths/HBVCheckpoint.h"
 #include "paths/HyperBasevector.h"
 #include "paths/RemodelGapTools.h"
 #include "paths/long/BuildReadQGraph.h"
@@ -27,24 +29,9 @@
 #include <paths/PathFinder.h>
 #include <paths/long/large/ImprovePath.h>
 #include "GFADump.h"
+#include "util/PerfLog.h"
 
 
-std::string checkpoint_perf_time(const std::string section_name){
-    static double wtimer, cputimer;
-    double new_wtimer, wtime, new_cputimer, cputime;
-    //wallclock time
-    struct timeval time;
-    if (gettimeofday(&time,NULL)) new_wtimer=0;
-    else new_wtimer = (double)time.tv_sec + (double)time.tv_usec * .000001;
-    //cpu_time
-    new_cputimer= (double)clock() / CLOCKS_PER_SEC;
-    wtime=new_wtimer-wtimer;
-    cputime=new_cputimer-cputimer;
-    wtimer=new_wtimer;
-    cputimer=new_cputimer;
-    return "TIME, "+section_name+", "+std::to_string(wtime)+", "+std::to_string(cputime);
-}
-
 int main(const int argc, const char * argv[]) {
 
     std::string out_prefix;
@@ -61,7 +48,7 @@ int main(const int argc, const char * argv[]) {
                                            180, 188, 192, 196, 200, 208, 216, 224, 232, 240, 260, 280, 300, 320, 368,
                                            400, 440, 460, 500, 544, 640};
     std::vector<unsigned int> allowed_steps = {1,2,3,4,5,6,7};
-    bool extend_paths,run_pathfinder,dump_all,dump_perf,dump_pf;
+    bool extend_paths,run_pathfinder,dump_all,dump_perf,dump_pf,binned_quals;
 
     //========== Command Line Option Parsing ==========
     for (auto i=0;i<argc;i++) std::cout<<argv[i]<<" ";
@@ -114,7 +101,9 @@ int main(const int argc, const char * argv[]) {
         TCLAP::ValueArg<bool>         dumpAllArg        ("","dump_all",
                                                                "Dump all intermediate files", false,false,"bool",cmd);
         TCLAP::ValueArg<bool>         dumpPerfArg        ("","dump_perf",
-                                                         "Dump performance info (devel)", false,false,"bool",cmd);
+                                                         "Write per-phase time, memory and I/O telemetry to <prefix>.perf.jsonl (default: 1)", false,true,"bool",cmd);
+        TCLAP::ValueArg<bool>         binnedQualsArg        ("","binned_quals",
+                                                          "Score reads on steps 4 and 6 with 4-bit binned qualities, held in place of the full qualities (exact for up to 16 distinct values; step 4 holds both when lossy)", false,false,"bool",cmd);
         TCLAP::ValueArg<bool>         dumpPFArg        ("","dump_pf",
                                                           "Dump pathfinder info (devel)", false,false,"bool",cmd);
 
@@ -139,6 +128,7 @@ int main(const int argc, const char * argv[]) {
         to_step=toStep_Arg.getValue();
         dev_run=dev_runArg.getValue();
         dump_pf=dumpPFArg.getValue();
+        binned_quals=binnedQualsArg.getValue();
         pair_sample=pairSampleArg.getValue();
         minFreq=minFreqArg.getValue();
         minQual=minQualArg.getValue();
@@ -164,13 +154,14 @@ int main(const int argc, const char * argv[]) {
     if (omp_get_proc_bind()==omp_proc_bind_false) std::cout<< "WARNING: you are running the code with omp_proc_bind_false, parallel performance may suffer"<<std::endl;
     if (omp_get_proc_bind()==omp_proc_bind_master) std::cout<< "WARNING: you are running the code with omp_proc_bind_master, parallel performance may suffer"<<std::endl;
 
+    if (dump_perf) PerfLog::open(out_dir+"/"+out_prefix+".perf.jsonl");
+
     //========== Main Program Begins ======
     vecbvec bases;
     VecPQVec quals;
 
     vec<String> subsam_names = {"C"};
     vec<int64_t> subsam_starts = {0};
-    std::ofstream perf_file;
     //double wtimer,cputimer;
     vec<int> inv;
     HyperBasevector hbvr;
@@ -191,7 +182,7 @@ int main(const int argc, const char * argv[]) {
         std::cout<<"=== w2rap contigger: development test run ==="<<std::endl;
         if (dev_run=="pathfinder" or dev_run=="pathfinder2"){
             //Pathfinder test, runs from Pathfinder to the end of step 6
-            VecULongVec invPaths;
+            EdgePathIndex invPaths;
             std::cout << Date() << ": loading HVB and paths" << std::endl;
             if (dev_run=="pathfinder") {
                 BinaryReader::readFile(out_dir + "/pf_start.hbv", &hbvr);
@@ -200,12 +191,12 @@ int main(const int argc, const char * argv[]) {
                 hbvr.Involution(inv);
                 std::cout << Date() << ": making paths index for PathFinder" << std::endl;
 
-                invert(pathsr, invPaths, hbvr.EdgeObjectCount());
+                invPaths.build(pathsr, hbvr.EdgeObjectCount());
                 std::cout << Date() << ": PathFinder: unrolling loops" << std::endl;
                 PathFinder(hbvr, inv, pathsr, invPaths).unroll_loops(800);
                 std::cout << "Removing Unneeded Vertices & Cleanup" << std::endl;
-                RemoveUnneededVertices2(hbvr, inv, pathsr);
-                Cleanup(hbvr, inv, pathsr);
+                RemoveUnneededVertices2(hbvr, inv, pathsr, &invPaths);
+                Cleanup(hbvr, inv, pathsr, &invPaths);
                 std::cout << "Dumping" << std::endl;
                 BinaryWriter::writeFile(out_dir + "/pf_after_loops.hbv", hbvr);
                 WriteReadPathVec(pathsr,(out_dir + "/pf_after_loops.paths").c_str());
@@ -214,16 +205,15 @@ int main(const int argc, const char * argv[]) {
                 LoadReadPathVec(pathsr,(out_dir + "/pf_after_loops.paths").c_str());
                 inv.clear();
                 hbvr.Involution(inv);
+                std::cout << Date() << ": making paths index for PathFinder" << std::endl;
+                invPaths.build(pathsr, hbvr.EdgeObjectCount());
             }
-            std::cout << Date() << ": making paths index for PathFinder" << std::endl;
-            invPaths.clear();
-            invert( pathsr, invPaths, hbvr.EdgeObjectCount( ) );
 
             std::cout << Date() << ": PathFinder: Separating solved single-flow repeats" << std::endl;
             PathFinder(hbvr,inv,pathsr,invPaths).untangle_complex_in_out_choices(700, true);
             std::cout<<"Removing Unneeded Vertices & Cleanup"<<std::endl;
-            RemoveUnneededVertices2(hbvr,inv,pathsr);
-            Cleanup( hbvr, inv, pathsr );
+            RemoveUnneededVertices2(hbvr,inv,pathsr,&invPaths);
+            Cleanup( hbvr, inv, pathsr, &invPaths );
 
             std::cout << "Loading reads in fastb/qualp format..." << std::endl;
             bases.ReadAll(out_dir + "/frag_reads_orig.fastb");
@@ -271,7 +261,7 @@ int main(const int argc, const char * argv[]) {
             vec<vec<vec<vec<int>>>> lines;
 
             FindLines(hbvr, inv, lines, MAX_CELL_PATHS, MAX_DEPTH);
-            if (dump_perf) perf_file << checkpoint_perf_time("FindLines") << std::endl;
+            PerfLog::lap("FindLines");
             BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".fin.lines", lines);
 
             // XXX TODO: Solve the {} thingy, check if has any influence in the new code to run that integrated
@@ -288,7 +278,7 @@ int main(const int argc, const char * argv[]) {
 
             //TODO: add contig fasta dump.
             std::cout << "Dumping contig graph and paths..." << std::endl;
-            BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".contig.hbv", hbvr);
+            WriteHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".contig.hbv");
             WriteReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".contig.paths").c_str());
             std::cout << "   DONE!" << std::endl;
             GFADump(out_dir +"/"+ out_prefix + "_contigs", hbvr, inv, pathsr, MAX_CELL_PATHS, MAX_DEPTH, true);
@@ -298,24 +288,20 @@ int main(const int argc, const char * argv[]) {
 
     //== Load reads (and saves in binary format) ======
 
-    if (dump_perf) {
-        perf_file.open(out_dir+"/"+out_prefix+".perf",std::ofstream::out | std::ofstream::app);
-    }
-    if (dump_perf) checkpoint_perf_time(""); //initialisation!
-
     if (from_step==1)
     {
         std::cout << "--== Step 1: Reading input files ==--" << std::endl;
+        PerfLog::Scope step_scope("step1");
         ExtractReads(read_files, out_dir, subsam_names, subsam_starts, &bases, &quals);
         std::cout << "Reading input files DONE!" << std::endl << std::endl << std::endl;
-        if (dump_perf) perf_file << checkpoint_perf_time("ExtractReads") << std::endl;
+        PerfLog::lap("ExtractReads");
         //TODO: add an option to dump the reads
         if (dump_all || to_step<6) {
             std::cout << "Dumping reads in fastb/qualp format..." << std::endl;
             bases.WriteAll(out_dir + "/frag_reads_orig.fastb");
             quals.WriteAll(out_dir + "/frag_reads_orig.qualp");
             std::cout << "   DONE!" << std::endl;
-            if (dump_perf) perf_file << checkpoint_perf_time("DumpReads") << std::endl;
+            PerfLog::lap("DumpReads");
         }
     }
 
@@ -326,7 +312,7 @@ int main(const int argc, const char * argv[]) {
         bases.ReadAll(out_dir + "/frag_reads_orig.fastb");
         quals.ReadAll(out_dir + "/frag_reads_orig.qualp");
         std::cout << "   DONE!" << std::endl;
-        if (dump_perf) perf_file << checkpoint_perf_time("LoadReads") << std::endl;
+        PerfLog::lap("LoadReads");
     }
     {//This scope-trick to invalidate old data is dirty
 
@@ -335,97 +321,133 @@ int main(const int argc, const char * argv[]) {
         if (from_step<=2 and to_step>=2) {
             bool FILL_JOIN = False;
             std::cout << "--== Step 2: Building first (small K) graph ==--" << std::endl;
+            PerfLog::Scope step_scope("step2");
             buildReadQGraph(bases, quals, FILL_JOIN, FILL_JOIN, minQual, minFreq, .75, 0, &hbv, &paths, small_K, out_dir,tmp_dir,disk_batches);
-            if (dump_perf) perf_file << checkpoint_perf_time("buildReadQGraph") << std::endl;
             FixPaths(hbv, paths); //TODO: is this even needed?
-            if (dump_perf) perf_file << checkpoint_perf_time("FixPaths") << std::endl;
+            PerfLog::lap("FixPaths");
             std::cout << "Building first graph DONE!" << std::endl << std::endl << std::endl;
             if (dump_all || to_step ==2){
                 std::cout << "Dumping small_K graph and paths..." << std::endl;
-                BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".small_K.hbv", hbv);
+                WriteHBVCheckpoint(hbv, out_dir + "/" + out_prefix + ".small_K.hbv");
                 WriteReadPathVec(paths,(out_dir + "/" + out_prefix + ".small_K.paths").c_str());
                 std::cout << "   DONE!" << std::endl;
-                if (dump_perf) perf_file << checkpoint_perf_time("SmallKDump") << std::endl;
+                PerfLog::lap("SmallKDump");
             }
         }
 
         if (from_step==3){
             std::cout << "Reading small_K graph and paths..." << std::endl;
-            BinaryReader::readFile(out_dir + "/" + out_prefix + ".small_K.hbv", &hbv);
+            LoadHBVCheckpoint(hbv, out_dir + "/" + out_prefix + ".small_K.hbv");
             LoadReadPathVec(paths,(out_dir + "/" + out_prefix + ".small_K.paths").c_str());
             std::cout << "   DONE!" << std::endl;
-            if (dump_perf) perf_file << std::endl << checkpoint_perf_time("SmallKLoad") << std::endl;
+            PerfLog::lap("SmallKLoad");
         }
         if (from_step<=3 and to_step>=3) {
             std::cout << "--== Step 3: Repathing to second (large K) graph ==--" << std::endl;
+            PerfLog::Scope step_scope("step3");
             vecbvec edges(hbv.Edges().begin(), hbv.Edges().end());
             inv.clear();
             hbv.Involution(inv);
-            if (dump_perf) perf_file << checkpoint_perf_time("Edges&Involution") << std::endl;
+            PerfLog::lap("Edges&Involution");
             FragDist(hbv, inv, paths, out_dir + "/" + out_prefix + ".first.frags.dist");
-            if (dump_perf) perf_file << checkpoint_perf_time("FragDist") << std::endl;
+            PerfLog::lap("FragDist");
             const string run_head = out_dir + "/" + out_prefix;
 
             pathsr.resize(paths.size());
 
             RepathInMemory(hbv, edges, inv, paths, hbv.K(), large_K, hbvr, pathsr, True, True, extend_paths);
-            if (dump_perf) perf_file << checkpoint_perf_time("Repath") << std::endl;
+            CompactReadPathVec(pathsr);
+            PerfLog::lap("CompactPaths");
             std::cout << "Repathing to second graph DONE!" << std::endl << std::endl << std::endl;
             if (dump_all || to_step ==3){
                 std::cout << "Dumping large_K graph and paths..." << std::endl;
-                BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".large_K.hbv", hbvr);
+                WriteHBVCheckpoint(hbvr, out_dir + "/" + out_prefix + ".large_K.hbv");
                 WriteReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".large_K.paths").c_str());
                 std::cout << "   DONE!" << std::endl;
-                if (dump_perf) perf_file << checkpoint_perf_time("LargeKDump") << std::endl;
+                PerfLog::lap("LargeKDump");
             }
         }
 
     }
 
+    //== Binned qualities, so the read scorers of steps 4 and 6 needn't decode the PQVecs again and again ======
+    // (built at the start of each of those steps and dropped at its end, so they're not held through step 5,
+    // where memory peaks).  Both steps read qualities only through the binned copy, so the PQVecs are dropped
+    // while it stands in for them:  step 4 rebuilds them after, which it can only do when binning is exact (when
+    // it isn't, it holds both); nothing after step 6 reads qualities, so step 6 just drops them.
+
+    std::unique_ptr<BinnedQualVec> bquals;
+    auto bin_quals=[&](){
+        if (!binned_quals) return;
+        std::cout << "Binning qualities..." << std::endl;
+        bquals.reset(new BinnedQualVec(quals));
+        std::cout << "   DONE! " << ToStringAddCommas(bquals->allocSize()) << " bytes binned, "
+                  << (bquals->exact() ? "exact" : "lossy") << ", beside "
+                  << ToStringAddCommas(quals.SizeSum()+quals.size()*sizeof(PQVec)) << " bytes of PQVecs"
+                  << std::endl;
+        PerfLog::lap("BinQuals");
+    };
+
     //== Clean ======
     if (from_step==4){
         std::cout << "Reading large_K graph and paths..." << std::endl;
-        BinaryReader::readFile(out_dir + "/" + out_prefix + ".large_K.hbv", &hbvr);
+        LoadHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".large_K.hbv");
         LoadReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".large_K.paths").c_str());
         std::cout << "   DONE!" << std::endl;
-        if (dump_perf) perf_file << std::endl << checkpoint_perf_time("LargeKLoad") << std::endl;
+        PerfLog::lap("LargeKLoad");
     }
     if (from_step<=4 and to_step>=4) {
         std::cout << "--== Step 4: Cleaning graph ==--" << std::endl;
-        inv.clear();
-        hbvr.Involution(inv);
+        PerfLog::Scope step_scope("step4");
+        if (from_step<4) {
+            inv.clear();
+            hbvr.Involution(inv);
+        }
         int CLEAN_200_VERBOSITY = 0;
         int CLEAN_200V = 3;
-        Clean200x(hbvr, inv, pathsr, bases, quals, CLEAN_200_VERBOSITY, CLEAN_200V, min_size);
-        if (dump_perf) perf_file << checkpoint_perf_time("Clean200x") << std::endl;
+        bin_quals();
+        bool const quals_dropped = bquals && bquals->exact();
+        if (quals_dropped) {
+            quals.clear().shrink_to_fit();
+            PerfLog::lap("DropQuals");
+        }
+        Clean200x(hbvr, inv, pathsr, bases, quals, CLEAN_200_VERBOSITY, CLEAN_200V, min_size, bquals.get());
+        if (quals_dropped) {
+            std::cout << "Restoring qualities..." << std::endl;
+            bquals->restore(quals);
+            std::cout << "   DONE!" << std::endl;
+            PerfLog::lap("RestoreQuals");
+        }
+        bquals.reset();
+        CompactReadPathVec(pathsr);
+        PerfLog::lap("CompactPaths");
         std::cout << "Cleaning graph DONE!" << std::endl<< std::endl<< std::endl;
         if (dump_all || to_step ==4){
             std::cout << "Dumping large_K clean graph and paths..." << std::endl;
-            BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".large_K.clean.hbv", hbvr);
+            WriteHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".large_K.clean.hbv");
             WriteReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".large_K.clean.paths").c_str());
             std::cout << "   DONE!" << std::endl;
-            if (dump_perf) perf_file << checkpoint_perf_time("LargeKCleanDump") << std::endl;
+            PerfLog::lap("LargeKCleanDump");
         }
     }
 
     //== Patching ======
 
-    VecULongVec paths_inv;
+    EdgePathIndex paths_inv;
 
     if (from_step==5){
         std::cout << "Reading large_K clean graph and paths..." << std::endl;
-        BinaryReader::readFile(out_dir + "/" + out_prefix + ".large_K.clean.hbv", &hbvr);
+        LoadHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".large_K.clean.hbv");
         LoadReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".large_K.clean.paths").c_str());
-        inv.clear();
-        hbvr.Involution(inv);
         std::cout << "   DONE!" << std::endl;
-        if (dump_perf) perf_file << std::endl << checkpoint_perf_time("LargeKCleanLoad") << std::endl;
+        PerfLog::lap("LargeKCleanLoad");
     }
     if (from_step<=5 and to_step>=5) {
         std::cout << "--== Step 5: Assembling gaps ==--" << std::endl;
+        PerfLog::Scope step_scope("step5");
         std::cout << Date() <<": inverting paths"<<std::endl;
-        invert(pathsr, paths_inv, hbvr.EdgeObjectCount());
-        if (dump_perf) perf_file << checkpoint_perf_time("Invert") << std::endl;
+        paths_inv.build(pathsr, hbvr.EdgeObjectCount());
+        PerfLog::lap("Invert");
 
         vecbvec new_stuff;
 
@@ -438,7 +460,6 @@ int main(const int argc, const char * argv[]) {
 
         AssembleGaps2(hbvr, inv, pathsr, paths_inv, bases, quals, out_dir, k2floor_sequence,
                       new_stuff, CYCLIC_SAVE, A2V, MAX_PROX_LEFT, MAX_PROX_RIGHT, MAX_BPATHS, pair_sample);
-        if (dump_perf) perf_file << checkpoint_perf_time("AssembleGaps2") << std::endl;
         int MIN_GAIN = 5;
         //const String TRACE_PATHS="{}";
         const vec<int> TRACE_PATHS;
@@ -446,14 +467,15 @@ int main(const int argc, const char * argv[]) {
 
         AddNewStuff(new_stuff, hbvr, inv, pathsr, bases, quals, MIN_GAIN, TRACE_PATHS, out_dir, EXT_MODE);
         PartnersToEnds(hbvr, pathsr, bases, quals);
-        if (dump_perf) perf_file << checkpoint_perf_time("NewStuff&Partners") << std::endl;
+        CompactReadPathVec(pathsr);
+        PerfLog::lap("NewStuff&Partners");
         std::cout << "Assembling gaps DONE!" << std::endl << std::endl << std::endl;
         if (dump_all || to_step ==5){
             std::cout << "Dumping large_K final graph and paths..." << std::endl;
-            BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".large_K.final.hbv", hbvr);
+            WriteHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".large_K.final.hbv");
             WriteReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".large_K.final.paths").c_str());
             std::cout << "   DONE!" << std::endl;
-            if (dump_perf) perf_file << checkpoint_perf_time("LargeKFinalDump") << std::endl;
+            PerfLog::lap("LargeKFinalDump");
         }
 
     }
@@ -462,15 +484,14 @@ int main(const int argc, const char * argv[]) {
 
     if (from_step==6){
         std::cout << "Reading large_K final graph and paths..." << std::endl;
-        BinaryReader::readFile(out_dir + "/" + out_prefix + ".large_K.final.hbv", &hbvr);
+        LoadHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".large_K.final.hbv");
         LoadReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".large_K.final.paths").c_str());
-        inv.clear();
-        hbvr.Involution(inv);
         std::cout << "   DONE!" << std::endl;
-        if (dump_perf) perf_file << std::endl << checkpoint_perf_time("LargeKFinalLoad") << std::endl;
+        PerfLog::lap("LargeKFinalLoad");
     }
     if (from_step<=6 and to_step>=6) {
         std::cout << "--== Step 6: Graph simplification and path finding ==--" << std::endl;
+        PerfLog::Scope step_scope("step6");
 
 
         //==Simplify
@@ -493,12 +514,17 @@ int main(const int argc, const char * argv[]) {
         bool FINAL_TINY = True;
         bool UNWIND3 = True;
 
+        bin_quals();
+        if (bquals) {
+            quals.clear().shrink_to_fit();
+            PerfLog::lap("DropQuals");
+        }
         Simplify(out_dir, hbvr, inv, pathsr, bases, quals, MAX_SUPP_DEL, TAMP_EARLY_MIN, MIN_RATIO2, MAX_DEL2,
                  ANALYZE_BRANCHES_VERBOSE2, TRACE_SEQ, DEGLOOP, EXT_FINAL, EXT_FINAL_MODE,
                  PULL_APART_VERBOSE, PULL_APART_TRACE, DEGLOOP_MODE, DEGLOOP_MIN_DIST, IMPROVE_PATHS,
-                 IMPROVE_PATHS_LARGE, FINAL_TINY, UNWIND3, run_pathfinder, dump_pf);
+                 IMPROVE_PATHS_LARGE, FINAL_TINY, UNWIND3, run_pathfinder, dump_pf, bquals.get());
+        bquals.reset();
 
-        if (dump_perf) perf_file << checkpoint_perf_time("Simplify") << std::endl;
         // For now, fix paths and write the and their inverse
         for (int i = 0; i < (int) pathsr.size(); i++) { //XXX TODO: change this int for uint 32
             Bool bad = False;
@@ -507,15 +533,14 @@ int main(const int argc, const char * argv[]) {
             if (bad) pathsr[i].resize(0);
         }
         // TODO: this is "bj making sure the inversion still works", but shouldn't be required
-        paths_inv.clear();
-        invert(pathsr, paths_inv, hbvr.EdgeObjectCount());
-        if (dump_perf) perf_file << checkpoint_perf_time("Fix&Invert") << std::endl;
+        paths_inv.build(pathsr, hbvr.EdgeObjectCount());
+        PerfLog::lap("Fix&Invert");
 
         // Find lines and write files.
         vec<vec<vec<vec<int>>>> lines;
 
         FindLines(hbvr, inv, lines, MAX_CELL_PATHS, MAX_DEPTH);
-        if (dump_perf) perf_file << checkpoint_perf_time("FindLines") << std::endl;
+        PerfLog::lap("FindLines");
         BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".fin.lines", lines);
 
         // XXX TODO: Solve the {} thingy, check if has any influence in the new code to run that integrated
@@ -526,7 +551,7 @@ int main(const int argc, const char * argv[]) {
             BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".fin.lines.npairs", npairs);
 
             vec<vec<covcount>> covs;
-            ComputeCoverage(hbvr, inv, pathsr, lines, subsam_starts, covs);
+            ComputeCoverage(hbvr, inv, pathsr, paths_inv, lines, subsam_starts, covs);
             //BinaryWriter::writeFile( work_dir + "/" +prefix+ ".fin.covs", covs );
             //WriteLineStats( work_dir, lines, llens, npairs, covs );
 
@@ -535,41 +560,40 @@ int main(const int argc, const char * argv[]) {
             std::cout << "CN fraction good = " << cn_frac_good << std::endl;
             PerfStatLogger::log("cn_frac_good", ToString(cn_frac_good, 2), "fraction of edges with CN near integer");
         }
-        if (dump_perf) perf_file << checkpoint_perf_time("LineStats") << std::endl;
+        PerfLog::lap("LineStats");
 
         // TestLineSymmetry( lines, inv2 );
         // Compute fragment distribution.
         FragDist(hbvr, inv, pathsr, out_dir + "/" + out_prefix + ".fin.frags.dist");
-        if (dump_perf) perf_file << checkpoint_perf_time("FragDist") << std::endl;
+        PerfLog::lap("FragDist");
         //TODO: add contig fasta dump.
         std::cout << "Contigging DONE!" << std::endl << std::endl << std::endl;
         if (dump_all || to_step == 6){
             std::cout << "Dumping contig graph and paths..." << std::endl;
-            BinaryWriter::writeFile(out_dir + "/" + out_prefix + ".contig.hbv", hbvr);
+            WriteHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".contig.hbv");
             WriteReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".contig.paths").c_str());
             std::cout << "   DONE!" << std::endl;
-            if (dump_perf) perf_file << checkpoint_perf_time("ContigGraphDump") << std::endl;
+            PerfLog::lap("ContigGraphDump");
         }
         //vecbasevector G;
         //FinalFiles(hbvr, inv, pathsr, subsam_names, subsam_starts, out_dir, out_prefix + "_contigs", MAX_CELL_PATHS, MAX_DEPTH, G);
         GFADump(out_dir +"/"+ out_prefix + "_contigs", hbvr, inv, pathsr, MAX_CELL_PATHS, MAX_DEPTH, true);
         PathFinder(hbvr,inv,pathsr,paths_inv).classify_forks();
+        PerfLog::lap("GFADump&ClassifyForks");
 
     }
     if (from_step==7){
         std::cout << "Reading contig graph and paths..." << std::endl;
-        BinaryReader::readFile(out_dir + "/" + out_prefix + ".contig.hbv", &hbvr);
+        LoadHBVCheckpoint(hbvr, inv, out_dir + "/" + out_prefix + ".contig.hbv");
         LoadReadPathVec(pathsr,(out_dir + "/" + out_prefix + ".contig.paths").c_str());
-        inv.clear();
-        hbvr.Involution(inv);
-        paths_inv.clear();
-        invert(pathsr, paths_inv, hbvr.EdgeObjectCount());
+        paths_inv.build(pathsr, hbvr.EdgeObjectCount());
         std::cout << "   DONE!" << std::endl;
-        if (dump_perf) perf_file << std::endl << checkpoint_perf_time("ContigGraphLoad") << std::endl;
+        PerfLog::lap("ContigGraphLoad");
     }
     if (from_step<=7 and to_step>=7) {
         //== Scaffolding
         std::cout << "--== Step 7: PE-Scaffolding ==--" << std::endl;
+        PerfLog::Scope step_scope("step7");
         int MIN_LINE = 5000;
         int MIN_LINK_COUNT = 3; //XXX TODO: this variable is the same as -w in soap??
 
@@ -590,18 +614,18 @@ int main(const int argc, const char * argv[]) {
 
         MakeGaps(hbvr, inv, pathsr, paths_inv, MIN_LINE, MIN_LINK_COUNT, out_dir, out_prefix, SCAFFOLD_VERBOSE,
                  GAP_CLEANUP);
-        if (dump_perf) perf_file << checkpoint_perf_time("MakeGaps") << std::endl;
+        PerfLog::lap("MakeGaps");
         std::cout << "--== PE-Scaffolding DONE!" << std::endl << std::endl << std::endl;
         // Carry out final analyses and write final assembly files.
 
         vecbasevector G;
         FinalFiles(hbvr, inv, pathsr, subsam_names, subsam_starts, out_dir, out_prefix+ "_assembly", MAX_CELL_PATHS, MAX_DEPTH, G);
         GFADump(out_dir +"/"+ out_prefix + "_assembly", hbvr, inv, pathsr, MAX_CELL_PATHS, MAX_DEPTH, true);
-        if (dump_perf) perf_file << checkpoint_perf_time("FinalFiles") << std::endl;
+        PerfLog::lap("FinalFiles");
 
 
     }
-    if (dump_perf) perf_file.close();
+    PerfLog::close();
     return 0;
 }
 
@@ -0,0 +1,498 @@
+//
+// SmithWatAffineSIMD.cc: SmithWatAffine and SmithWatAffineBanded on an anti-diagonal, int16 SIMD kernel.
+//
+
+#include "pairwise_aligners/SmithWatAffineSIMD.h"
+#include "pairwise_aligners/SmithWatAffine.h"
+#include "PackAlign.h"
+#include "ShortVector.h"
+#include "system/Assert.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+const int SWA_Infinity = 100000000; // as SmithWatAffine.cc:  no alignment
+
+// Slack at the end of every row-indexed and column-indexed buffer, so that the last vector of an anti-diagonal
+// can run past its end.  Enough for the widest kernel.
+const int PAD = 16;
+
+// Penalties bigger than this go to the scalar code.
+const int MAX_PENALTY = 1000;
+
+int floorHalf( int x ) { return x >= 0 ? x/2 : (x-1)/2; }
+int ceilHalf( int x ) { return -floorHalf(-x); }
+
+template <class T>
+void grow( std::vector<T>& v, size_t sz ) { if ( v.size() < sz ) v.resize(sz); }
+
+// SmithWatAffine's choice of state where x, y and z tie.
+char pick( int x, int y, int z )
+{ if ( x <= y ) return x <= z ? 'x' : 'z';
+  return y <= z ? 'y' : 'z'; }
+
+// W int16 lanes of scores, and W bytes of traceback
+template <int W> struct Lanes;
+template <> struct Lanes<8>
+{
+    typedef short V __attribute__((vector_size(16)));
+    typedef char B __attribute__((vector_size(8)));
+    static inline __attribute__((always_inline)) B narrow( V v ) { return __builtin_convertvector(v,B); }
+};
+template <> struct Lanes<16>
+{
+    typedef short V __attribute__((vector_size(32)));
+    typedef char B __attribute__((vector_size(16)));
+    static inline __attribute__((always_inline)) B narrow( V v ) { return __builtin_convertvector(v,B); }
+};
+
+SWAffineWorkspace& threadWorkspace()
+{ static thread_local SWAffineWorkspace ws;
+  return ws; }
+
+}
+
+size_t SWAffineWorkspace::capacity() const
+{
+    return sizeof(short)*(mSeqs.capacity()+mDiags.capacity()+mEnds.capacity())
+            + sizeof(int)*mBounds.capacity() + sizeof(size_t)*mOffsets.capacity() + mTrace.capacity();
+}
+
+// One run of the DP.  Cell (i,j) lies on anti-diagonal d=i+j, and the cells of an anti-diagonal, taken in order
+// of i, depend only on those of the two before it, so each anti-diagonal is filled a vector of rows at a time.
+// Only cells within the band, i-offset-bandwidth <= j <= i-offset+bandwidth, are visited; those outside it,
+// like the scalar code's, score infinity.  Scores are held in int16 lanes, clamped at mInf:  every score below
+// mInf is exact, so the traceback from any cell scoring less than mInf is exactly the scalar one.
+class SWAffineKernel
+{
+public:
+    SWAffineKernel( SWAffineWorkspace& ws, basevector const& S, basevector const& T,
+                    int offset, int bandwidth, bool banded, bool traceback,
+                    bool penalize_left_gap, bool penalize_right_gap,
+                    int mismatch_penalty, int gap_open_penalty, int gap_extend_penalty );
+
+    // Fills in the matrices with the widest kernel the cpu supports.
+    void run();
+
+    // The end of the best alignment, and the state to trace back from, chosen as SmithWatAffine (or, if banded,
+    // SmithWatAffineBandedCoreFast) does.  False if they can't be matched exactly from int16 scores.
+    bool findEnd( bool penalize_right_gap, int& best, int& ii, int& jj, char& from ) const;
+
+    // Scores at least this big are held as this.
+    int infinity() const { return mInf; }
+
+    // Traces back from state from at (i,j), as the scalar code does.
+    void traceback( int i, int j, char from, int& pos1, int& pos2, avector<int>& gaps, avector<int>& lengths ) const;
+
+    template <int W> inline __attribute__((always_inline)) void fill()
+    { if ( mTraceback ) fill<W,true>(); else fill<W,false>(); }
+
+private:
+    template <int W, bool TRACE> inline __attribute__((always_inline)) void fill();
+
+    int const* bounds( int d ) const { return mBounds + 4*d; } // L, H, lo, hi:  band cells, and interior ones
+
+    bool isEdge( int i, int j ) const
+    { int const* b = bounds(i+j);
+      return !i || !j || i < b[2] || i > b[3]; }
+
+    char direction( int i, int j, char from ) const
+    { int d = i+j;
+      unsigned char bits = mTrace[mOffsets[d]+(i-bounds(d)[2])];
+      if ( from == 'x' ) return "xyz"[bits&3];
+      if ( from == 'y' ) return bits&4 ? 'y' : 'x';
+      return bits&8 ? 'z' : 'x'; }
+
+    SWAffineWorkspace& mWS;
+    int mN1, mN2;           // sizes of S and T
+    short mMismatch, mInf;
+    bool mBanded, mTraceback;
+    short* mS;              // mS[i] = S[i-1]
+    short* mT;              // mT[m] = T[N-1-m], so that T[d-i-1] is mT[N-d+i]
+    short* mYOpen;          // y's costs by row
+    short* mYExt;
+    short* mZOpen;          // z's costs by column, reversed like mT
+    short* mZExt;
+    short* mYRow0;          // y along row 0
+    short* mZCol0;          // z down column 0
+    short* mRow[3];         // x, y, z along row n
+    short* mCol[3];         // x, y, z down column N
+    int* mBounds;
+    size_t* mOffsets;
+    unsigned char* mTrace;
+};
+
+SWAffineKernel::SWAffineKernel( SWAffineWorkspace& ws, basevector const& S, basevector const& T,
+                                int offset, int bandwidth, bool banded, bool traceback,
+                                bool penalize_left_gap, bool penalize_right_gap,
+                                int mismatch_penalty, int gap_open_penalty, int gap_extend_penalty )
+: mWS(ws), mN1(S.size()), mN2(T.size()), mMismatch(mismatch_penalty),
+  mInf(32767-std::max(mismatch_penalty,std::max(gap_open_penalty,gap_extend_penalty))),
+  mBanded(banded), mTraceback(traceback)
+{
+    int n = mN1, N = mN2;
+    size_t rowLen = n+1+PAD, colLen = N+1+PAD;
+    grow(ws.mSeqs,3*rowLen+3*colLen+N+1+n+1);
+    mS = ws.mSeqs.data();
+    mYOpen = mS+rowLen;
+    mYExt = mYOpen+rowLen;
+    mT = mYExt+rowLen;
+    mZOpen = mT+colLen;
+    mZExt = mZOpen+colLen;
+    mYRow0 = mZExt+colLen;
+    mZCol0 = mYRow0+N+1;
+
+    // pad S and T with different non-bases, so the lanes past the end never match
+    std::fill(mS,mS+rowLen,4);
+    std::fill(mT,mT+colLen,5);
+    for ( int i = 0; i < n; ++i ) mS[i+1] = S[i];
+    for ( int j = 0; j < N; ++j ) mT[N-1-j] = T[j];
+
+    auto clamp = [this]( long val ) { return short(std::min(val,long(mInf))); };
+    for ( int i = 0; i < int(rowLen); ++i )
+    {   bool free = i == n && !penalize_right_gap;
+        mYOpen[i] = free ? 0 : gap_open_penalty;
+        mYExt[i] = free ? 0 : gap_extend_penalty; }
+    for ( int m = 0; m < int(colLen); ++m )
+    {   bool free = banded && m == 0; // column N
+        mZOpen[m] = free ? 0 : gap_open_penalty;
+        mZExt[m] = free ? 0 : gap_extend_penalty; }
+    mYRow0[0] = mInf;
+    for ( int j = 1; j <= N; ++j )
+        mYRow0[j] = penalize_left_gap ? (banded ? mInf : clamp(gap_open_penalty+long(gap_extend_penalty)*j)) : 0;
+    mZCol0[0] = mInf;
+    for ( int i = 1; i <= n; ++i )
+        mZCol0[i] = banded ? 0 : clamp(gap_open_penalty+long(gap_extend_penalty)*i);
+
+    grow(ws.mEnds,3*(N+1)+3*(n+1));
+    std::fill(ws.mEnds.begin(),ws.mEnds.begin()+3*(N+1)+3*(n+1),mInf);
+    for ( int idx = 0; idx != 3; ++idx )
+    {   mRow[idx] = ws.mEnds.data()+idx*(N+1);
+        mCol[idx] = ws.mEnds.data()+3*(N+1)+idx*(n+1); }
+
+    // the band, and the interior cells of it, on each anti-diagonal
+    int nDiags = n+N+1;
+    grow(ws.mBounds,4*nDiags);
+    grow(ws.mOffsets,nDiags);
+    mBounds = ws.mBounds.data();
+    mOffsets = ws.mOffsets.data();
+    size_t traceLen = 0;
+    for ( int d = 0; d != nDiags; ++d )
+    {
+        int* b = mBounds+4*d;
+        b[0] = std::max(std::max(0,d-N),ceilHalf(d+offset-bandwidth));
+        b[1] = std::min(std::min(n,d),floorHalf(d+offset+bandwidth));
+        b[2] = std::max(b[0],1);
+        b[3] = std::min(b[1],d-1);
+        mOffsets[d] = traceLen;
+        if ( traceback && b[2] <= b[3] ) traceLen += b[3]-b[2]+1+PAD;
+    }
+    grow(ws.mTrace,traceLen);
+    mTrace = ws.mTrace.data();
+}
+
+template <int W, bool TRACE>
+inline __attribute__((always_inline)) void SWAffineKernel::fill()
+{
+    typedef typename Lanes<W>::V V;
+    typedef typename Lanes<W>::B B;
+    #define SWA_LOAD(p) ({ V v_; memcpy(&v_,(p),sizeof(V)); v_; })
+    #define SWA_MIN(a,b) ((a) < (b) ? (a) : (b))
+
+    int n = mN1, N = mN2;
+    short inf = mInf;
+    size_t rowLen = n+1+PAD;
+    grow(mWS.mDiags,9*rowLen);
+    short* diags = mWS.mDiags.data();
+    std::fill(diags,diags+9*rowLen,inf);
+    short *x2 = diags, *y2 = x2+rowLen, *z2 = y2+rowLen;    // anti-diagonal d-2
+    short *x1 = z2+rowLen, *y1 = x1+rowLen, *z1 = y1+rowLen; // d-1
+    short *x0 = z1+rowLen, *y0 = x0+rowLen, *z0 = y0+rowLen; // d
+
+    V const infV = V{}+inf;
+    V const misV = V{}+mMismatch;
+    V const one = V{}+short(1);
+    V const bitY = V{}+short(4);
+    V const bitZ = V{}+short(8);
+    for ( int d = 0, nDiags = n+N+1; d != nDiags; ++d )
+    {
+        int const* b = bounds(d);
+        int L = b[0], H = b[1], lo = b[2], hi = b[3];
+        short const* t = mT+N-d;
+        short const* zOpen = mZOpen+N-d;
+        short const* zExt = mZExt+N-d;
+        unsigned char* trace = TRACE ? mTrace+mOffsets[d]-lo : nullptr;
+        for ( int i = lo; i <= hi; i += W )
+        {
+            V mis = (SWA_LOAD(mS+i) != SWA_LOAD(t+i)) & misV;
+            V xx = SWA_LOAD(x2+i-1)+mis, xy = SWA_LOAD(y2+i-1)+mis, xz = SWA_LOAD(z2+i-1)+mis;
+            V yx = SWA_LOAD(x1+i)+SWA_LOAD(mYOpen+i), yy = SWA_LOAD(y1+i)+SWA_LOAD(mYExt+i);
+            V zx = SWA_LOAD(x1+i-1)+SWA_LOAD(zOpen+i), zz = SWA_LOAD(z1+i-1)+SWA_LOAD(zExt+i);
+            V xm = SWA_MIN(SWA_MIN(xx,xy),xz);
+            V xs = SWA_MIN(xm,infV), ys = SWA_MIN(SWA_MIN(yx,yy),infV), zs = SWA_MIN(SWA_MIN(zx,zz),infV);
+            memcpy(x0+i,&xs,sizeof(V));
+            memcpy(y0+i,&ys,sizeof(V));
+            memcpy(z0+i,&zs,sizeof(V));
+            if ( TRACE )
+            {   // x from x, else y, else z (0, 1, 2), y from y (4) and z from z (8) only when strictly better
+                V bits = ((xx != xm) & (((xy != xm) & one) + one)) | ((yx > yy) & bitY) | ((zx > zz) & bitZ);
+                B bytes = Lanes<W>::narrow(bits);
+                memcpy(trace+i,&bytes,W); }
+        }
+
+        // Lanes past hi wrote junk, and cells just outside the band must read as infinite from the next two
+        // anti-diagonals.  Then the edges of the matrices.
+        if ( L > 0 ) x0[L-1] = y0[L-1] = z0[L-1] = inf;
+        for ( int i = std::max(0,H+1), end = H+W; i <= end; ++i ) x0[i] = y0[i] = z0[i] = inf;
+        if ( L == 0 && H >= 0 )
+        {   x0[0] = d ? inf : 0;
+            y0[0] = mYRow0[d];
+            z0[0] = inf; }
+        if ( d && d >= L && d <= H )
+        {   x0[d] = y0[d] = inf;
+            z0[d] = mZCol0[d]; }
+
+        if ( n >= L && n <= H )
+        {   mRow[0][d-n] = x0[n]; mRow[1][d-n] = y0[n]; mRow[2][d-n] = z0[n]; }
+        if ( d-N >= L && d-N <= H )
+        {   mCol[0][d-N] = x0[d-N]; mCol[1][d-N] = y0[d-N]; mCol[2][d-N] = z0[d-N]; }
+
+        std::swap(x2,x1); std::swap(x1,x0);
+        std::swap(y2,y1); std::swap(y1,y0);
+        std::swap(z2,z1); std::swap(z1,z0);
+    }
+    #undef SWA_MIN
+    #undef SWA_LOAD
+}
+
+namespace
+{
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void fillAVX2( SWAffineKernel& kernel ) { kernel.fill<16>(); }
+__attribute__((target("sse4.1"))) void fillSSE41( SWAffineKernel& kernel ) { kernel.fill<8>(); }
+#endif
+void fillDefault( SWAffineKernel& kernel ) { kernel.fill<8>(); }
+
+typedef void (*FillFunc)( SWAffineKernel& );
+
+FillFunc chooseFill()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) return fillAVX2;
+    if ( __builtin_cpu_supports("sse4.1") ) return fillSSE41;
+#endif
+    return fillDefault;
+}
+
+}
+
+void SWAffineKernel::run()
+{
+    static FillFunc const fill = chooseFill();
+    fill(*this);
+}
+
+bool SWAffineKernel::findEnd( bool penalize_right_gap, int& best, int& ii, int& jj, char& from ) const
+{
+    int n = mN1, N = mN2;
+    auto rowMin = [this]( int k ) { return std::min(mRow[0][k],std::min(mRow[1][k],mRow[2][k])); };
+    auto colMin = [this]( int k ) { return std::min(mCol[0][k],std::min(mCol[1][k],mCol[2][k])); };
+    best = rowMin(N);
+    ii = n, jj = N;
+    if ( mBanded )
+        for ( int k = n; k >= 0; --k )
+            if ( colMin(k) < best ) { best = colMin(k); ii = k; jj = N; }
+    if ( !penalize_right_gap )
+        for ( int k = N, stop = mBanded ? 0 : std::min(n,N); k >= stop; --k )
+            if ( rowMin(k) < best ) { best = rowMin(k); ii = n; jj = k; }
+    if ( best >= mInf || !ii || !jj ) return false;
+
+    // The state to start from.  SmithWatAffine picks it at (n,N) even when the end is elsewhere on row n, so it
+    // must score less than infinity both there and where the trace starts.
+    short* const* ends = mRow;
+    int k = N;
+    if ( mBanded ) k = jj == N ? ii : jj, ends = jj == N ? mCol : mRow;
+    from = pick(ends[0][k],ends[1][k],ends[2][k]);
+    int state = from == 'x' ? 0 : from == 'y' ? 1 : 2;
+    return ends[state][k] < mInf && (jj == N ? mCol[state][ii] : mRow[state][jj]) < mInf;
+}
+
+void SWAffineKernel::traceback( int i, int j, char from, int& pos1, int& pos2,
+                                avector<int>& gaps, avector<int>& lengths ) const
+{
+     int lcount = 0, g1count = 0, g2count = 0;
+     int last_length = 0;
+     gaps.resize(0), lengths.resize(0);
+     while(1)
+     {
+          char dir = direction(i,j,from);
+          if ( from == 'x' )
+          {    if ( g1count > 0 )
+               {    if ( last_length > 0 )
+		    {    gaps.Prepend( g1count );
+		         lengths.Prepend( last_length );    }
+	            g1count = 0;    }
+               if ( g2count > 0 )
+               {    if ( last_length > 0 )
+	            {    gaps.Prepend( -g2count );
+                         lengths.Prepend( last_length );    }
+                    g2count = 0;    }
+               ++lcount;
+               --i;
+               --j;   }
+          else if ( from == 'z' )  // gap on long sequence
+          {    if ( lcount > 0 )
+               {    last_length = lcount;
+                    lcount = 0;    }
+               ForceAssert( g1count == 0 );
+               ++g2count;
+               --i;    }
+          else                     // gap on short sequence
+          {    if ( lcount > 0 )
+               {    last_length = lcount;
+                    lcount = 0;    }
+               ForceAssert( g2count == 0 );
+               ++g1count;
+               --j;    }
+          from = dir;
+          if ( isEdge(i,j) ) break;
+     }
+
+     if ( g1count != 0 ) gaps.Prepend( g1count );
+     else if ( g2count != 0 ) gaps.Prepend( -g2count );
+     else gaps.Prepend(0);
+
+     lengths.Prepend( lcount );
+
+     pos1 = i;
+     pos2 = j;
+
+     if ( gaps(0) < 0 )
+     {   pos2 -= gaps(0);
+         gaps(0) = 0;    }
+
+     if ( gaps(0) > 0 )
+     {   pos1 += gaps(0);
+         gaps(0) = 0;    }
+}
+
+namespace
+{
+
+bool penaltiesFit( int mismatch_penalty, int gap_open_penalty, int gap_extend_penalty )
+{
+    return mismatch_penalty >= 0 && mismatch_penalty <= MAX_PENALTY
+            && gap_open_penalty >= 0 && gap_open_penalty <= MAX_PENALTY
+            && gap_extend_penalty >= 0 && gap_extend_penalty <= MAX_PENALTY;
+}
+
+}
+
+unsigned int SmithWatAffineSIMD( const basevector& S, const basevector& T,
+                                 alignment& a,
+                                 bool penalize_left_gap,
+                                 bool penalize_right_gap,
+                                 const int mismatch_penalty,
+                                 const int gap_open_penalty,
+                                 const int gap_extend_penalty,
+                                 SWAffineWorkspace* ws )
+{
+    ForceAssertGt( S.size(), 0u );
+    ForceAssertGt( T.size(), 0u );
+    if ( penaltiesFit(mismatch_penalty,gap_open_penalty,gap_extend_penalty) )
+    {
+        int n = S.size(), N = T.size();
+        SWAffineKernel kernel(ws ? *ws : threadWorkspace(),S,T,0,n+N+2,false,true,
+                              penalize_left_gap,penalize_right_gap,
+                              mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+        kernel.run();
+        int best, ii, jj;
+        char from;
+        if ( kernel.findEnd(penalize_right_gap,best,ii,jj,from) )
+        {
+            int pos1, pos2;
+            avector<int> gaps, lengths;
+            kernel.traceback(ii,jj,from,pos1,pos2,gaps,lengths);
+            a = alignment(pos1,pos2,best,gaps,lengths);
+            return best;
+        }
+    }
+    return SmithWatAffine(S,T,a,penalize_left_gap,penalize_right_gap,
+                          mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+}
+
+unsigned int SmithWatAffineScoreSIMD( const basevector& S, const basevector& T,
+                                      bool penalize_left_gap,
+                                      bool penalize_right_gap,
+                                      const int mismatch_penalty,
+                                      const int gap_open_penalty,
+                                      const int gap_extend_penalty,
+                                      SWAffineWorkspace* ws )
+{
+    ForceAssertGt( S.size(), 0u );
+    ForceAssertGt( T.size(), 0u );
+    if ( penaltiesFit(mismatch_penalty,gap_open_penalty,gap_extend_penalty) )
+    {
+        int n = S.size(), N = T.size();
+        SWAffineKernel kernel(ws ? *ws : threadWorkspace(),S,T,0,n+N+2,false,false,
+                              penalize_left_gap,penalize_right_gap,
+                              mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+        kernel.run();
+        int best, ii, jj;
+        char from;
+        kernel.findEnd(penalize_right_gap,best,ii,jj,from);
+        if ( best < kernel.infinity() ) return best; // whether or not the trace back could be matched
+    }
+    alignment a;
+    return SmithWatAffine(S,T,a,penalize_left_gap,penalize_right_gap,
+                          mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+}
+
+unsigned int SmithWatAffineBandedSIMD( const basevector& S, const basevector& T,
+                                       int offset, int bandwidth,
+                                       align& a, int& error,
+                                       const int mismatch_penalty,
+                                       const int gap_open_penalty,
+                                       const int gap_extend_penalty,
+                                       SWAffineWorkspace* ws )
+{
+    ForceAssertGt(S.isize(), 0);
+    ForceAssertGt(T.isize(), 0);
+    ForceAssertGt(bandwidth, 0);
+
+    // as SmithWatAffineBanded:  just the part of T the band reaches
+    int t_start = Max(0, -offset - bandwidth);
+    int t_stop = Min(T.isize(), S.isize() - offset + bandwidth);
+    if (t_start >= t_stop) {
+        a = alignment();
+        return SWA_Infinity;
+    }
+    if ( !penaltiesFit(mismatch_penalty,gap_open_penalty,gap_extend_penalty) )
+        return SmithWatAffineBanded(S,T,offset,bandwidth,a,error,
+                                    mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+    basevector T2(T, t_start, t_stop - t_start);
+    SWAffineKernel kernel(ws ? *ws : threadWorkspace(),S,T2,t_start+offset,bandwidth,true,true,false,false,
+                          mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+    kernel.run();
+    int score, ii, jj;
+    char from;
+    if ( !kernel.findEnd(false,score,ii,jj,from) )
+        return SmithWatAffineBanded(S,T,offset,bandwidth,a,error,
+                                    mismatch_penalty,gap_open_penalty,gap_extend_penalty);
+    int pos1, pos2;
+    avector<int> gaps, lengths;
+    kernel.traceback(ii,jj,from,pos1,pos2,gaps,lengths);
+    a = align(pos1,pos2,gaps,lengths);
+    error = a.Errors(S, T2);
+    a.Setpos2(a.pos2()  + t_start);
+    if ( a.pos1() < 0 || a.pos2() < 0 || a.Pos1() > (int)S.size()
+            || a.Pos2() > (int)T.size() ) {
+        a = align();
+        score = SWA_Infinity;
+    }
+    return score;
+}
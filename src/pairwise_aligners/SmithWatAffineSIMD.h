@@ -0,0 +1,63 @@
+//
+// SmithWatAffineSIMD.h: SmithWatAffine and SmithWatAffineBanded on an anti-diagonal, int16 SIMD kernel.
+//
+
+#ifndef SMITHWATAFFINESIMD
+#define SMITHWATAFFINESIMD
+
+#include "Alignment.h"
+#include "Basevector.h"
+#include <cstddef>
+#include <vector>
+
+// The buffers the SIMD aligner works in, grown as needed and never shrunk.  Keep one per thread and pass it to
+// each call to save the allocations; calls given no workspace use one belonging to the calling thread.
+class SWAffineWorkspace
+{
+public:
+    // bytes held
+    size_t capacity() const;
+
+private:
+    friend class SWAffineKernel;
+
+    std::vector<short> mSeqs;       // S, reversed T, per-row and per-column penalties, edge scores
+    std::vector<short> mDiags;      // x, y, z scores of the last three anti-diagonals
+    std::vector<short> mEnds;       // x, y, z scores along the last row and the last column
+    std::vector<int> mBounds;       // first and last interior row of each anti-diagonal
+    std::vector<size_t> mOffsets;   // where each anti-diagonal's traceback starts
+    std::vector<unsigned char> mTrace; // traceback:  2 bits for x, 1 for y, 1 for z, per cell
+};
+
+// Scoring, alignment and tie-breaking are exactly those of SmithWatAffine (SmithWatAffine.h), so the results are
+// identical.  The kernel sweeps the anti-diagonals of the three DP matrices with 16 (AVX2) or 8 (SSE4.1 or
+// plain SSE2) int16 lanes, chosen at run time, and keeps one byte of traceback per cell.  Scores that might
+// not fit in the lanes, and the rare ends it can't trace back exactly, are handed to SmithWatAffine.
+unsigned int SmithWatAffineSIMD( const basevector& S, const basevector& T,
+                                 alignment& a,
+                                 bool penalize_left_gap = true,
+                                 bool penalize_right_gap = true,
+                                 const int mismatch_penalty = 3,
+                                 const int gap_open_penalty = 12,
+                                 const int gap_extend_penalty = 1,
+                                 SWAffineWorkspace* ws = nullptr );
+
+// The score SmithWatAffineSIMD would return, without keeping the traceback.
+unsigned int SmithWatAffineScoreSIMD( const basevector& S, const basevector& T,
+                                      bool penalize_left_gap = true,
+                                      bool penalize_right_gap = true,
+                                      const int mismatch_penalty = 3,
+                                      const int gap_open_penalty = 12,
+                                      const int gap_extend_penalty = 1,
+                                      SWAffineWorkspace* ws = nullptr );
+
+// SmithWatAffineBanded on the same kernel, visiting only the band.
+unsigned int SmithWatAffineBandedSIMD( const basevector& S, const basevector& T,
+                                       int offset, int bandwidth,
+                                       align& a, int& nerrors,
+                                       const int mismatch_penalty = 3,
+                                       const int gap_open_penalty = 12,
+                                       const int gap_extend_penalty = 1,
+                                       SWAffineWorkspace* ws = nullptr );
+
+#endif
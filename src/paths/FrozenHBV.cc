@@ -0,0 +1,99 @@
+//
+// FrozenHBV.cc: an immutable, flat snapshot of a HyperBasevector's topology, for read-only traversals.
+//
+
+#include "paths/FrozenHBV.h"
+#include "graph/EdgePaths.h"
+#include "graph/FindSomeCells.h"
+
+void FrozenHBV::build( HyperBasevector const& hb, vec<int> const* inv )
+{
+    int const nVerts = hb.N();
+    int const nEdges = hb.EdgeObjectCount();
+    mK = hb.K();
+
+    // Run starts are a prefix sum of the degrees; everything else is filled in place, a vertex or edge at a time.
+    mFromStart.assign(nVerts+1,0);
+    mToStart.assign(nVerts+1,0);
+    for ( int v = 0; v != nVerts; ++v )
+    {   mFromStart[v+1] = mFromStart[v]+hb.From(v).isize();
+        mToStart[v+1] = mToStart[v]+hb.To(v).isize(); }
+    mFromEdges.resize(mFromStart.back());
+    mFromVerts.resize(mFromStart.back());
+    mToEdges.resize(mToStart.back());
+    mToVerts.resize(mToStart.back());
+    mToLeft.assign(nEdges,-1);
+    mToRight.assign(nEdges,-1);
+    mBases.resize(nEdges);
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static,10000) nowait
+        for ( int v = 0; v < nVerts; ++v )
+        {
+            vec<int> const& from = hb.From(v);
+            vec<int> const& fromEdges = hb.FromEdgeObj(v);
+            std::copy(from.begin(),from.end(),mFromVerts.begin()+mFromStart[v]);
+            std::copy(fromEdges.begin(),fromEdges.end(),mFromEdges.begin()+mFromStart[v]);
+            for ( int e : fromEdges ) mToLeft[e] = v;
+
+            vec<int> const& to = hb.To(v);
+            vec<int> const& toEdges = hb.ToEdgeObj(v);
+            std::copy(to.begin(),to.end(),mToVerts.begin()+mToStart[v]);
+            std::copy(toEdges.begin(),toEdges.end(),mToEdges.begin()+mToStart[v]);
+            for ( int e : toEdges ) mToRight[e] = v;
+        }
+
+        #pragma omp for schedule(static,10000)
+        for ( int e = 0; e < nEdges; ++e )
+            mBases[e] = hb.EdgeLengthBases(e);
+    }
+
+    if ( inv )
+    {   ForceAssertEq(inv->isize(),nEdges);
+        mInv.assign(inv->begin(),inv->end()); }
+    else
+        mInv.clear();
+}
+
+void FrozenHBV::assign( int K, std::vector<int> fromStart, std::vector<int> fromVerts, std::vector<int> fromEdges,
+                        std::vector<int> toStart, std::vector<int> toVerts, std::vector<int> toEdges,
+                        std::vector<int> bases, std::vector<int> inv )
+{
+    int const nVerts = fromStart.empty() ? 0 : fromStart.size()-1;
+    int const nEdges = bases.size();
+    if ( toStart.size() != fromStart.size() || fromVerts.size() != fromEdges.size()
+            || toVerts.size() != toEdges.size() || (!inv.empty() && inv.size() != bases.size())
+            || (nVerts && (fromStart.back() != int(fromEdges.size()) || toStart.back() != int(toEdges.size()))) )
+        FatalErr("FrozenHBV::assign was given inconsistent tables.");
+    mK = K;
+    mFromStart.swap(fromStart);
+    mFromVerts.swap(fromVerts);
+    mFromEdges.swap(fromEdges);
+    mToStart.swap(toStart);
+    mToVerts.swap(toVerts);
+    mToEdges.swap(toEdges);
+    mBases.swap(bases);
+    mInv.swap(inv);
+    mToLeft.assign(nEdges,-1);
+    mToRight.assign(nEdges,-1);
+
+    #pragma omp parallel for schedule(static,10000)
+    for ( int v = 0; v < nVerts; ++v )
+    {
+        for ( int e : FromEdges(v) ) mToLeft[e] = v;
+        for ( int e : ToEdges(v) ) mToRight[e] = v;
+    }
+}
+
+Bool FrozenHBV::EdgePaths( int v, int w, vec< vec<int> >& paths, int max_copies,
+                           int max_paths, int max_iterations ) const
+{
+    return EdgePathsIn([this]( int x ) { return FromEdges(x); },mToRight,v,w,paths,
+                       max_copies,max_paths,max_iterations);
+}
+
+void FindSomeCells( FrozenHBV const& G, int max_cell_size, int max_depth, vec< std::pair<int,int> >& bounds )
+{
+    FindSomeCellsIn(G,max_cell_size,max_depth,bounds);
+}
@@ -0,0 +1,104 @@
+//
+// FrozenHBV.h: an immutable, flat snapshot of a HyperBasevector's topology, for read-only traversals.
+//
+
+#ifndef FROZENHBV_H
+#define FROZENHBV_H
+
+#include "Vec.h"
+#include "paths/HyperBasevector.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// The adjacency of a HyperBasevector in compressed sparse row form:  for each vertex, the edges leaving and entering
+// it (and the vertices at their far ends) lie in one contiguous run of a single array, in the graph's own order,
+// beside per-edge tables of end vertices, lengths and, optionally, the involution.  A walk across the graph then
+// touches a few flat arrays instead of chasing the per-vertex vecs of digraphE.  The snapshot doesn't follow
+// changes to the graph:  build it again after editing.
+//
+// Vertex access mirrors digraph (From, To, IFrom, ITo), so vertex-level algorithms can be written once for both.
+class FrozenHBV
+{
+public:
+    // A run of vertex or edge ids.
+    class Ids
+    {
+    public:
+        Ids( int const* beg, int const* end ) : mBeg(beg), mEnd(end) {}
+
+        int const* begin() const { return mBeg; }
+        int const* end() const { return mEnd; }
+        size_t size() const { return mEnd-mBeg; }
+        int isize() const { return mEnd-mBeg; }
+        bool empty() const { return mBeg == mEnd; }
+        bool solo() const { return mEnd-mBeg == 1; }
+        int operator[]( size_t idx ) const { return mBeg[idx]; }
+        bool contains( int id ) const { return std::find(mBeg,mEnd,id) != mEnd; }
+
+    private:
+        int const* mBeg;
+        int const* mEnd;
+    };
+
+    FrozenHBV() : mK(0) {}
+
+    // inv may be null, in which case Inv() mustn't be called.
+    explicit FrozenHBV( HyperBasevector const& hb, vec<int> const* inv = nullptr )
+    { build(hb,inv); }
+
+    // (Re)builds the snapshot, in parallel and in time linear in the size of the graph.
+    void build( HyperBasevector const& hb, vec<int> const* inv = nullptr );
+
+    // Takes the tables from elsewhere (a checkpoint, say), so the graph itself needn't be built:  the run starts
+    // (N+1 of them), vertices and edges of the from and to adjacencies, the edge lengths in bases, and the
+    // involution, which may be empty.  The edges' end vertices are derived.
+    void assign( int K, std::vector<int> fromStart, std::vector<int> fromVerts, std::vector<int> fromEdges,
+                 std::vector<int> toStart, std::vector<int> toVerts, std::vector<int> toEdges,
+                 std::vector<int> bases, std::vector<int> inv );
+
+    int N() const { return mFromStart.empty() ? 0 : mFromStart.size()-1; }
+    int E() const { return mToLeft.size(); }
+    int K() const { return mK; }
+
+    // the vertices at the heads of the edges leaving v, and at the tails of those entering it
+    Ids From( int v ) const { return ids(mFromVerts,mFromStart,v); }
+    Ids To( int v ) const { return ids(mToVerts,mToStart,v); }
+
+    // the edges leaving and entering v:  FromEdges(v)[j] goes to From(v)[j]
+    Ids FromEdges( int v ) const { return ids(mFromEdges,mFromStart,v); }
+    Ids ToEdges( int v ) const { return ids(mToEdges,mToStart,v); }
+    int IFrom( int v, int j ) const { return mFromEdges[mFromStart[v]+j]; }
+    int ITo( int v, int j ) const { return mToEdges[mToStart[v]+j]; }
+
+    // the edges that can follow e, and those that can precede it
+    Ids Next( int e ) const { return FromEdges(mToRight[e]); }
+    Ids Prev( int e ) const { return ToEdges(mToLeft[e]); }
+
+    int ToLeft( int e ) const { return mToLeft[e]; }
+    int ToRight( int e ) const { return mToRight[e]; }
+    int Bases( int e ) const { return mBases[e]; }
+    int Kmers( int e ) const { return mBases[e]-mK+1; }
+    bool HasInv() const { return !mInv.empty(); }
+    int Inv( int e ) const { return mInv[e]; }
+
+    // HyperBasevector::EdgePaths, sharing its body (graph/EdgePaths.h):  all paths of edges from vertex v to
+    // vertex w, searched depth-first.
+    Bool EdgePaths( int v, int w, vec< vec<int> >& paths, int max_copies = -1,
+                    int max_paths = -1, int max_iterations = -1 ) const;
+
+private:
+    static Ids ids( std::vector<int> const& vals, std::vector<int> const& start, int v )
+    { int const* base = vals.data(); return Ids(base+start[v],base+start[v+1]); }
+
+    int mK;
+    std::vector<int> mFromStart, mFromEdges, mFromVerts; // CSR by tail vertex
+    std::vector<int> mToStart, mToEdges, mToVerts;       // CSR by head vertex
+    std::vector<int> mToLeft, mToRight, mBases, mInv;    // per edge
+};
+
+// FindSomeCells (graph/FindCells.h) on a frozen graph, sharing its body (graph/FindSomeCells.h):  it walks flat
+// arrays, and is much faster on big graphs.
+void FindSomeCells( FrozenHBV const& G, int max_cell_size, int max_depth, vec< std::pair<int,int> >& bounds );
+
+#endif // FROZENHBV_H
@@ -0,0 +1,686 @@
+//
+// HBVCheckpoint.cc: sectioned, optionally compressed HyperBasevector snapshots for step checkpoints.
+//
+
+#include "paths/HBVCheckpoint.h"
+#include "feudal/BinaryStream.h"
+#include "paths/FrozenHBV.h"
+#include "system/System.h"
+#include "system/file/FileReader.h"
+#include "system/file/FileWriter.h"
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <omp.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+namespace
+{
+
+// "HBV_CKPT"
+uint64_t const HBV_CHECKPOINT_MAGIC = 0x48425f434b50545ful;
+uint64_t const HBV_CHECKPOINT_VERSION = 1;
+
+size_t const BLOCK_SIZE = 4ul << 20;
+int const COMPRESSION_LEVEL = 1; // the filesystem is the bottleneck, not the CPU
+
+enum SectionID : uint32_t
+{
+    EDGE_LENGTHS = 1,   // uint32_t per edge, in bases
+    EDGE_BASES,         // each edge's base bits, (length+3)/4 bytes per edge
+    FROM_STARTS,        // uint64_t per vertex, plus one
+    FROM_VERTICES,      // int per adjacency
+    FROM_EDGES,
+    TO_STARTS,
+    TO_VERTICES,
+    TO_EDGES,
+    INVOLUTION          // int per edge; optional
+};
+
+enum Codec : uint32_t { RAW = 0, ZLIB_BLOCKS = 1 };
+
+struct Header
+{
+    uint64_t magic;
+    uint64_t version;
+    int64_t K;
+    uint64_t nVertices;
+    uint64_t nEdges;
+    uint64_t nSections;
+    uint64_t blockSize;
+};
+
+struct SectionEntry
+{
+    uint32_t id;
+    uint32_t codec;
+    uint64_t rawSize;
+    uint64_t offset;
+    uint64_t storedSize;
+};
+
+// A ZLIB_BLOCKS section is a uint64_t block count, the stored size of each block, and the blocks.  Every block
+// but the last holds blockSize raw bytes.
+
+template <class T>
+T* resizeAs( std::vector<char>& buf, size_t n )
+{
+    buf.resize(n*sizeof(T));
+    return reinterpret_cast<T*>(buf.data());
+}
+
+size_t align8( size_t off ) { return (off+7) & ~7ul; }
+
+void flattenAdjacencies( vec<vec<int>> const& verts, vec<vec<int>> const& edges,
+                            std::vector<char>& starts, std::vector<char>& vertices, std::vector<char>& edgeIDs )
+{
+    size_t nVerts = verts.size();
+    uint64_t* pStarts = resizeAs<uint64_t>(starts,nVerts+1);
+    pStarts[0] = 0;
+    for ( size_t v = 0; v < nVerts; ++v )
+    {
+        if ( verts[v].size() != edges[v].size() )
+            FatalErr("HyperBasevector's adjacency lists are inconsistent at vertex " << v << '.');
+        pStarts[v+1] = pStarts[v] + verts[v].size();
+    }
+    int* pVerts = resizeAs<int>(vertices,pStarts[nVerts]);
+    int* pEdges = resizeAs<int>(edgeIDs,pStarts[nVerts]);
+    #pragma omp parallel for schedule(dynamic,10000)
+    for ( size_t v = 0; v < nVerts; ++v )
+    {
+        std::copy(verts[v].begin(),verts[v].end(),pVerts+pStarts[v]);
+        std::copy(edges[v].begin(),edges[v].end(),pEdges+pStarts[v]);
+    }
+}
+
+void unflattenAdjacencies( size_t nVerts, char const* starts, char const* vertices, char const* edgeIDs,
+                            vec<vec<int>>& verts, vec<vec<int>>& edges )
+{
+    uint64_t const* pStarts = reinterpret_cast<uint64_t const*>(starts);
+    int const* pVerts = reinterpret_cast<int const*>(vertices);
+    int const* pEdges = reinterpret_cast<int const*>(edgeIDs);
+    verts.clear();
+    verts.resize(nVerts);
+    edges.clear();
+    edges.resize(nVerts);
+    #pragma omp parallel for schedule(dynamic,10000)
+    for ( size_t v = 0; v < nVerts; ++v )
+    {
+        verts[v].assign(pVerts+pStarts[v],pVerts+pStarts[v+1]);
+        edges[v].assign(pEdges+pStarts[v],pEdges+pStarts[v+1]);
+    }
+}
+
+// Reads the magic number; false for files in the old BinaryWriter format.
+bool hasCheckpointMagic( FileReader& fr, size_t fileSize )
+{
+    uint64_t magic = 0;
+    if ( fileSize >= sizeof(magic) ) fr.seek(0).read(&magic,sizeof(magic));
+    return magic == HBV_CHECKPOINT_MAGIC;
+}
+
+// Reads and checks the header.  Returns the offset at which the section table ends.
+size_t readHeader( FileReader& fr, size_t fileSize, Header& hdr, std::string const& filename )
+{
+    if ( fileSize < sizeof(hdr) )
+        FatalErr("Checkpoint " << filename << " is truncated.");
+    fr.seek(0).read(&hdr,sizeof(hdr));
+    if ( hdr.version != HBV_CHECKPOINT_VERSION )
+        FatalErr("Checkpoint " << filename << " has format version " << hdr.version
+                 << ", but this code reads version " << HBV_CHECKPOINT_VERSION << '.');
+    if ( hdr.nSections > (fileSize-sizeof(hdr))/sizeof(SectionEntry) )
+        FatalErr("Checkpoint " << filename << " is truncated.");
+    if ( !hdr.blockSize )
+        FatalErr("Checkpoint " << filename << " is corrupt: its block size is 0.");
+    return sizeof(hdr) + hdr.nSections*sizeof(SectionEntry);
+}
+
+void checkBounds( SectionEntry const& entry, size_t tableEnd, size_t fileSize, std::string const& filename )
+{
+    if ( entry.offset < tableEnd || entry.offset > fileSize || entry.storedSize > fileSize-entry.offset )
+        FatalErr("Checkpoint " << filename << " is corrupt: section " << entry.id << " is out of bounds.");
+}
+
+// Whether a flattened adjacency array holds together:  the starts run up from 0 to nAdj, and every vertex and
+// edge id is in range.
+bool adjacenciesConsistent( uint64_t const* starts, size_t nVerts, int const* verts, int const* edges, size_t nAdj,
+                            size_t nEdges )
+{
+    if ( starts[0] || starts[nVerts] != nAdj ) return false;
+    for ( size_t v = 0; v != nVerts; ++v )
+        if ( starts[v] > starts[v+1] ) return false;
+    for ( size_t idx = 0; idx != nAdj; ++idx )
+        if ( size_t(verts[idx]) >= nVerts || size_t(edges[idx]) >= nEdges ) return false;
+    return true;
+}
+
+// Whether every entry of an involution is an edge id.
+bool involutionInRange( int const* inv, size_t nEdges )
+{
+    for ( size_t e = 0; e != nEdges; ++e )
+        if ( size_t(inv[e]) >= nEdges ) return false;
+    return true;
+}
+
+// The stored sizes of a ZLIB_BLOCKS section's blocks, after checking its block table.
+uint64_t const* blockSizes( char const* stored, SectionEntry const& entry, uint64_t blockSize, uint64_t& nBlocks,
+                            std::string const& filename )
+{
+    if ( entry.storedSize < sizeof(nBlocks) )
+        FatalErr("Checkpoint " << filename << " is corrupt: section " << entry.id << " has a bad block table.");
+    memcpy(&nBlocks,stored,sizeof(nBlocks));
+    if ( nBlocks != (entry.rawSize+blockSize-1)/blockSize
+            || (nBlocks+1)*sizeof(uint64_t) > entry.storedSize )
+        FatalErr("Checkpoint " << filename << " is corrupt: section " << entry.id << " has a bad block table.");
+    return reinterpret_cast<uint64_t const*>(stored)+1;
+}
+
+void inflateBlock( char const* src, size_t srcLen, char* dst, size_t dstLen, std::string const& filename )
+{
+    uLongf len = dstLen;
+    int status = uncompress(reinterpret_cast<Bytef*>(dst),&len,reinterpret_cast<Bytef const*>(src),srcLen);
+    if ( status != Z_OK || len != dstLen )
+        FatalErr("Checkpoint " << filename << " is corrupt: a block won't decompress (zlib error "
+                 << status << ").");
+}
+
+struct BlockJob
+{
+    char const* src;
+    size_t srcLen;
+    char* dst;
+    size_t dstLen;
+};
+
+// Writes the sections of a checkpoint one after another, each as soon as it's built.  A compressed section goes
+// out a round of blocks at a time, so only the raw section and one round of compressed blocks are ever held;
+// its block table, and the section table, are filled in behind it.
+class SectionWriter
+{
+public:
+    SectionWriter( std::string const& filename, Header const& hdr, bool compress )
+    : mFilename(filename), mFW(filename), mTable(hdr.nSections), mCompress(compress), mNext(0)
+    {
+        mFW.write(&hdr,sizeof(hdr));
+        mFW.write(mTable.data(),mTable.size()*sizeof(SectionEntry));
+        mOff = sizeof(hdr) + mTable.size()*sizeof(SectionEntry);
+    }
+
+    // writes raw as the next section, and frees it
+    void write( SectionID id, std::vector<char>& raw );
+
+    void close()
+    {
+        if ( mNext != mTable.size() )
+            FatalErr("Checkpoint " << mFilename << " has " << mNext << " of its " << mTable.size() << " sections.");
+        mFW.seek(sizeof(Header));
+        mFW.write(mTable.data(),mTable.size()*sizeof(SectionEntry));
+        mFW.close();
+    }
+
+private:
+    std::string mFilename;
+    FileWriter mFW;
+    std::vector<SectionEntry> mTable;
+    bool mCompress;
+    size_t mNext;
+    size_t mOff;
+};
+
+void SectionWriter::write( SectionID id, std::vector<char>& raw )
+{
+    char const padding[8] = {0};
+    mFW.write(padding,align8(mOff)-mOff);
+    SectionEntry& entry = mTable[mNext++];
+    entry.id = id;
+    entry.codec = mCompress ? ZLIB_BLOCKS : RAW;
+    entry.rawSize = raw.size();
+    entry.offset = mOff = align8(mOff);
+    entry.storedSize = raw.size();
+    if ( !mCompress )
+        mFW.write(raw.data(),raw.size());
+    else
+    {
+        size_t nBlocks = (raw.size()+BLOCK_SIZE-1)/BLOCK_SIZE;
+        std::vector<uint64_t> sizes(nBlocks+1,0);
+        sizes[0] = nBlocks;
+        mFW.write(sizes.data(),sizes.size()*sizeof(uint64_t));
+        entry.storedSize = sizes.size()*sizeof(uint64_t);
+        size_t const blocksPerRound = 2*std::max(omp_get_max_threads(),1);
+        std::vector<std::vector<char>> blocks(std::min(blocksPerRound,nBlocks));
+        for ( size_t first = 0; first < nBlocks; first += blocksPerRound )
+        {
+            size_t last = std::min(nBlocks,first+blocksPerRound);
+            #pragma omp parallel for schedule(dynamic,1)
+            for ( size_t blk = first; blk < last; ++blk )
+            {
+                size_t off = blk*BLOCK_SIZE;
+                uLong srcLen = std::min(BLOCK_SIZE,raw.size()-off);
+                std::vector<char>& dst = blocks[blk-first];
+                uLongf dstLen = compressBound(srcLen);
+                dst.resize(dstLen);
+                int status = compress2(reinterpret_cast<Bytef*>(dst.data()),&dstLen,
+                                        reinterpret_cast<Bytef const*>(raw.data()+off),srcLen,
+                                        COMPRESSION_LEVEL);
+                if ( status != Z_OK )
+                    FatalErr("Failed to compress checkpoint " << mFilename << ": zlib error " << status << '.');
+                dst.resize(dstLen);
+            }
+            for ( size_t blk = first; blk != last; ++blk )
+            {   std::vector<char> const& block = blocks[blk-first];
+                mFW.write(block.data(),block.size());
+                sizes[blk+1] = block.size();
+                entry.storedSize += block.size(); }
+        }
+        mFW.seek(entry.offset);
+        mFW.write(sizes.data(),sizes.size()*sizeof(uint64_t));
+        mFW.seekEnd();
+    }
+    mOff += entry.storedSize;
+    std::vector<char>().swap(raw);
+}
+
+void writeCheckpoint( HyperBasevector const& hbv, vec<int> const* pInv, std::string const& filename,
+                        bool compress )
+{
+    size_t nEdges = hbv.EdgeObjectCount();
+    size_t nVerts = hbv.N();
+    if ( pInv && pInv->size() != nEdges )
+        FatalErr("Involution has " << pInv->size() << " entries for " << nEdges << " edges.");
+
+    Header hdr;
+    hdr.magic = HBV_CHECKPOINT_MAGIC;
+    hdr.version = HBV_CHECKPOINT_VERSION;
+    hdr.K = hbv.K();
+    hdr.nVertices = nVerts;
+    hdr.nEdges = nEdges;
+    hdr.nSections = pInv ? INVOLUTION : TO_EDGES;
+    hdr.blockSize = BLOCK_SIZE;
+    SectionWriter writer(filename,hdr,compress);
+
+    // edges
+    std::vector<char> raw;
+    uint32_t* pLens = resizeAs<uint32_t>(raw,nEdges);
+    std::vector<uint64_t> baseStarts(nEdges+1);
+    baseStarts[0] = 0;
+    for ( size_t e = 0; e != nEdges; ++e )
+    {
+        size_t len = hbv.EdgeObject(e).size();
+        if ( len > std::numeric_limits<uint32_t>::max() )
+            FatalErr("Edge " << e << " is too long to checkpoint: " << len << " bases.");
+        pLens[e] = len;
+        baseStarts[e+1] = baseStarts[e] + (len+3)/4;
+    }
+    writer.write(EDGE_LENGTHS,raw);
+    char* pBases = resizeAs<char>(raw,baseStarts[nEdges]);
+    #pragma omp parallel for schedule(dynamic,10000)
+    for ( size_t e = 0; e < nEdges; ++e )
+        hbv.EdgeObject(e).extractBaseBits(pBases+baseStarts[e],baseStarts[e+1]-baseStarts[e]);
+    writer.write(EDGE_BASES,raw);
+
+    // adjacencies
+    std::vector<char> raw2, raw3;
+    flattenAdjacencies(hbv.From(),hbv.FromEdgeObj(),raw,raw2,raw3);
+    writer.write(FROM_STARTS,raw);
+    writer.write(FROM_VERTICES,raw2);
+    writer.write(FROM_EDGES,raw3);
+    flattenAdjacencies(hbv.To(),hbv.ToEdgeObj(),raw,raw2,raw3);
+    writer.write(TO_STARTS,raw);
+    writer.write(TO_VERTICES,raw2);
+    writer.write(TO_EDGES,raw3);
+
+    if ( pInv )
+    {
+        int* pInvOut = resizeAs<int>(raw,nEdges);
+        std::copy(pInv->begin(),pInv->end(),pInvOut);
+        writer.write(INVOLUTION,raw);
+    }
+    writer.close();
+}
+
+bool loadCheckpoint( HyperBasevector& hbv, vec<int>* pInv, std::string const& filename )
+{
+    FileReader fr(filename);
+    size_t fileSize = fr.getSize();
+    if ( !hasCheckpointMagic(fr,fileSize) )
+    {
+        fr.close();
+        BinaryReader::readFile(filename,&hbv);
+        return false;
+    }
+    Header hdr;
+    size_t tableEnd = readHeader(fr,fileSize,hdr,filename);
+
+    void* map = fr.map(0,fileSize,true);
+    madvise(map,fileSize,MADV_WILLNEED);
+    fr.close();
+    char const* base = static_cast<char const*>(map);
+    SectionEntry const* table = reinterpret_cast<SectionEntry const*>(base+sizeof(hdr));
+
+    // find the sections, and queue the decompression of every block of every compressed one
+    std::vector<char const*> data(INVOLUTION+1,nullptr);
+    std::vector<bool> present(INVOLUTION+1,false);
+    std::vector<size_t> rawSizes(INVOLUTION+1,0);
+    std::vector<std::vector<char>> buffers(INVOLUTION+1);
+    std::vector<BlockJob> jobs;
+    for ( size_t idx = 0; idx != hdr.nSections; ++idx )
+    {
+        SectionEntry const& entry = table[idx];
+        checkBounds(entry,tableEnd,fileSize,filename);
+        if ( entry.id < EDGE_LENGTHS || entry.id > INVOLUTION ) continue; // from a later version
+        if ( entry.id == INVOLUTION && !pInv ) continue;
+        char const* stored = base+entry.offset;
+        rawSizes[entry.id] = entry.rawSize;
+        present[entry.id] = true;
+        if ( entry.codec == RAW )
+        {
+            if ( entry.storedSize != entry.rawSize )
+                FatalErr("Checkpoint " << filename << " is corrupt: section " << entry.id << " has the wrong size.");
+            data[entry.id] = stored;
+            continue;
+        }
+        if ( entry.codec != ZLIB_BLOCKS )
+            FatalErr("Checkpoint " << filename << " uses unknown codec " << entry.codec << '.');
+        uint64_t nBlocks;
+        uint64_t const* sizes = blockSizes(stored,entry,hdr.blockSize,nBlocks,filename);
+        std::vector<char>& buf = buffers[entry.id];
+        buf.resize(entry.rawSize);
+        data[entry.id] = buf.data();
+        char const* src = stored + (nBlocks+1)*sizeof(uint64_t);
+        char const* srcEnd = stored + entry.storedSize;
+        for ( uint64_t blk = 0; blk != nBlocks; ++blk )
+        {
+            if ( sizes[blk] > size_t(srcEnd-src) )
+                FatalErr("Checkpoint " << filename << " is corrupt: section " << entry.id << " is truncated.");
+            size_t dstOff = blk*hdr.blockSize;
+            jobs.push_back({src,sizes[blk],buf.data()+dstOff,std::min<size_t>(hdr.blockSize,entry.rawSize-dstOff)});
+            src += sizes[blk];
+        }
+    }
+    #pragma omp parallel for schedule(dynamic,1)
+    for ( size_t job = 0; job < jobs.size(); ++job )
+    {
+        BlockJob const& bj = jobs[job];
+        inflateBlock(bj.src,bj.srcLen,bj.dst,bj.dstLen,filename);
+    }
+
+    // check that everything's there and sized right
+    size_t nEdges = hdr.nEdges, nVerts = hdr.nVertices;
+    for ( uint32_t id = EDGE_LENGTHS; id <= TO_EDGES; ++id )
+        if ( !present[id] )
+            FatalErr("Checkpoint " << filename << " is corrupt: section " << id << " is missing.");
+    uint32_t const* pLens = reinterpret_cast<uint32_t const*>(data[EDGE_LENGTHS]);
+    if ( rawSizes[EDGE_LENGTHS] != nEdges*sizeof(uint32_t) )
+        FatalErr("Checkpoint " << filename << " is corrupt: it has the wrong number of edge lengths.");
+    std::vector<uint64_t> baseStarts(nEdges+1);
+    baseStarts[0] = 0;
+    for ( size_t e = 0; e != nEdges; ++e )
+        baseStarts[e+1] = baseStarts[e] + (pLens[e]+3ul)/4;
+    if ( rawSizes[EDGE_BASES] != baseStarts[nEdges] )
+        FatalErr("Checkpoint " << filename << " is corrupt: its edge bases don't match the edge lengths.");
+    for ( uint32_t id : {FROM_STARTS,TO_STARTS} )
+    {
+        size_t nAdj = rawSizes[id+1]/sizeof(int);
+        bool ok = rawSizes[id] == (nVerts+1)*sizeof(uint64_t) && rawSizes[id+1] == nAdj*sizeof(int)
+                    && rawSizes[id+2] == rawSizes[id+1]
+                    && adjacenciesConsistent(reinterpret_cast<uint64_t const*>(data[id]),nVerts,
+                                             reinterpret_cast<int const*>(data[id+1]),
+                                             reinterpret_cast<int const*>(data[id+2]),nAdj,nEdges);
+        if ( !ok )
+            FatalErr("Checkpoint " << filename << " is corrupt: its adjacency arrays are inconsistent.");
+    }
+    bool haveInv = pInv && present[INVOLUTION];
+    if ( haveInv && rawSizes[INVOLUTION] != nEdges*sizeof(int) )
+        FatalErr("Checkpoint " << filename << " is corrupt: its involution has the wrong size.");
+    if ( haveInv && !involutionInRange(reinterpret_cast<int const*>(data[INVOLUTION]),nEdges) )
+        FatalErr("Checkpoint " << filename << " is corrupt: its involution maps to an edge that doesn't exist.");
+
+    // rebuild
+    hbv.SetK(hdr.K);
+    vec<basevector>& edges = hbv.EdgesMutable();
+    edges.clear();
+    edges.resize(nEdges);
+    char const* pBases = data[EDGE_BASES];
+    #pragma omp parallel for schedule(dynamic,10000)
+    for ( size_t e = 0; e < nEdges; ++e )
+        edges[e].assignBaseBits(pLens[e],pBases+baseStarts[e]);
+    unflattenAdjacencies(nVerts,data[FROM_STARTS],data[FROM_VERTICES],data[FROM_EDGES],
+                            hbv.FromMutable(),hbv.FromEdgeObjMutable());
+    unflattenAdjacencies(nVerts,data[TO_STARTS],data[TO_VERTICES],data[TO_EDGES],
+                            hbv.ToMutable(),hbv.ToEdgeObjMutable());
+    if ( haveInv )
+    {   int const* pInvIn = reinterpret_cast<int const*>(data[INVOLUTION]);
+        pInv->assign(pInvIn,pInvIn+nEdges); }
+    munmap(map,fileSize);
+    return haveInv;
+}
+
+}
+
+void WriteHBVCheckpoint( HyperBasevector const& hbv, std::string const& filename, bool compress )
+{
+    writeCheckpoint(hbv,nullptr,filename,compress);
+}
+
+void WriteHBVCheckpoint( HyperBasevector const& hbv, vec<int> const& inv, std::string const& filename,
+                            bool compress )
+{
+    writeCheckpoint(hbv,&inv,filename,compress);
+}
+
+void LoadHBVCheckpoint( HyperBasevector& hbv, std::string const& filename )
+{
+    loadCheckpoint(hbv,nullptr,filename);
+}
+
+void LoadHBVCheckpoint( HyperBasevector& hbv, vec<int>& inv, std::string const& filename )
+{
+    if ( !loadCheckpoint(hbv,&inv,filename) )
+    {   inv.clear();
+        hbv.Involution(inv); }
+}
+
+bool IsHBVCheckpoint( std::string const& filename )
+{
+    FileReader fr(filename);
+    return hasCheckpointMagic(fr,fr.getSize());
+}
+
+HBVCheckpointReader::HBVCheckpointReader( std::string const& filename )
+    : mFilename(filename), mBase(nullptr), mLen(0)
+{
+    FileReader fr(filename);
+    mLen = fr.getSize();
+    if ( !hasCheckpointMagic(fr,mLen) )
+        FatalErr(filename << " is a .hbv file in the old format, not a checkpoint.");
+    Header hdr;
+    size_t tableEnd = readHeader(fr,mLen,hdr,filename);
+    mBase = static_cast<char const*>(fr.map(0,mLen,true));
+    fr.close();
+    madvise(const_cast<char*>(mBase),mLen,MADV_SEQUENTIAL);
+    mK = hdr.K;
+    mNVertices = hdr.nVertices;
+    mNEdges = hdr.nEdges;
+    mNSections = hdr.nSections;
+    mBlockSize = hdr.blockSize;
+
+    SectionEntry const* table = reinterpret_cast<SectionEntry const*>(mBase+sizeof(hdr));
+    for ( size_t idx = 0; idx != mNSections; ++idx )
+    {
+        checkBounds(table[idx],tableEnd,mLen,filename);
+        if ( table[idx].codec != RAW && table[idx].codec != ZLIB_BLOCKS )
+            FatalErr("Checkpoint " << filename << " uses unknown codec " << table[idx].codec << '.');
+    }
+    for ( uint32_t id = EDGE_LENGTHS; id <= TO_EDGES; ++id )
+        if ( !section(id) )
+            FatalErr("Checkpoint " << filename << " is corrupt: section " << id << " is missing.");
+}
+
+HBVCheckpointReader::~HBVCheckpointReader()
+{
+    munmap(const_cast<char*>(mBase),mLen);
+}
+
+bool HBVCheckpointReader::hasInvolution() const
+{
+    return section(INVOLUTION);
+}
+
+void const* HBVCheckpointReader::section( uint32_t id ) const
+{
+    SectionEntry const* table = reinterpret_cast<SectionEntry const*>(mBase+sizeof(Header));
+    for ( size_t idx = 0; idx != mNSections; ++idx )
+        if ( table[idx].id == id ) return table+idx;
+    return nullptr;
+}
+
+template <class T>
+std::vector<T> HBVCheckpointReader::readSection( uint32_t id ) const
+{
+    SectionEntry const& entry = *static_cast<SectionEntry const*>(section(id));
+    if ( entry.rawSize % sizeof(T) )
+        FatalErr("Checkpoint " << mFilename << " is corrupt: section " << id << " has the wrong size.");
+    std::vector<T> result(entry.rawSize/sizeof(T));
+    char* dst = reinterpret_cast<char*>(result.data());
+    char const* stored = mBase+entry.offset;
+    if ( entry.codec == RAW )
+    {
+        if ( entry.storedSize != entry.rawSize )
+            FatalErr("Checkpoint " << mFilename << " is corrupt: section " << id << " has the wrong size.");
+        memcpy(dst,stored,entry.rawSize);
+        return result;
+    }
+    uint64_t nBlocks;
+    uint64_t const* sizes = blockSizes(stored,entry,mBlockSize,nBlocks,mFilename);
+    std::vector<size_t> srcOffs(nBlocks+1,(nBlocks+1)*sizeof(uint64_t));
+    for ( uint64_t blk = 0; blk != nBlocks; ++blk )
+        srcOffs[blk+1] = srcOffs[blk] + sizes[blk];
+    if ( srcOffs[nBlocks] > entry.storedSize )
+        FatalErr("Checkpoint " << mFilename << " is corrupt: section " << id << " is truncated.");
+    #pragma omp parallel for schedule(dynamic,1)
+    for ( uint64_t blk = 0; blk < nBlocks; ++blk )
+    {
+        size_t dstOff = blk*mBlockSize;
+        inflateBlock(stored+srcOffs[blk],sizes[blk],dst+dstOff,std::min(mBlockSize,entry.rawSize-dstOff),mFilename);
+    }
+    return result;
+}
+
+std::vector<uint32_t> HBVCheckpointReader::edgeLengths() const
+{
+    std::vector<uint32_t> lens = readSection<uint32_t>(EDGE_LENGTHS);
+    if ( lens.size() != mNEdges )
+        FatalErr("Checkpoint " << mFilename << " is corrupt: it has the wrong number of edge lengths.");
+    return lens;
+}
+
+void HBVCheckpointReader::readTopology( FrozenHBV& graph ) const
+{
+    if ( mNEdges > size_t(std::numeric_limits<int>::max()) )
+        FatalErr("Checkpoint " << mFilename << " has too many edges for a FrozenHBV.");
+    std::vector<int> csr[2][3];
+    for ( int dir = 0; dir != 2; ++dir )
+    {
+        uint32_t id = dir ? TO_STARTS : FROM_STARTS;
+        std::vector<uint64_t> starts = readSection<uint64_t>(id);
+        std::vector<int> verts = readSection<int>(id+1);
+        std::vector<int> edges = readSection<int>(id+2);
+        bool ok = starts.size() == mNVertices+1 && verts.size() == edges.size()
+                    && verts.size() <= size_t(std::numeric_limits<int>::max())
+                    && adjacenciesConsistent(starts.data(),mNVertices,verts.data(),edges.data(),verts.size(),mNEdges);
+        if ( !ok )
+            FatalErr("Checkpoint " << mFilename << " is corrupt: its adjacency arrays are inconsistent.");
+        csr[dir][0].assign(starts.begin(),starts.end());
+        csr[dir][1].swap(verts);
+        csr[dir][2].swap(edges);
+    }
+    std::vector<uint32_t> lens = edgeLengths();
+    std::vector<int> bases(lens.begin(),lens.end());
+    std::vector<int> inv;
+    if ( hasInvolution() )
+    {   inv = readSection<int>(INVOLUTION);
+        if ( inv.size() != mNEdges )
+            FatalErr("Checkpoint " << mFilename << " is corrupt: its involution has the wrong size.");
+        if ( !involutionInRange(inv.data(),mNEdges) )
+            FatalErr("Checkpoint " << mFilename << " is corrupt: its involution maps to an edge that doesn't exist."); }
+    graph.assign(mK,std::move(csr[0][0]),std::move(csr[0][1]),std::move(csr[0][2]),
+                 std::move(csr[1][0]),std::move(csr[1][1]),std::move(csr[1][2]),std::move(bases),std::move(inv));
+}
+
+void HBVCheckpointReader::forEachEdgeBatch( std::function<void(size_t,vec<basevector> const&)> const& func ) const
+{
+    std::vector<uint32_t> lens = edgeLengths();
+    SectionEntry const& entry = *static_cast<SectionEntry const*>(section(EDGE_BASES));
+    uint64_t total = 0;
+    for ( uint32_t len : lens ) total += (len+3ul)/4;
+    if ( total != entry.rawSize )
+        FatalErr("Checkpoint " << mFilename << " is corrupt: its edge bases don't match the edge lengths.");
+
+    // The section is taken a chunk at a time:  a block, if it's compressed, or a block's worth of it if not.
+    char const* stored = mBase+entry.offset;
+    size_t const chunkSize = mBlockSize;
+    size_t nChunks = (entry.rawSize+chunkSize-1)/chunkSize;
+    uint64_t const* sizes = nullptr;
+    std::vector<size_t> srcOffs;
+    if ( entry.codec == ZLIB_BLOCKS )
+    {
+        uint64_t nBlocks;
+        sizes = blockSizes(stored,entry,mBlockSize,nBlocks,mFilename);
+        srcOffs.assign(nBlocks+1,(nBlocks+1)*sizeof(uint64_t));
+        for ( uint64_t blk = 0; blk != nBlocks; ++blk )
+            srcOffs[blk+1] = srcOffs[blk] + sizes[blk];
+        if ( srcOffs[nBlocks] > entry.storedSize )
+            FatalErr("Checkpoint " << mFilename << " is corrupt: section " << entry.id << " is truncated.");
+    }
+    else if ( entry.storedSize != entry.rawSize )
+        FatalErr("Checkpoint " << mFilename << " is corrupt: section " << entry.id << " has the wrong size.");
+
+    // Each round decodes a chunk per thread or so onto the bytes of the edge the last round left unfinished,
+    // and hands on every edge that's now complete.
+    size_t const chunksPerRound = 2*std::max(omp_get_max_threads(),1);
+    std::vector<char> buf;
+    uint64_t bufStart = 0;          // where buf starts in the section
+    size_t edge = 0;                // the next edge to hand on
+    uint64_t edgeOff = 0;           // and where its bytes start
+    std::vector<uint64_t> offs;
+    vec<basevector> batch;
+    for ( size_t first = 0; first == 0 || first < nChunks; first += chunksPerRound )
+    {
+        size_t last = std::min(nChunks,first+chunksPerRound);
+        size_t keep = buf.size()-(edgeOff-bufStart);
+        memmove(buf.data(),buf.data()+(edgeOff-bufStart),keep);
+        bufStart = edgeOff;
+        uint64_t roundBeg = first*chunkSize;
+        uint64_t roundEnd = std::min<uint64_t>(entry.rawSize,last*chunkSize);
+        buf.resize(keep+(roundEnd-roundBeg));
+        char* dst = buf.data()+keep;
+        #pragma omp parallel for schedule(dynamic,1)
+        for ( size_t chunk = first; chunk < last; ++chunk )
+        {
+            size_t off = chunk*chunkSize;
+            size_t len = std::min<uint64_t>(chunkSize,entry.rawSize-off);
+            if ( sizes )
+                inflateBlock(stored+srcOffs[chunk],sizes[chunk],dst+(off-roundBeg),len,mFilename);
+            else
+                memcpy(dst+(off-roundBeg),stored+off,len);
+        }
+
+        offs.clear();
+        uint64_t off = edgeOff;
+        size_t end = edge;
+        for ( ; end != lens.size() && off+(lens[end]+3ul)/4 <= roundEnd; ++end )
+        {   offs.push_back(off);
+            off += (lens[end]+3ul)/4; }
+        batch.resize(end-edge);
+        #pragma omp parallel for schedule(static,10000)
+        for ( size_t idx = 0; idx < batch.size(); ++idx )
+            batch[idx].assignBaseBits(lens[edge+idx],buf.data()+(offs[idx]-bufStart));
+        if ( !batch.empty() )
+            func(edge,batch);
+        edge = end;
+        edgeOff = off;
+    }
+    if ( edge != lens.size() )
+        FatalErr("Checkpoint " << mFilename << " is corrupt: its edge bases are truncated.");
+}
@@ -0,0 +1,78 @@
+//
+// HBVCheckpoint.h: sectioned, optionally compressed HyperBasevector snapshots for step checkpoints.
+//
+
+#ifndef W2RAP_CONTIGGER_HBVCHECKPOINT_H
+#define W2RAP_CONTIGGER_HBVCHECKPOINT_H
+
+#include "paths/HyperBasevector.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+class FrozenHBV;
+
+// A checkpoint is a header, a section table, and the sections:  every edge's 2-bit packed bases in one blob (each
+// edge starting on a byte boundary), the edge lengths, and the from/to adjacencies as flat CSR arrays (vertex
+// starts, adjacent vertices, edge ids).  Each section is stored raw, so a reader can use it straight from a
+// mapping, or cut into fixed-size blocks that are zlib-compressed and decompressed independently, and therefore
+// in parallel.  Sections a reader doesn't know about are skipped, so new ones can be added without breaking it.
+// The involution is one such optional section, so that loading a checkpoint needn't recompute it.
+
+// Writes hbv to filename, compressing the sections (with all threads) unless compress is false.
+void WriteHBVCheckpoint( HyperBasevector const& hbv, std::string const& filename, bool compress = true );
+
+// As above, storing the involution too.
+void WriteHBVCheckpoint( HyperBasevector const& hbv, vec<int> const& inv, std::string const& filename,
+                            bool compress = true );
+
+// Maps filename and rebuilds hbv from it in parallel.  Files in the old BinaryWriter .hbv format are read too.
+void LoadHBVCheckpoint( HyperBasevector& hbv, std::string const& filename );
+
+// As above, also getting the involution:  from the file if it's stored there, otherwise by computing it.
+void LoadHBVCheckpoint( HyperBasevector& hbv, vec<int>& inv, std::string const& filename );
+
+// True if filename is a checkpoint, rather than a .hbv file in the old format.
+bool IsHBVCheckpoint( std::string const& filename );
+
+// Reads the parts of a checkpoint that are asked for, and nothing else, for tools that look at big graphs without
+// needing a HyperBasevector.  The file is mapped, and dies on construction if it isn't a checkpoint.
+class HBVCheckpointReader
+{
+public:
+    explicit HBVCheckpointReader( std::string const& filename );
+    ~HBVCheckpointReader();
+
+    HBVCheckpointReader( HBVCheckpointReader const& ) = delete;
+    HBVCheckpointReader& operator=( HBVCheckpointReader const& ) = delete;
+
+    int K() const { return mK; }
+    size_t nVertices() const { return mNVertices; }
+    size_t nEdges() const { return mNEdges; }
+    bool hasInvolution() const;
+
+    // The edge lengths, in bases.
+    std::vector<uint32_t> edgeLengths() const;
+
+    // The graph's adjacencies, edge lengths and involution (empty unless stored), without the bases.
+    void readTopology( FrozenHBV& graph ) const;
+
+    // Decodes the edges in order, a batch at a time, calling func(first,edges) with edges[i] being edge first+i.
+    // A batch is what a round of parallel block decompression yields, so memory doesn't grow with the graph.
+    void forEachEdgeBatch( std::function<void(size_t,vec<basevector> const&)> const& func ) const;
+
+private:
+    void const* section( uint32_t id ) const; // its table entry, or null
+    template <class T> std::vector<T> readSection( uint32_t id ) const;
+
+    std::string mFilename;
+    char const* mBase;
+    size_t mLen;
+    int mK;
+    size_t mNVertices;
+    size_t mNEdges;
+    size_t mNSections;
+    size_t mBlockSize;
+};
+
+#endif //W2RAP_CONTIGGER_HBVCHECKPOINT_H
@@ -18,6 +18,7 @@
 #include "feudal/BinaryStream.h"
 #include "feudal/IncrementalWriter.h"
 #include "graph/Digraph.h"
+#include "math/Hash.h"
 #include "paths/HyperBasevector.h"
 #include "paths/KmerBaseBroker.h"
 
@@ -645,16 +646,100 @@ template digraphEX<BaseVec>::digraphEX(digraphE<BaseVec> const&);
 template
 void DistancesToEndArr<BaseVec>(digraphE<BaseVec> const&, vec<int, std::allocator<int> > const&, int, unsigned char, vec<int, std::allocator<int> >&);
 
+namespace
+{
+
+// Hash of an edge's length and its first and last few bases, read forwards or
+// as the reverse complement.  An edge and its rc get each other's hashes.
+
+uint64_t EndsHash( const basevector& b, const Bool rc )
+{    const size_t ends = 32;
+     size_t n = b.size( ), m = std::min( n, ends );
+     uint64_t h = 1099511628211ul * ( 14695981039346656037ul ^ n );
+     if (rc)
+     {    h = FNV1a( b.rcbegin( ), b.rcbegin(m), h );
+          h = FNV1a( b.rcbegin( n - m ), b.rcend( ), h );    }
+     else
+     {    h = FNV1a( b.cbegin( ), b.cbegin(m), h );
+          h = FNV1a( b.cbegin( n - m ), b.cend( ), h );    }
+     h ^= h >> 33;
+     h *= 0xff51afd7ed558ccdul;
+     h ^= h >> 33;
+     return h;    }
+
+Bool IsRc( const basevector& b1, const basevector& b2 )
+{    return b1.size( ) == b2.size( )
+          && std::equal( b1.cbegin( ), b1.cend( ), b2.rcbegin( ) );    }
+
+}
+
 void HyperBasevector::Involution( vec<int>& inv )
-{    vecbasevector edges( EdgeObjectCount( ) );
-     for ( int e = 0; e < EdgeObjectCount( ); e++ )
-          edges[e] = EdgeObject(e);
-     vec<int> x1( E( ), vec<int>::IDENTITY ), x2( E( ), vec<int>::IDENTITY );
-     inv.resize( edges.size( ) );
-     ParallelSort( x1, [&edges](int i1, int i2){ return edges[i1] < edges[i2]; } );
-     #pragma omp parallel for
-     for ( int i = 0; i < (int) edges.size( ); i++ )
-          edges[i].ReverseComplement( );
-     ParallelSort( x2, [&edges](int i1, int i2){ return edges[i1] < edges[i2]; } );
-     for ( int i = 0; i < E( ); i++ )
-          inv[ x1[i] ] = x2[i];    }
+{    
+     // Bucket the edges on the smaller of their forward and rc hashes, so that
+     // each edge lands in the same bucket as its rc, then match them up within
+     // buckets by comparing sequences.  Linear time, and no copy of the edges.
+
+     const int nedges = EdgeObjectCount( );
+     vec<uint64_t> fw( nedges ), rc( nedges );
+     #pragma omp parallel for schedule(dynamic, 10000)
+     for ( int e = 0; e < nedges; e++ )
+     {    fw[e] = EndsHash( EdgeObject(e), False );
+          rc[e] = EndsHash( EdgeObject(e), True );    }
+
+     uint64_t nbuckets = 1;
+     while ( nbuckets < (uint64_t) nedges ) nbuckets *= 2;
+     const uint64_t mask = nbuckets - 1;
+     vec<int> start( nbuckets + 1, 0 );
+     #pragma omp parallel for schedule(static, 10000)
+     for ( int e = 0; e < nedges; e++ )
+     {    uint64_t b = std::min( fw[e], rc[e] ) & mask;
+          #pragma omp atomic
+          start[ b + 1 ]++;    }
+     for ( uint64_t b = 0; b < nbuckets; b++ )
+          start[ b + 1 ] += start[b];
+     vec<int> fill( start.begin( ), start.end( ) - 1 ), members( nedges );
+     #pragma omp parallel for schedule(static, 10000)
+     for ( int e = 0; e < nedges; e++ )
+     {    uint64_t b = std::min( fw[e], rc[e] ) & mask;
+          int pos;
+          #pragma omp atomic capture
+          pos = fill[b]++;
+          members[pos] = e;    }
+     Destroy(fill);
+
+     // Identical edges (including palindromes) are paired in order, so that
+     // the i-th copy of a sequence goes to the i-th copy of its rc.
+
+     inv.assign( nedges, -1 );
+     #pragma omp parallel
+     {    vec<int> same, rcs;
+          vec<Bool> done;
+          #pragma omp for schedule(dynamic, 10000)
+          for ( uint64_t b = 0; b < nbuckets; b++ )
+          {    int* first = members.data( ) + start[b];
+               int* last = members.data( ) + start[b+1];
+               std::sort( first, last );
+               int n = last - first;
+               done.assign( n, False );
+               for ( int i = 0; i < n; i++ )
+               {    if ( done[i] ) continue;
+                    const int e = first[i];
+                    const basevector& E = EdgeObject(e);
+                    same.clear( ), rcs.clear( );
+                    for ( int j = i; j < n; j++ )
+                    {    if ( done[j] ) continue;
+                         const int f = first[j];
+                         if ( fw[f] == fw[e] && EdgeObject(f) == E ) 
+                         {    same.push_back(f);
+                              done[j] = True;    }    }
+                    if ( rc[e] == fw[e] && IsRc( E, E ) ) rcs = same;
+                    else
+                    {    for ( int j = i + 1; j < n; j++ )
+                         {    if ( done[j] ) continue;
+                              const int f = first[j];
+                              if ( fw[f] == rc[e] && IsRc( EdgeObject(f), E ) )
+                              {    rcs.push_back(f);
+                                   done[j] = True;    }    }    }
+                    for ( int k = 0; k < Min( same.isize( ), rcs.isize( ) ); k++ )
+                    {    inv[ same[k] ] = rcs[k];
+                         inv[ rcs[k] ] = same[k];    }    }    }    }    }
@@ -126,8 +126,8 @@ class HyperBasevector : public digraphE<basevector> {
           const int e5 ) const;
      basevector Cat( const vec<int>& e ) const;
 
-     // Get involution of a HyperBasevector.  If it doesn't exist you'll get
-     // garbage.  Parallel.
+     // Get involution of a HyperBasevector.  Edges whose reverse complement
+     // isn't in the graph get -1.  Linear time, parallel.
 
      void Involution( vec<int>& inv );
 
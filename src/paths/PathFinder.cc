@@ -10,27 +10,7 @@ std::string PathFinder::edge_pstr(uint64_t e){
 };
 
 void PathFinder::init_prev_next_vectors(){
-    //TODO: this is stupid duplication of the digraph class, but it's so weird!!!
-    prev_edges.resize(mToLeft.size());
-    next_edges.resize(mToRight.size());
-    for (auto e=0;e<mToLeft.size();++e){
-
-        uint64_t prev_node=mToLeft[e];
-
-        prev_edges[e].resize(mHBV.ToSize(prev_node));
-        for (int i=0;i<mHBV.ToSize(prev_node);++i){
-            prev_edges[e][i]=mHBV.EdgeObjectIndexByIndexTo(prev_node,i);
-        }
-
-        uint64_t next_node=mToRight[e];
-
-        next_edges[e].resize(mHBV.FromSize(next_node));
-        for (int i=0;i<mHBV.FromSize(next_node);++i){
-            next_edges[e][i]=mHBV.EdgeObjectIndexByIndexFrom(next_node,i);
-        }
-    }
-
-
+    mGraph.build(mHBV,&mInv);
 }
 
 std::array<uint64_t,3> PathFinder::transition_votes(uint64_t left_e,uint64_t right_e){
@@ -418,20 +398,20 @@ void PathFinder::untangle_complex_in_out_choices() {
         if (e < mInv[e] && mHBV.EdgeObject(e).size()>1000) {
             //Ok, so why do we stop?
             //is next edge a join? how long till it splits again? can we choose the split?
-            if (next_edges[e].size()==1 and prev_edges[next_edges[e][0]].size()>1){
+            if (mGraph.Next(e).size()==1 and mGraph.Prev(mGraph.Next(e)[0]).size()>1){
                 //std::cout<<"next edge from "<<e<<" is a join!"<<std::endl;
-                if (mHBV.EdgeObject(next_edges[e][0]).size()<500 and next_edges[next_edges[e][0]].size()>1){
+                if (mHBV.EdgeObject(mGraph.Next(e)[0]).size()<500 and mGraph.Next(mGraph.Next(e)[0]).size()>1){
 
-                    if (prev_edges[next_edges[e][0]].size()==prev_edges[next_edges[e][0]].size()){
-                        std::cout<<"next edge from "<<e<<" is a small join! with "<<prev_edges[next_edges[e][0]].size()<<"in-outs"<<std::endl;
-                        auto join_edge=next_edges[e][0];
+                    if (mGraph.Prev(mGraph.Next(e)[0]).size()==mGraph.Prev(mGraph.Next(e)[0]).size()){
+                        std::cout<<"next edge from "<<e<<" is a small join! with "<<mGraph.Prev(mGraph.Next(e)[0]).size()<<"in-outs"<<std::endl;
+                        auto join_edge=mGraph.Next(e)[0];
                         std::vector<std::vector<uint64_t>> p0011={
-                                {prev_edges[join_edge][0],join_edge,next_edges[join_edge][0]},
-                                {prev_edges[join_edge][1],join_edge,next_edges[join_edge][1]}
+                                {mGraph.Prev(join_edge)[0],join_edge,mGraph.Next(join_edge)[0]},
+                                {mGraph.Prev(join_edge)[1],join_edge,mGraph.Next(join_edge)[1]}
                         };
                         std::vector<std::vector<uint64_t>> p1001={
-                                {prev_edges[join_edge][1],join_edge,next_edges[join_edge][0]},
-                                {prev_edges[join_edge][0],join_edge,next_edges[join_edge][1]}
+                                {mGraph.Prev(join_edge)[1],join_edge,mGraph.Next(join_edge)[0]},
+                                {mGraph.Prev(join_edge)[0],join_edge,mGraph.Next(join_edge)[1]}
                         };
                         auto v0011=multi_path_votes(p0011);
                         auto v1001=multi_path_votes(p1001);
@@ -450,11 +430,11 @@ void PathFinder::untangle_pins() {
     init_prev_next_vectors();
     uint64_t pins=0;
     for (int e = 0; e < mHBV.EdgeObjectCount(); ++e) {
-        if (mToLeft[e]==mToLeft[mInv[e]] and next_edges[e].size()==1 ) {
+        if (mToLeft[e]==mToLeft[mInv[e]] and mGraph.Next(e).size()==1 ) {
             std::cout<<" Edge "<<e<<" forms a pinhole!!!"<<std::endl;
-            if (next_edges[next_edges[e][0]].size()==2) {
-                std::vector<uint64_t> pfw = {mInv[next_edges[next_edges[e][0]][0]],mInv[next_edges[e][0]],e,next_edges[e][0],next_edges[next_edges[e][0]][1]};
-                std::vector<uint64_t> pbw = {mInv[next_edges[next_edges[e][0]][1]],mInv[next_edges[e][0]],e,next_edges[e][0],next_edges[next_edges[e][0]][0]};
+            if (mGraph.Next(mGraph.Next(e)[0]).size()==2) {
+                std::vector<uint64_t> pfw = {mInv[mGraph.Next(mGraph.Next(e)[0])[0]],mInv[mGraph.Next(e)[0]],e,mGraph.Next(e)[0],mGraph.Next(mGraph.Next(e)[0])[1]};
+                std::vector<uint64_t> pbw = {mInv[mGraph.Next(mGraph.Next(e)[0])[1]],mInv[mGraph.Next(e)[0]],e,mGraph.Next(e)[0],mGraph.Next(mGraph.Next(e)[0])[0]};
                 auto vpfw=multi_path_votes({pfw});
                 auto vpbw=multi_path_votes({pbw});
                 std::cout<<"votes FW: "<<vpfw[0]<<":"<<vpfw[1]<<":"<<vpfw[2]<<"     BW: "<<vpbw[0]<<":"<<vpbw[1]<<":"<<vpbw[2]<<std::endl;
@@ -623,7 +603,7 @@ std::vector<std::vector<uint64_t>> PathFinder::AllPathsFromTo(std::vector<uint64
         current_paths.clear();
         for (auto op:old_paths) {
             //grow each path, adding variations if needed
-            for (auto ne:next_edges[op.back()]){
+            for (auto ne:mGraph.Next(op.back())){
                 //if new edge on out_edges, add to paths
                 op.push_back(ne);
                 if (std::count(out_edges.begin(),out_edges.end(),ne)) paths.push_back(op);
@@ -648,11 +628,11 @@ std::array<std::vector<uint64_t>,2> PathFinder::get_all_long_frontiers(uint64_t
                 //What about reverse complements and paths that include loops that "reverse the flow"?
                 if (seen_edges.count(mInv[x])) return std::array<std::vector<uint64_t>,2>(); //just cancel for now
 
-                for (auto p:prev_edges[x]) {
+                for (auto p:mGraph.Prev(x)) {
                     if (mHBV.EdgeObject(p).size() >= large_frontier_size )  {
                         //What about frontiers on both sides?
                         in_frontiers.insert(p);
-                        for (auto other_n:next_edges[p]){
+                        for (auto other_n:mGraph.Next(p)){
                             if (!seen_edges.count(other_n)) {
                                 if (mHBV.EdgeObject(other_n).size() >= large_frontier_size) {
                                     out_frontiers.insert(other_n);
@@ -665,11 +645,11 @@ std::array<std::vector<uint64_t>,2> PathFinder::get_all_long_frontiers(uint64_t
                     else if (!seen_edges.count(p)) next_to_explore.insert(p);
                 }
 
-                for (auto n:next_edges[x]) {
+                for (auto n:mGraph.Next(x)) {
                     if (mHBV.EdgeObject(n).size() >= large_frontier_size) {
                         //What about frontiers on both sides?
                         out_frontiers.insert(n);
-                        for (auto other_p:prev_edges[n]){
+                        for (auto other_p:mGraph.Prev(n)){
                             if (!seen_edges.count(other_p)) {
                                 if (mHBV.EdgeObject(other_p).size() >= large_frontier_size) {
                                     in_frontiers.insert(other_p);
@@ -730,19 +710,19 @@ std::vector<std::vector<uint64_t>> PathFinder::is_unrollable_loop(uint64_t loop_
     //Conditions for unrollable loop:
 
     //1) only one neighbour on each direction, and the same one (repeat_e).
-    if (prev_edges[loop_e].size()!=1 or
-        next_edges[loop_e].size()!=1 or
-        prev_edges[loop_e][0]!=next_edges[loop_e][0]) return {};
-    repeat_e=prev_edges[loop_e][0];
+    if (mGraph.Prev(loop_e).size()!=1 or
+        mGraph.Next(loop_e).size()!=1 or
+        mGraph.Prev(loop_e)[0]!=mGraph.Next(loop_e)[0]) return {};
+    repeat_e=mGraph.Prev(loop_e)[0];
 
 
     //2) the repeat edge has only one other neighbour on each direction, and it is a different one;
-    if (prev_edges[repeat_e].size()!=2 or
-        next_edges[repeat_e].size()!=2) return {};
+    if (mGraph.Prev(repeat_e).size()!=2 or
+        mGraph.Next(repeat_e).size()!=2) return {};
 
-    prev_e=(prev_edges[repeat_e][0]==loop_e ? prev_edges[repeat_e][1]:prev_edges[repeat_e][0]);
+    prev_e=(mGraph.Prev(repeat_e)[0]==loop_e ? mGraph.Prev(repeat_e)[1]:mGraph.Prev(repeat_e)[0]);
 
-    next_e=(next_edges[repeat_e][0]==loop_e ? next_edges[repeat_e][1]:next_edges[repeat_e][0]);
+    next_e=(mGraph.Next(repeat_e)[0]==loop_e ? mGraph.Next(repeat_e)[1]:mGraph.Next(repeat_e)[0]);
 
     if (prev_e==next_e or prev_e==mInv[next_e]) return {};
 
@@ -868,7 +848,9 @@ void PathFinder::migrate_readpaths(std::map<uint64_t,std::vector<uint64_t>> edge
     //if more than one combination is valid, this chooses at random among them (could be done better? should the path be duplicated?)
     mHBV.ToLeft(mToLeft);
     mHBV.ToRight(mToRight);
-    for (auto &p:mPaths){
+    EdgePathIndex::Updater index_updater(&mEdgeToPathIds);
+    for (uint64_t pi=0;pi<mPaths.size();++pi){
+        auto &p=mPaths[pi];
         std::vector<std::vector<uint64_t>> possible_new_edges;
         bool translated=false,ambiguous=false;
         for (auto i=0;i<p.size();++i){
@@ -880,6 +862,7 @@ void PathFinder::migrate_readpaths(std::map<uint64_t,std::vector<uint64_t>> edge
             else possible_new_edges.push_back({p[i]});
         }
         if (translated){
+            std::vector<int> old_path(p.begin(),p.end());
             if (not ambiguous){ //just straigh forward translation
                 for (auto i=0;i<p.size();++i) p[i]=possible_new_edges[i][0];
             }
@@ -911,6 +894,7 @@ void PathFinder::migrate_readpaths(std::map<uint64_t,std::vector<uint64_t>> edge
                     for (auto i=0;i<p.size();++i) p[i]=possible_paths[r][i];
                 }
             }
+            index_updater.replace(pi,old_path,p);
         }
     }
 
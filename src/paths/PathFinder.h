@@ -4,7 +4,9 @@
 
 #ifndef W2RAP_CONTIGGER_PATHFINDER_H
 #define W2RAP_CONTIGGER_PATHFINDER_H
+#include "paths/FrozenHBV.h"
 #include "paths/HyperBasevector.h"
+#include "paths/long/EdgePathIndex.h"
 #include "paths/long/ReadPath.h"
 
 #include "paths/long/large/GapToyTools.h"
@@ -14,7 +16,7 @@
 
 class PathFinder {
 public:
-    PathFinder( HyperBasevector& hbv, vec<int>& inv, ReadPathVec& paths, VecULongVec& invPaths, int min_reads = 5 ) :
+    PathFinder( HyperBasevector& hbv, vec<int>& inv, ReadPathVec& paths, EdgePathIndex& invPaths, int min_reads = 5 ) :
     mHBV(hbv),
     mInv(inv),
     mPaths(paths),
@@ -60,10 +62,10 @@ private:
     HyperBasevector& mHBV;
     vec<int>& mInv;
     ReadPathVec& mPaths;
-    VecULongVec& mEdgeToPathIds;
+    EdgePathIndex& mEdgeToPathIds;
     vec<int> mToLeft;
     vec<int> mToRight;
-    std::vector<std::vector<uint64_t>> next_edges,prev_edges;
+    FrozenHBV mGraph; //snapshot of mHBV for next/prev edge lookups, rebuilt by init_prev_next_vectors()
     int mMinReads;
 
 
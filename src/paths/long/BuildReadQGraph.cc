@@ -34,11 +34,17 @@
 #include "paths/long/KmerCount.h"
 #include "system/SortInPlace.h"
 #include "system/SpinLockedData.h"
+#include "system/file/FileReader.h"
+#include "system/file/FileWriter.h"
 #include "system/WorklistN.h"
+#include "util/PerfLog.h"
 #include <algorithm>
 #include <atomic>
+#include <cstring>
+#include <omp.h>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <utility>
 #include <vector>
@@ -122,6 +128,25 @@ namespace
             return true;
         }
 
+        // Is entry the least kmer of the smooth circle it's on?  Walks the circle
+        // only until it finds a lesser kmer, so the walks from all the kmers of a
+        // circle cost O(n log n) on average, rather than O(n^2).  Thread-safe.
+        bool isCircleStart(BRQ_Entry const &entry) {
+            KMerContext context = entry.getKDef().getContext();
+            BRQ_Kmer kmer(entry);
+            while (context.getSuccessorCount() == 1) {
+                kmer.toSuccessor(context.getSingleSuccessor());
+                BRQ_Entry const *pEntry = lookup(kmer, &context);
+                if (pEntry == &entry)
+                    return true;
+                if (!pEntry->getKDef().isNull())
+                    return true; // let simpleCircle complain about it
+                if (static_cast<BRQ_Kmer const &>(*pEntry) < entry)
+                    return false;
+            }
+            return true;
+        }
+
         // not thread-safe
         void simpleCircle(BRQ_Entry const &entry) {
             BRQ_Entry const *pFirstEntry = &entry;
@@ -314,11 +339,10 @@ namespace
     void buildEdges( BRQ_Dict const& dict, vecbvec* pEdges )
     {
         EdgeBuilder eb(dict,pEdges);
-        dict.parallelForEachHHS(
-                [eb]( BRQ_Dict::Set::HHS const& hhs ) mutable
-                { for ( BRQ_Entry const& entry : hhs )
-                    if ( entry.getKDef().isNull() )
-                        eb.buildEdge(entry); });
+        dict.parallelForEachEntry(
+                [eb]( BRQ_Entry const& entry ) mutable
+                { if ( entry.getKDef().isNull() )
+                    eb.buildEdge(entry); });
 
         size_t nRegularEdges = pEdges->size();
         size_t nTotalLength = pEdges->SizeSum();
@@ -326,13 +350,23 @@ namespace
                   << " edges of total length " << nTotalLength << '.' << std::endl;
 
         // if a kmer isn't marked as being on an edge, it must be a part of a smooth
-        // circle: add those edges, too.  simpleCircle method isn't thread-safe, so
-        // this part is single-threaded.
+        // circle: add those edges, too.  Each circle is found, in parallel, from its
+        // least kmer.  simpleCircle method isn't thread-safe, so the circles are then
+        // built one at a time, in kmer order, so that the edge numbering doesn't
+        // depend on the threads.
         //std::cout << Date() << ": finding smooth circles." << std::endl;
-        for ( auto const& hhs : dict )
-            for ( auto const& entry : hhs )
-                if ( entry.getKDef().isNull() )
-                    eb.simpleCircle(entry);
+        std::vector<BRQ_Entry const*> circleStarts;
+        SpinLockedData circleLock;
+        dict.parallelForEachEntry(
+                [eb,&circleStarts,&circleLock]( BRQ_Entry const& entry ) mutable
+                { if ( entry.getKDef().isNull() && eb.isCircleStart(entry) )
+                  { SpinLocker lock(circleLock);
+                    circleStarts.push_back(&entry); } });
+        std::sort(circleStarts.begin(),circleStarts.end(),
+                [](BRQ_Entry const* pEnt1, BRQ_Entry const* pEnt2)
+                { return static_cast<BRQ_Kmer const&>(*pEnt1) < *pEnt2; });
+        for ( BRQ_Entry const* pEntry : circleStarts )
+            eb.simpleCircle(*pEntry);
         std::cout << Date() << ": " << pEdges->size()-nRegularEdges
                   << " circular edges of total length "
                   << pEdges->SizeSum()-nTotalLength << '.' << std::endl;
@@ -511,17 +545,22 @@ namespace
                 BRQ_Kmer kmer(itr);
                 BRQ_Entry const *pEnt = mDict.findEntry(kmer);
                 if (!pEnt) {
+                    // a gap is usually a run of misses as long as K, so the kmers that follow are looked up a
+                    // batch at a time
                     unsigned gapLen = 1u;
-                    auto itr2 = itr + K;
                     ++itr;
-                    auto end2 = read.end();
-                    while (itr2 != end2) {
-                        kmer.toSuccessor(*itr2);
-                        ++itr2;
-                        if ((pEnt = mDict.findEntry(kmer)))
+                    while (itr != end) {
+                        size_t nnn = std::min(GAP_BATCH, size_t(end - itr));
+                        mDict.findEntries(itr, itr + nnn + K - 1, &mEntries);
+                        auto hit = std::find_if(mEntries.begin(), mEntries.end(),
+                                                [](BRQ_Entry const *pHit) { return pHit; });
+                        size_t nMissed = hit - mEntries.begin();
+                        gapLen += nMissed;
+                        itr += nMissed;
+                        if (hit != mEntries.end()) {
+                            pEnt = *hit;
                             break;
-                        ++gapLen;
-                        ++itr;
+                        }
                     }
                     mPathParts.emplace_back(gapLen);
                 }
@@ -557,10 +596,16 @@ namespace
             BRQ_SubKmer k2 = pp2.isRC() ? BRQ_SubKmer(e2.rcend()-K+1) : BRQ_SubKmer(e2.end()-K+1);
             return k1==k2; }
 
+        // Hints that read will soon be pathed.
+        void prefetch( bvec const& read ) const
+        { if ( read.size() >= K ) mDict.prefetch(BRQ_Kmer(read.begin())); }
+
     private:
+        static size_t const GAP_BATCH = 16;
         BRQ_Dict const& mDict;
         vecbvec const& mEdges;
         std::vector<PathPart> mPathParts;
+        std::vector<BRQ_Entry const*> mEntries;
     };
 
     class GapFiller
@@ -843,6 +888,7 @@ namespace
 
             #pragma omp for
             for (size_t readId=0;readId<reads.size();++readId){
+                if (readId+1<reads.size()) mPather.prefetch(reads[readId+1]);
                 std::vector<PathPart> parts = mPather.path(reads[readId]);     // needs to become a forward_list
 
                 // convert any seeds on hanging edges to gaps
@@ -986,264 +1032,367 @@ uint64_t count_good_lengths(std::vector<uint16_t> &good_lenghts, VecPQVec const&
 
 }
 
-void collapse_entries(std::vector<BRQ_Entry> &kmer_list){
-    auto okItr = kmer_list.begin();
-    for (auto kItr = kmer_list.begin(); kItr < kmer_list.end(); ++okItr) {
-        *okItr = *kItr;
-        ++kItr;
-        while (kItr<kmer_list.end() and *okItr == *kItr) {
-            combine_Entries(*okItr,*kItr);
-            ++kItr;
-        }
+// Bucketed counting: canonical kmers are partitioned by their leading bases, so each bucket is a contiguous
+// slice of the global sort order and can be sorted/collapsed on its own, with no merge tree above it.
+static const unsigned BUCKET_BASES = 6;
+static const unsigned N_BUCKETS = 1u << (2*BUCKET_BASES);
+
+inline unsigned kmerBucket( BRQ_Kmer const& kmer )
+{
+    unsigned bucket = 0;
+    for ( unsigned i = 0; i < BUCKET_BASES; ++i ) bucket = (bucket << 2) | kmer[i];
+    return bucket;
+}
+
+// calls func(KMerNodeFreq const&) for every canonical kmer in the first len bases of read, each with its context
+// and a count of 1 (reads with len<=K produce nothing).
+template <class Func>
+inline void forEachCanonicalKNF( bvec const& read, unsigned len, Func func )
+{
+    if (len <= K) return;
+    auto beg = read.begin(), itr=beg+K, last=beg+(len-1);
+    KMerNodeFreq kkk(beg);
+    kkk.kc = KMerContext::initialContext(*itr);
+    kkk.count=1;
+    func( kkk.isRev() ? KMerNodeFreq(kkk,true) : kkk);
+    while ( itr != last )
+    { unsigned char pred = kkk.front();
+        kkk.toSuccessor(*itr); ++itr;
+        kkk.kc = KMerContext(pred,*itr);
+        func( kkk.isRev() ? KMerNodeFreq(kkk,true) : kkk);
     }
-    kmer_list.resize(okItr - kmer_list.begin());
+    kkk.kc = KMerContext::finalContext(kkk.front());
+    kkk.toSuccessor(*last);
+    func( kkk.isRev() ? KMerNodeFreq(kkk,true) : kkk);
 }
 
-void collapse_entries(std::vector<KMerNodeFreq> &kmer_list){
-    auto okItr = kmer_list.begin();
-    for (auto kItr = kmer_list.begin(); kItr < kmer_list.end(); ++okItr) {
+KMerNodeFreq * collapse_entries(KMerNodeFreq * beg, KMerNodeFreq * end){
+    auto okItr = beg;
+    for (auto kItr = beg; kItr < end; ++okItr) {
         *okItr = *kItr;
         ++kItr;
-        while (kItr<kmer_list.end() and *okItr == *kItr) {
+        while (kItr<end and *okItr == *kItr) {
             combine_Entries(*okItr,*kItr);
             ++kItr;
         }
     }
-    kmer_list.resize(okItr - kmer_list.begin());
+    return okItr;
 }
 
-std::vector<KMerNodeFreq> createDictOMPRecursive(BRQ_Dict ** dict, vecbvec const& reads, VecPQVec const& quals, uint64_t from, uint64_t to, uint64_t batch_size, unsigned minQual, unsigned minFreq, std::string workdir=""){
-    std::vector<KMerNodeFreq> kmer_list;
-    //If size larger than batch (or still not enough cpus used, or whatever), Lauch 2 tasks to sort the 2 halves, with minFreq=0
-    if (to - from > batch_size) {
-        //#pragma omp critical
-        //std::cout << "createDictOMPRecursive (thread "<<omp_get_thread_num()<<") from " << from << " to " << to << ", splitting..." << std::endl;
-        uint64_t mid_point = from + (to - from) / 2;
-        std::vector<KMerNodeFreq> entries1, entries2; //TODO: need to not copy but mode the reference.
-        #pragma omp task shared(reads,quals,entries1)
-        { entries1 = createDictOMPRecursive(NULL, reads, quals, from, mid_point, batch_size, minQual,
-                                              minFreq);}
-        #pragma omp task shared(reads,quals,entries2)
-        { entries2 = createDictOMPRecursive(NULL, reads, quals, mid_point, to, batch_size, minQual, minFreq); }
-        #pragma omp taskwait
-        kmer_list.reserve(entries1.size() + entries2.size());
-        auto end1=entries1.end(),end2=entries2.end();
-        auto itr1=entries1.begin(),itr2=entries2.begin();
-        while (itr1<end1 and itr2<end2){
-            if (*itr1==*itr2){
-                kmer_list.push_back(*itr1);
-                combine_Entries(kmer_list.back(),*itr2);
-                ++itr1;
-                ++itr2;
-            } else if (*itr1<*itr2){
-                kmer_list.push_back(*itr1);
-                ++itr1;
-            } else {
-                kmer_list.push_back(*itr2);
-                ++itr2;
-            }
+// One pass of the bucketed counter: buckets [firstBucket,lastBucket) have been sorted and collapsed, bucket b holds
+// distinct[b] kmers starting at data+offset[b].  Taken in bucket order, the buckets follow the global sort order.
+struct KmerBucketPass {
+    KMerNodeFreq * data;
+    uint64_t const * offset;
+    uint64_t const * distinct;
+    unsigned firstBucket, lastBucket;
+
+    KMerNodeFreq * begin(unsigned b) const { return data+offset[b]; }
+    KMerNodeFreq * end(unsigned b) const { return data+offset[b]+distinct[b]; }
+};
+
+// Counts the canonical kmers of reads [from,to) into prefix buckets and calls sink(KmerBucketPass const&) once per
+// pass.  Passes split the buckets so a pass's kmers fit in about half of the available memory.
+template <class Sink>
+void countKmersBucketed(vecbvec const& reads, VecPQVec const& quals, uint64_t from, uint64_t to, unsigned minQual, Sink sink){
+    const uint64_t nthreads = omp_get_max_threads();
+    //every phase walks the same fixed read ranges, so the scatter offsets computed from the histogram hold
+    std::vector<uint64_t> thread_from(nthreads+1);
+    for (uint64_t t=0;t<=nthreads;++t) thread_from[t]=from+t*(to-from)/nthreads;
+    std::vector<std::vector<uint16_t>> good_lengths(nthreads);
+    std::vector<uint64_t> thread_bucket_count(nthreads*N_BUCKETS,0);
+
+    //1) good lengths and kmers per (read range,bucket)
+    #pragma omp parallel for schedule(static,1)
+    for (uint64_t t=0;t<nthreads;++t) {
+        auto tfrom=thread_from[t],tto=thread_from[t+1];
+        good_lengths[t].resize(tto-tfrom);
+        count_good_lengths(good_lengths[t], quals, tfrom, tto, BRQ_Entry::getK(), minQual);
+        uint64_t * counts=thread_bucket_count.data()+t*N_BUCKETS;
+        for (auto readId = tfrom; readId < tto; ++readId)
+            forEachCanonicalKNF(reads[readId], good_lengths[t][readId-tfrom],
+                                [counts](KMerNodeFreq const &knf){ ++counts[kmerBucket(knf)]; });
+    }
+    std::vector<uint64_t> bucket_size(N_BUCKETS,0);
+    uint64_t total_kmers=0;
+    for (auto b=0;b<N_BUCKETS;++b) {
+        for (uint64_t t = 0; t < nthreads; ++t) bucket_size[b] += thread_bucket_count[t * N_BUCKETS + b];
+        total_kmers+=bucket_size[b];
+    }
+
+    //2) group consecutive buckets into passes
+    uint64_t max_pass_kmers=std::max((uint64_t)1,(uint64_t)(MemAvailable(.9)/2/sizeof(KMerNodeFreq)));
+    std::vector<unsigned> pass_start(1,0);
+    uint64_t pass_kmers=0;
+    for (unsigned b=0;b<N_BUCKETS;++b){
+        if (pass_kmers>0 and pass_kmers+bucket_size[b]>max_pass_kmers) {
+            pass_start.push_back(b);
+            pass_kmers=0;
         }
-        while (itr1<end1) kmer_list.push_back(*itr1++);
-        while (itr2<end2) kmer_list.push_back(*itr2++);
-
-        entries1.clear();
-        entries2.clear();
-
-    } else { //just do the kmer creation and sort/collapse
-        //#pragma omp critical
-        //std::cout << "createDictOMPRecursive (thread "<<omp_get_thread_num()<<") from " << from << " to " << to << ", counting..." << std::endl;
-
-        std::vector<uint16_t> good_lenghts(to - from);
-        uint64_t total_good_lenght = count_good_lengths(good_lenghts, quals, from, to, BRQ_Entry::getK(),
-                                                        minQual);
-        kmer_list.clear();
-        kmer_list.reserve(total_good_lenght);
-        //Populate the kmer list
-        for (auto readId = from; readId < to; ++readId) {
-            unsigned len = good_lenghts[readId - from];
-            if (len > K) {
-                auto beg = reads[readId].begin(), itr=beg+K, last=beg+(len-1);
-                KMerNodeFreq kkk(beg);
-                kkk.kc = KMerContext::initialContext(*itr);
-                kkk.count=1;
-                kmer_list.push_back( kkk.isRev() ? KMerNodeFreq(kkk,true) : kkk);
-                while ( itr != last )
-                { unsigned char pred = kkk.front();
-                    kkk.toSuccessor(*itr); ++itr;
-                    kkk.kc = KMerContext(pred,*itr);
-                    kmer_list.push_back( kkk.isRev() ? KMerNodeFreq(kkk,true) : kkk);
-                }
-                kkk.kc = KMerContext::finalContext(kkk.front());
-                kkk.toSuccessor(*last);
-                kmer_list.push_back( kkk.isRev() ? KMerNodeFreq(kkk,true) : kkk);
+        pass_kmers+=bucket_size[b];
+    }
+    pass_start.push_back(N_BUCKETS);
+    std::cout << Date() << ": " << total_kmers << " kmers in " << N_BUCKETS << " buckets, counting in "
+              << pass_start.size()-1 << " pass(es)" << std::endl;
+
+    std::vector<uint64_t> bucket_offset(N_BUCKETS+1), bucket_distinct(N_BUCKETS);
+    for (auto p=0;p<pass_start.size()-1;++p) {
+        auto first_bucket=pass_start[p],last_bucket=pass_start[p+1];
+        bucket_offset[first_bucket]=0;
+        for (auto b=first_bucket;b<last_bucket;++b) bucket_offset[b+1]=bucket_offset[b]+bucket_size[b];
+        std::vector<KMerNodeFreq> kmers(bucket_offset[last_bucket]);
+
+        //3) scatter: each read range owns a fixed slot range inside every bucket
+        #pragma omp parallel for schedule(static,1)
+        for (uint64_t t=0;t<nthreads;++t) {
+            auto tfrom=thread_from[t],tto=thread_from[t+1];
+            std::vector<uint64_t> next(N_BUCKETS);
+            for (auto b=first_bucket;b<last_bucket;++b) {
+                next[b] = bucket_offset[b];
+                for (uint64_t t2 = 0; t2 < t; ++t2) next[b] += thread_bucket_count[t2 * N_BUCKETS + b];
             }
+            KMerNodeFreq * data=kmers.data();
+            for (auto readId = tfrom; readId < tto; ++readId)
+                forEachCanonicalKNF(reads[readId], good_lengths[t][readId-tfrom],
+                                    [&](KMerNodeFreq const &knf){
+                                        auto b=kmerBucket(knf);
+                                        if (b>=first_bucket and b<last_bucket) data[next[b]++]=knf;
+                                    });
         }
-        std::sort(kmer_list.begin(), kmer_list.end());
-        collapse_entries(kmer_list);
-    }
-    //sort
-    //#pragma omp critical
-    //std::cout << "createDictOMPRecursive (thread "<<omp_get_thread_num()<<") from " << from << " to " << to << ", sorting/collapsing "<<kmer_list.size()<<" kmers ..."
-    //          << std::endl;
 
+        //4) sort/collapse every bucket independently
+        #pragma omp parallel for schedule(dynamic,1)
+        for (auto b=first_bucket;b<last_bucket;++b) {
+            auto beg=kmers.data()+bucket_offset[b], end=kmers.data()+bucket_offset[b+1];
+            std::sort(beg,end);
+            bucket_distinct[b]=collapse_entries(beg,end)-beg;
+        }
 
-    if (NULL != dict) { //merge sort and return that
-        std::cout << Date() << ": " << kmer_list.size() << " kmers counted, filtering..." << std::endl;
-        (*dict) = new BRQ_Dict(kmer_list.size());
-        uint64_t used = 0,not_used=0;
-        uint64_t hist[101];
-        for (auto &h:hist) h=0;
-        for (auto &knf:kmer_list) {
-            ++hist[std::min(100,(int)knf.count)];
-            if (knf.count >= minFreq) {
-                (*dict)->insertEntryNoLocking(BRQ_Entry((BRQ_Kmer)knf,knf.kc));
-                used++;
-            } else {
-                not_used++;
-            }
+        KmerBucketPass pass={kmers.data(),bucket_offset.data(),bucket_distinct.data(),first_bucket,last_bucket};
+        sink(pass);
+    }
+}
 
+void createDictOMPBucketed(BRQ_Dict ** dict, vecbvec const& reads, VecPQVec const& quals, unsigned minQual, unsigned minFreq, std::string workdir=""){
+    const uint64_t nthreads = omp_get_max_threads();
+    uint64_t used=0, total_distinct=0;
+    std::vector<uint64_t> thread_hist(nthreads*101,0);
+    std::vector<uint64_t> bucket_survivors(N_BUCKETS);
+    std::vector<std::vector<BRQ_Entry>> pass_entries;
+    countKmersBucketed(reads, quals, 0, reads.size(), minQual, [&](KmerBucketPass const & pass){
+        //keep only survivors at the front of each bucket
+        uint64_t pass_distinct=0, pass_used=0;
+        #pragma omp parallel for schedule(dynamic,1) reduction(+:pass_distinct,pass_used)
+        for (auto b=pass.firstBucket;b<pass.lastBucket;++b) {
+            uint64_t * hist=thread_hist.data()+omp_get_thread_num()*101;
+            auto oItr=pass.begin(b);
+            for (auto kItr=pass.begin(b);kItr<pass.end(b);++kItr) {
+                ++hist[std::min(100,(int)kItr->count)];
+                if (kItr->count >= minFreq) *oItr++=*kItr;
+            }
+            bucket_survivors[b]=oItr-pass.begin(b);
+            pass_distinct+=pass.distinct[b];
+            pass_used+=bucket_survivors[b];
         }
-        std::cout << Date() << ": " << used << " / " << kmer_list.size() << " kmers with Freq >= " << minFreq << std::endl;
-        kmer_list.clear();
-        if (""!=workdir) {
-            std::ofstream kff(workdir + "/small_K.freqs");
-            for (auto i = 1; i < 101; i++) kff << i << ", " << hist[i] << std::endl;
-            kff.close();
+        total_distinct+=pass_distinct;
+        used+=pass_used;
+
+        //keep each pass's survivors apart, sized exactly, so nothing grows while the pass buffer is live
+        pass_entries.emplace_back(pass_used);
+        std::vector<BRQ_Entry> & out=pass_entries.back();
+        std::vector<uint64_t> out_offset(N_BUCKETS+1);
+        out_offset[pass.firstBucket]=0;
+        for (auto b=pass.firstBucket;b<pass.lastBucket;++b) out_offset[b+1]=out_offset[b]+bucket_survivors[b];
+        #pragma omp parallel for schedule(dynamic,1)
+        for (auto b=pass.firstBucket;b<pass.lastBucket;++b) {
+            auto oItr=out.begin()+out_offset[b];
+            for (auto kItr=pass.begin(b);kItr<pass.begin(b)+bucket_survivors[b];++kItr)
+                *oItr++=BRQ_Entry((BRQ_Kmer)*kItr,kItr->kc);
+        }
+    });
+    //concatenate the passes, which come in sort order (as do the buckets within them), once their buffer is gone
+    std::vector<BRQ_Entry> entries;
+    if (pass_entries.size()==1) entries.swap(pass_entries[0]);
+    else {
+        entries.reserve(used);
+        for (auto & pe:pass_entries) {
+            entries.insert(entries.end(),pe.begin(),pe.end());
+            std::vector<BRQ_Entry>().swap(pe);
         }
-
     }
-    return kmer_list;
-
+    std::vector<std::vector<BRQ_Entry>>().swap(pass_entries);
+    //the dict is the sorted array itself, no hash set is built
+    (*dict) = new BRQ_Dict(0);
+    (*dict)->freezeSorted(&entries);
+    std::cout << Date() << ": " << used << " / " << total_distinct << " kmers with Freq >= " << minFreq << std::endl;
+    if (""!=workdir) {
+        uint64_t hist[101];
+        for (auto i = 0; i < 101; i++) {
+            hist[i]=0;
+            for (uint64_t t=0;t<nthreads;++t) hist[i]+=thread_hist[t*101+i];
+        }
+        std::ofstream kff(workdir + "/small_K.freqs");
+        for (auto i = 1; i < 101; i++) kff << i << ", " << hist[i] << std::endl;
+        kff.close();
+    }
 }
 
-
-void createDictOMPDiskBased(BRQ_Dict ** dict, vecbvec const& reads, VecPQVec const& quals, unsigned char disk_batches, uint64_t batch_size, unsigned minQual, unsigned minFreq, std::string workdir="", std::string tmpdir=""){
-    //If size larger than batch (or still not enough cpus used, or whatever), Lauch 2 tasks to sort the 2 halves, with minFreq=0
+// Disk batches hold sorted, collapsed kmers as unpadded 18-byte records (kmer, count, context) after a header
+// with a magic number and the record count.
+static const uint64_t KMER_BATCH_MAGIC = 0x31424D4B51524257ul;
+static const size_t KMER_BATCH_RECORD_SIZE = sizeof(BRQ_Kmer)+2;
+static const size_t KMER_BATCH_BUFFER_SIZE = 16ul << 20;
+
+class KmerBatchWriter {
+public:
+    KmerBatchWriter(std::string const & filename) : mFile(filename), mBuffer(KMER_BATCH_BUFFER_SIZE), mUsed(0), mRecords(0)
+    { writeHeader(); }
+    ~KmerBatchWriter() { close(); }
+
+    void write(KMerNodeFreq const & knf)
+    {   if (mUsed+KMER_BATCH_RECORD_SIZE>mBuffer.size()) flush();
+        unsigned char * rec=mBuffer.data()+mUsed;
+        memcpy(rec,&static_cast<BRQ_Kmer const &>(knf),sizeof(BRQ_Kmer));
+        rec[sizeof(BRQ_Kmer)]=knf.count;
+        memcpy(rec+sizeof(BRQ_Kmer)+1,&knf.kc,1);
+        mUsed+=KMER_BATCH_RECORD_SIZE;
+        ++mRecords; }
+
+    uint64_t records() const { return mRecords; }
+
+    void close()
+    {   if (!mFile.isOpen()) return;
+        flush();
+        mFile.seek(0);
+        writeHeader();
+        mFile.close(); }
+
+private:
+    void writeHeader()
+    {   uint64_t header[2]={KMER_BATCH_MAGIC,mRecords};
+        mFile.write(header,sizeof(header)); }
+
+    void flush()
+    {   if (mUsed) mFile.write(mBuffer.data(),mUsed);
+        mUsed=0; }
+
+    FileWriter mFile;
+    std::vector<unsigned char> mBuffer;
+    size_t mUsed;
+    uint64_t mRecords;
+};
+
+class KmerBatchReader {
+public:
+    KmerBatchReader(std::string const & filename) : mFile(filename), mBuffer(KMER_BATCH_BUFFER_SIZE), mPos(0), mEnd(0)
+    {   uint64_t header[2];
+        mFile.read(header,sizeof(header));
+        if (KMER_BATCH_MAGIC!=header[0]) FatalErr("Bad kmer batch file "+filename);
+        mRecords=mRemaining=header[1]; }
+
+    uint64_t records() const { return mRecords; }
+
+    /// Returns false at the end of the batch.
+    bool next(KMerNodeFreq & knf)
+    {   if (!mRemaining) return false;
+        if (mPos==mEnd) fill();
+        unsigned char const * rec=mBuffer.data()+mPos;
+        memcpy(&static_cast<BRQ_Kmer &>(knf),rec,sizeof(BRQ_Kmer));
+        knf.count=rec[sizeof(BRQ_Kmer)];
+        memcpy(&knf.kc,rec+sizeof(BRQ_Kmer)+1,1);
+        mPos+=KMER_BATCH_RECORD_SIZE;
+        --mRemaining;
+        return true; }
+
+private:
+    void fill()
+    {   size_t want=std::min(mRemaining,(uint64_t)(mBuffer.size()/KMER_BATCH_RECORD_SIZE))*KMER_BATCH_RECORD_SIZE;
+        mFile.read(mBuffer.data(),want);
+        mPos=0;
+        mEnd=want; }
+
+    FileReader mFile;
+    std::vector<unsigned char> mBuffer;
+    size_t mPos,mEnd;
+    uint64_t mRecords,mRemaining;
+};
+
+void createDictOMPDiskBased(BRQ_Dict ** dict, vecbvec const& reads, VecPQVec const& quals, unsigned char disk_batches, unsigned minQual, unsigned minFreq, std::string workdir="", std::string tmpdir=""){
     std::cout<<Date()<<": disk-based kmer counting with "<<(int) disk_batches<<" batches"<<std::endl;
-    uint64_t total_kmers_in_batches=0;
+    auto batch_name=[&tmpdir](int batch){ return tmpdir+"/kmer_count_batch_"+std::to_string(batch); };
     for (auto batch=0;batch < disk_batches;batch++) {
-        uint64_t nkmers=0;
-        //#pragma omp critical
-        //std::cout << "createDictOMPRecursive (thread "<<omp_get_thread_num()<<") from " << from << " to " << to << ", splitting..." << std::endl;
         uint64_t to = (batch+1) * reads.size()/disk_batches;
         uint64_t from= batch * reads.size()/disk_batches;
-        uint64_t mid_point = from + (to - from) / 2;
-        std::vector<KMerNodeFreq> entries1, entries2; //TODO: need to not copy but move the reference.
-#pragma omp task shared(reads,quals,entries1)
-        { entries1 = createDictOMPRecursive(NULL, reads, quals, from, mid_point, batch_size, minQual, minFreq);}
-#pragma omp task shared(reads,quals,entries2)
-        { entries2 = createDictOMPRecursive(NULL, reads, quals, mid_point, to, batch_size, minQual, minFreq); }
-#pragma omp taskwait
-        auto end1=entries1.end(),end2=entries2.end();
-        auto itr1=entries1.begin(),itr2=entries2.begin();
-        std::ofstream batch_file(tmpdir+"/kmer_count_batch_"+std::to_string((int)batch),std::ios::out | std::ios::trunc | std::ios::binary);
-        KMerNodeFreq knf;
-        while (itr1<end1 and itr2<end2){
-            if (*itr1==*itr2){
-                knf=*itr1;
-                combine_Entries(knf,*itr2);
-                batch_file.write((const char *)&knf,sizeof(knf));
-                ++itr1;
-                ++itr2;
-                ++nkmers;
-            } else if (*itr1<*itr2){
-                batch_file.write((const char *)&(*itr1),sizeof(knf));
-                ++itr1;
-                ++nkmers;
-            } else {
-                batch_file.write((const char *)&(*itr2),sizeof(knf));
-                ++itr2;
-                ++nkmers;
-            }
-        }
-        while (itr1<end1) {
-            batch_file.write((const char *)&(*itr1++),sizeof(knf));
-            ++nkmers;
-        }
-        while (itr2<end2) {
-            batch_file.write((const char *)&(*itr2++),sizeof(knf));
-            ++nkmers;
-        }
-        entries1.clear();
-        entries1.shrink_to_fit();
-        entries2.clear();
-        entries2.shrink_to_fit();
+        KmerBatchWriter batch_file(batch_name(batch));
+        //buckets arrive in global sort order, so the batch is written already sorted
+        countKmersBucketed(reads, quals, from, to, minQual, [&batch_file](KmerBucketPass const & pass){
+            for (auto b=pass.firstBucket;b<pass.lastBucket;++b)
+                for (auto kItr=pass.begin(b);kItr<pass.end(b);++kItr) batch_file.write(*kItr);
+        });
         batch_file.close();
-        std::cout<< Date() <<": batch "<<(int) batch<<" done and dumped with "<<nkmers<< " kmers" <<std::endl;
-        total_kmers_in_batches+=nkmers;
+        std::cout<< Date() <<": batch "<<(int) batch<<" done and dumped with "<<batch_file.records()<< " kmers" <<std::endl;
     }
 
-    //now a multi-merge sort between all batch files into the Dict
+    //k-way merge of the sorted batches through a min-heap, survivors are streamed to disk so the dict can be
+    //allocated with their exact count and nothing but the dict is ever held in memory.
     std::cout<<Date()<<": merging from disk"<<std::endl;
-    //open all batch files
-    std::ifstream dbf[disk_batches];
-    bool dbf_active[disk_batches];
-    KMerNodeFreq next_knf_from_dbf[disk_batches];
-    uint finished_files=0;
+    std::vector<std::unique_ptr<KmerBatchReader>> readers;
+    std::vector<KMerNodeFreq> heads(disk_batches);
+    std::vector<int> heap;
     for (auto i=0;i<disk_batches;i++){
-        dbf[i].open(tmpdir+"/kmer_count_batch_"+std::to_string((int)i),std::ios::in | std::ios::binary);
-        dbf[i].read((char *)&next_knf_from_dbf[i],sizeof(KMerNodeFreq));
-        dbf_active[i]=true;
+        readers.emplace_back(new KmerBatchReader(batch_name(i)));
+        if (readers.back()->next(heads[i])) heap.push_back(i);
     }
-    //set all finished flags to false
-    //TODO: stupid minimum search
+    auto heap_cmp=[&heads](int a, int b){ return heads[b] < heads[a]; };
+    std::make_heap(heap.begin(),heap.end(),heap_cmp);
+
+    uint64_t used=0,not_used=0;
+    uint64_t hist[101];
+    for (auto &h:hist) h=0;
+    std::string survivors_name=tmpdir+"/kmer_count_survivors";
+    KmerBatchWriter survivors(survivors_name);
     KMerNodeFreq current_kmer;
-    //while finished_files<batches
-    bool first=true;
-    uint min=0;
-    for (auto i=1;i<disk_batches;++i)
-        if (dbf_active[i]){
-            if (next_knf_from_dbf[i]<next_knf_from_dbf[min]) min=i;
-        }
-    current_kmer=next_knf_from_dbf[min];
-    current_kmer.count=0;
-    uint64_t used = 0,not_used=0;
-    uint64_t hist[256];
-    std::vector<KMerNodeFreq> kmerlist;
-
-    while (finished_files<disk_batches) {
-        //find minimum of the non-finished files
-        uint min=0;
-        for (auto i=1;i<disk_batches;++i)
-            if (dbf_active[i]){
-                if (next_knf_from_dbf[i]<next_knf_from_dbf[min]) min=i;
-            }
-        //larger than current kmer?
-        if (next_knf_from_dbf[min] > current_kmer) {
-            ++hist[current_kmer.count];
-            if (current_kmer.count>=minFreq) {
-                //(*dict)->insertEntryNoLocking(BRQ_Entry((BRQ_Kmer) current_kmer, current_kmer.kc));
-                kmerlist.push_back(current_kmer);
-                used++;
-            }
-            else not_used++;
-            current_kmer=next_knf_from_dbf[min];
-        } else {
-            combine_Entries(current_kmer,next_knf_from_dbf[min]);
+    bool have_current=false;
+    auto close_current=[&](){
+        ++hist[std::min(100,(int)current_kmer.count)];
+        if (current_kmer.count>=minFreq) {
+            survivors.write(current_kmer);
+            used++;
         }
-        //advance min file
-        dbf[min].read((char *)&next_knf_from_dbf[min],sizeof(KMerNodeFreq));
-        if ( dbf[min].eof() ) {
-            dbf_active[min]=false;
-            ++finished_files;
+        else not_used++;
+    };
+    while (not heap.empty()) {
+        std::pop_heap(heap.begin(),heap.end(),heap_cmp);
+        int min=heap.back();
+        if (have_current and heads[min]==current_kmer) combine_Entries(current_kmer,heads[min]);
+        else {
+            if (have_current) close_current();
+            current_kmer=heads[min];
+            have_current=true;
         }
+        if (readers[min]->next(heads[min])) std::push_heap(heap.begin(),heap.end(),heap_cmp);
+        else heap.pop_back();
     }
-    ++hist[std::min(100,(int)current_kmer.count)];
-    if (current_kmer.count>=minFreq) {
-        kmerlist.push_back(current_kmer);
-        used++;
-    }
-    else not_used++;
-    for (auto i=0;i<disk_batches;i++) {
-        dbf[i].close();
-        std::remove((tmpdir + "/kmer_count_batch_" +std::to_string((int)i)).c_str());
+    if (have_current) close_current();
+    survivors.close();
+    readers.clear();
+    for (auto i=0;i<disk_batches;i++) std::remove(batch_name(i).c_str());
+
+    {
+        //the survivors come off the disk in sort order, and become the dict as they are
+        std::vector<BRQ_Entry> entries;
+        entries.reserve(used);
+        KmerBatchReader survivors_in(survivors_name);
+        KMerNodeFreq knf;
+        while (survivors_in.next(knf)) entries.push_back(BRQ_Entry((BRQ_Kmer) knf, knf.kc));
+        (*dict)=new BRQ_Dict(0);
+        (*dict)->freezeSorted(&entries);
     }
-    (*dict)=new BRQ_Dict(kmerlist.size());
-    for (auto &knf: kmerlist) (*dict)->insertEntryNoLocking(BRQ_Entry((BRQ_Kmer) knf, knf.kc));
+    std::remove(survivors_name.c_str());
     std::cout << Date() << ": " << used << " / " << used+not_used << " kmers with Freq >= " << minFreq << std::endl;
     if (""!=workdir) {
         std::ofstream kff(workdir + "/small_K.freqs");
-        for (auto i = 1; i < 256; i++) kff << i << ", " << hist[i] << std::endl;
+        for (auto i = 1; i < 101; i++) kff << i << ", " << hist[i] << std::endl;
         kff.close();
     }
 
@@ -1256,26 +1405,21 @@ void buildReadQGraph( vecbvec const& reads, VecPQVec const& quals,
                       double minFreq2Fract, unsigned maxGapSize,
                       HyperBasevector* pHBV, ReadPathVec* pPaths, int _K, std::string workdir, std::string tmpdir="", unsigned char disk_batches=0)
 {
+    PerfLog::Scope perf_scope("buildReadQGraph");
     std::cout << Date() << ": creating kmers from reads..." << std::endl;
     //BRQ_Dict* pDict = createDictOMP(reads,quals,minQual,minFreq);
     BRQ_Dict * pDict;
     if (1>=disk_batches) {
-        #pragma omp parallel shared(pDict,reads,quals)
-        {
-            #pragma omp single
-            createDictOMPRecursive(&pDict, reads, quals, 0, reads.size(), 1000000, minQual, minFreq, workdir);
-        }
+        createDictOMPBucketed(&pDict, reads, quals, minQual, minFreq, workdir);
     }
     else {
         if (""==tmpdir) tmpdir=workdir;
-        #pragma omp parallel shared(pDict,reads,quals)
-        {
-            #pragma omp single
-            createDictOMPDiskBased(&pDict, reads, quals, disk_batches, 1000000, minQual, minFreq, workdir, tmpdir);
-        }
+        createDictOMPDiskBased(&pDict, reads, quals, disk_batches, minQual, minFreq, workdir, tmpdir);
     }
+    PerfLog::lap("KmerDict");
     std::cout << Date() << ": updating adjacencies" <<std::endl;
     pDict->recomputeAdjacencies();
+    PerfLog::lap("Adjacencies");
     std::cout << Date() << ": dict finished" <<std::endl;
     std::cout << Date() << ": finding edges (unique paths)" << std::endl;
     // figure out the complete base sequence of each edge
@@ -1283,15 +1427,18 @@ void buildReadQGraph( vecbvec const& reads, VecPQVec const& quals,
     edges.reserve(pDict->size()/100); //TODO: this is probably WAY too much in most scenarios
     buildEdges(*pDict,&edges);
 
+    PerfLog::lap("Edges");
     unsigned minFreq2 = std::max(2u,unsigned(minFreq2Fract*minFreq+.5));
 
     if ( doFillGaps ) { // Off by default
         std::cout << Date() << ": filling gaps." << std::endl;
+        pDict->thaw();
         fillGaps(reads, maxGapSize, minFreq2, &edges, pDict);
     }
 
     if ( doJoinOverlaps ) { // Off by default
         std::cout << Date() << ": joining Overlaps." << std::endl;
+        pDict->thaw();
         joinOverlaps(reads, _K / 2, minFreq2, &edges, pDict);
     }
 
@@ -1303,6 +1450,7 @@ void buildReadQGraph( vecbvec const& reads, VecPQVec const& quals,
         std::cout << Date() << ": building graph..." << std::endl;
         buildHBVFromEdges(edges,_K,pHBV,fwdEdgeXlat,revEdgeXlat);
         std::cout << Date() << ": graph built" << std::endl;
+        PerfLog::lap("Graph");
 
     }
     else
@@ -1310,10 +1458,13 @@ void buildReadQGraph( vecbvec const& reads, VecPQVec const& quals,
         std::cout << Date() << ": building graph..." << std::endl;
         buildHBVFromEdges(edges,K,pHBV,fwdEdgeXlat,revEdgeXlat);
         std::cout << Date() << ": graph built" << std::endl;
+        PerfLog::lap("Graph");
         std::cout << Date() << ": pathing reads into graph..." << std::endl;
         pPaths->clear();
         pPaths->resize(reads.size());
+        if ( !pDict->isFrozen() ) pDict->freeze(); // gap-filling and joining thaw it, and pathing needs an index
         path_reads_OMP(reads, quals, *pDict, edges, *pHBV, fwdEdgeXlat, revEdgeXlat, pPaths);
+        PerfLog::lap("PathReads");
         uint64_t pathed=0;
         uint64_t multipathed=0;
         for (auto &p:*pPaths) {
@@ -0,0 +1,114 @@
+//
+// EdgePathIndex.cc: the read paths through each edge, kept in step with the paths as the graph is edited.
+//
+
+#include "paths/long/EdgePathIndex.h"
+#include "system/Assert.h"
+
+void EdgePathIndex::build( ReadPathVec const& paths, size_t nEdges )
+{
+    size_t nPaths = paths.size();
+    int maxEdge = -1, minEdge = 0;
+    #pragma omp parallel for schedule(static,10000) reduction(max:maxEdge) reduction(min:minEdge)
+    for ( size_t id = 0; id < nPaths; ++id )
+        for ( int edge : paths[id] )
+            maxEdge = std::max(maxEdge,edge), minEdge = std::min(minEdge,edge);
+    ForceAssertGe(minEdge,0);
+    nEdges = std::max(nEdges,size_t(maxEdge+1));
+
+    std::vector<uint64_t> counts(nEdges,0ul);
+    #pragma omp parallel for schedule(static,10000)
+    for ( size_t id = 0; id < nPaths; ++id )
+        for ( int edge : paths[id] )
+        {
+            #pragma omp atomic
+            counts[edge] += 1;
+        }
+
+    clear();
+    resize(nEdges);
+    #pragma omp parallel for schedule(dynamic,10000)
+    for ( size_t edge = 0; edge < nEdges; ++edge )
+    {   (*this)[edge].resize(counts[edge]);
+        counts[edge] = 0; }
+
+    #pragma omp parallel for schedule(static,10000)
+    for ( size_t id = 0; id < nPaths; ++id )
+        for ( int edge : paths[id] )
+        {
+            uint64_t pos;
+            #pragma omp atomic capture
+            pos = counts[edge]++;
+            (*this)[edge][pos] = id;
+        }
+
+    // threads fill each list in runs of ascending ids, so there's little sorting left to do
+    #pragma omp parallel for schedule(dynamic,1000)
+    for ( size_t edge = 0; edge < nEdges; ++edge )
+    {   ULongVec& ids = (*this)[edge];
+        std::sort(ids.begin(),ids.end()); }
+}
+
+void EdgePathIndex::renumberEdges( vec<int> const& renumber, size_t nEdges )
+{
+    size_t nnn = std::min(renumber.size(),size());
+    for ( size_t edge = 0; edge != nnn; ++edge )
+    {
+        int newEdge = renumber[edge];
+        if ( newEdge < 0 || size_t(newEdge) == edge ) continue;
+        ForceAssertLt(size_t(newEdge),edge);
+        (*this)[newEdge].swap((*this)[edge]);
+    }
+    resize(nEdges);
+}
+
+void EdgePathIndex::Updater::apply()
+{
+    if ( !mpIndex ) return;
+    size_t total = 0;
+    for ( auto const& changes : mChanges ) total += changes.size();
+    if ( !total ) return;
+    std::vector<Change> changes;
+    changes.reserve(total);
+    for ( auto& threadChanges : mChanges )
+    {   changes.insert(changes.end(),threadChanges.begin(),threadChanges.end());
+        std::vector<Change>().swap(threadChanges); }
+    std::sort(changes.begin(),changes.end());
+
+    EdgePathIndex& index = *mpIndex;
+    if ( size_t(changes.back().edge) >= index.size() ) index.resize(changes.back().edge+1);
+    std::vector<size_t> starts;
+    for ( size_t idx = 0; idx != total; ++idx )
+        if ( !idx || changes[idx].edge != changes[idx-1].edge ) starts.push_back(idx);
+    starts.push_back(total);
+
+    #pragma omp parallel for schedule(dynamic,100)
+    for ( size_t grp = 0; grp < starts.size()-1; ++grp )
+    {
+        auto beg = changes.begin()+starts[grp], end = changes.begin()+starts[grp+1];
+        auto mid = std::find_if(beg,end,[]( Change const& change ) { return change.added; });
+        ULongVec& ids = index[beg->edge];
+
+        // drop one occurrence for each removal
+        std::vector<uint64_t> kept;
+        kept.reserve(ids.size());
+        auto rItr = beg;
+        for ( uint64_t id : ids )
+        {
+            while ( rItr != mid && rItr->id < id ) ++rItr;
+            if ( rItr != mid && rItr->id == id ) ++rItr;
+            else kept.push_back(id);
+        }
+
+        // merge in the additions
+        ids.clear();
+        ids.reserve(kept.size()+(end-mid));
+        auto aItr = mid;
+        for ( uint64_t id : kept )
+        {
+            while ( aItr != end && aItr->id < id ) ids.push_back((aItr++)->id);
+            ids.push_back(id);
+        }
+        while ( aItr != end ) ids.push_back((aItr++)->id);
+    }
+}
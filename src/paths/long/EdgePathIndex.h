@@ -0,0 +1,102 @@
+//
+// EdgePathIndex.h: the read paths through each edge, kept in step with the paths as the graph is edited.
+//
+
+#ifndef W2RAP_CONTIGGER_EDGEPATHINDEX_H
+#define W2RAP_CONTIGGER_EDGEPATHINDEX_H
+
+#include "Intvector.h"
+#include "Vec.h"
+#include "paths/long/ReadPath.h"
+#include <algorithm>
+#include <vector>
+#include <omp.h>
+
+// For each edge, the ids of the read paths through it in ascending order, an id appearing once for each visit:
+// just what invert( paths, index, hb.EdgeObjectCount( ) ) makes, and usable wherever that VecULongVec is.
+// The graph edits that renumber, merge or delete edges and rewrite the paths to match (CleanupCore,
+// RemoveUnneededVertices2, PathFinder::migrate_readpaths, PullAparter) take an index too, and patch just the
+// lists of the paths they rewrite, so that one index can be carried from pass to pass instead of being rebuilt.
+class EdgePathIndex : public VecULongVec
+{
+public:
+    EdgePathIndex() = default;
+    EdgePathIndex( ReadPathVec const& paths, size_t nEdges ) { build(paths,nEdges); }
+
+    // (Re)builds the index from scratch, in parallel.
+    void build( ReadPathVec const& paths, size_t nEdges );
+
+    // Moves each edge's list to renumber[edge], dropping it if that's -1, and sizes the index for nEdges.
+    // Edges may only move down (renumber[edge] <= edge), as they do when dead edge objects are removed.
+    void renumberEdges( vec<int> const& renumber, size_t nEdges );
+
+    // Notes changes to paths and applies them to the index as a batch, in parallel over the edges.  Changes can
+    // be noted from any number of threads.  An Updater made with a null index ignores everything, so that
+    // functions that maintain an index when they're given one needn't test for it at every step.
+    class Updater
+    {
+    public:
+        explicit Updater( EdgePathIndex* pIndex )
+        : mpIndex(pIndex), mChanges(pIndex ? omp_get_max_threads() : 0) {}
+
+        ~Updater() { apply(); }
+
+        Updater( Updater const& ) = delete;
+        Updater& operator=( Updater const& ) = delete;
+
+        // path id now visits (one more time) edge
+        void add( uint64_t id, int edge ) { note(edge,true,id); }
+
+        // path id no longer visits edge (as often)
+        void remove( uint64_t id, int edge ) { note(edge,false,id); }
+
+        // path id, which ran over the edges of oldPath, now runs over those of newPath
+        template <class OldPath, class NewPath>
+        void replace( uint64_t id, OldPath const& oldPath, NewPath const& newPath );
+
+        // Patches the index with everything noted so far.
+        void apply();
+
+    private:
+        struct Change
+        {
+            int edge;
+            bool added;
+            uint64_t id;
+
+            friend bool operator<( Change const& c1, Change const& c2 )
+            { if ( c1.edge != c2.edge ) return c1.edge < c2.edge;
+              if ( c1.added != c2.added ) return c2.added;
+              return c1.id < c2.id; }
+        };
+
+        void note( int edge, bool added, uint64_t id )
+        { if ( mpIndex && edge >= 0 )
+              mChanges[omp_get_thread_num()%mChanges.size()].push_back(Change{edge,added,id}); }
+
+        EdgePathIndex* mpIndex;
+        std::vector<std::vector<Change>> mChanges; // one per thread
+    };
+};
+
+template <class OldPath, class NewPath>
+void EdgePathIndex::Updater::replace( uint64_t id, OldPath const& oldPath, NewPath const& newPath )
+{
+    if ( !mpIndex ) return;
+    if ( oldPath.size() == newPath.size() && std::equal(oldPath.begin(),oldPath.end(),newPath.begin()) )
+        return;
+    std::vector<int> oldEdges(oldPath.begin(),oldPath.end());
+    std::vector<int> newEdges(newPath.begin(),newPath.end());
+    std::sort(oldEdges.begin(),oldEdges.end());
+    std::sort(newEdges.begin(),newEdges.end());
+    auto oItr = oldEdges.begin(), oEnd = oldEdges.end();
+    auto nItr = newEdges.begin(), nEnd = newEdges.end();
+    while ( oItr != oEnd || nItr != nEnd )
+    {
+        if ( nItr == nEnd || (oItr != oEnd && *oItr < *nItr) ) remove(id,*oItr++);
+        else if ( oItr == oEnd || *nItr < *oItr ) add(id,*nItr++);
+        else ++oItr, ++nItr; // visited before and after
+    }
+}
+
+#endif //W2RAP_CONTIGGER_EDGEPATHINDEX_H
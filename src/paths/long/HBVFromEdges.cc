@@ -14,6 +14,8 @@
 
 #include "paths/long/HBVFromEdges.h"
 #include "math/Hash.h"
+#include <parallel/algorithm>
+#include <omp.h>
 
 class EdgeEnd
 {
@@ -53,14 +55,15 @@ public:
     EdgeEnd ee;
     bool distal,rc;
     uint64_t edge_index;
+    EdgeEndWrapper()=default;
     EdgeEndWrapper(const uint64_t _edge_index, const bvec & bvseq,const bool &_rc,const bool &_distal, const unsigned overlap) {
         edge_index=_edge_index;
         distal=_distal;
         rc=_rc;
         ee=EdgeEnd(&bvseq,_rc,_distal,overlap);
     };
-    bool operator<(const EdgeEndWrapper & other){return ee<other.ee;};//WARNING, for simplicity
-    bool operator==(const EdgeEndWrapper & other){return ee==other.ee;};//WARNING, for simplicity
+    bool operator<(const EdgeEndWrapper & other) const {return ee<other.ee;};//WARNING, for simplicity
+    bool operator==(const EdgeEndWrapper & other) const {return ee==other.ee;};//WARNING, for simplicity
 
 };
 
@@ -72,6 +75,16 @@ typedef struct {
     int64_t fw_v1,fw_v2,rc_v1,rc_v2;
 } edge_vertex_list;
 
+// Sorts one adjacency list on (adjacent vertex, edge id), the order AddEdge keeps them in, and fills in the
+// adjacent vertices.
+static void sortAdjacencies( vec<int>& edgeIds, vec<int>& verts, std::vector<int> const& otherEnd )
+{
+    std::sort(edgeIds.begin(),edgeIds.end(),[&otherEnd]( int e1, int e2 )
+              { return otherEnd[e1] != otherEnd[e2] ? otherEnd[e1] < otherEnd[e2] : e1 < e2; });
+    verts.resize(edgeIds.size());
+    for ( size_t idx = 0; idx != edgeIds.size(); ++idx )
+        verts[idx] = otherEnd[edgeIds[idx]];
+}
 
 void buildHBVFromEdges( vecbvec const& edges, unsigned K, HyperBasevector* pHBV,
                             std::vector<int> &pFwdEdgeXlat, std::vector<int> &pRevEdgeXlat )
@@ -85,72 +98,121 @@ void buildHBVFromEdges( vecbvec const& edges, unsigned K, HyperBasevector* pHBV,
         return;
     }
 
-    std::vector<EdgeEndWrapper> ends;
-    ends.reserve(2*edges.size());
+    //the graph edge ids: each edge, then its rc unless it's a palindrome
+    int64_t nEdges=edges.size();
+    std::vector<char> isPalindrome(nEdges);
+    #pragma omp parallel for schedule(dynamic,10000)
+    for (int64_t i=0;i<nEdges;++i)
+        isPalindrome[i] = edges[i].getCanonicalForm() == CanonicalForm::PALINDROME;
+    pFwdEdgeXlat.resize(nEdges,-1);
+    pRevEdgeXlat.resize(nEdges,-1);
+    int nGraphEdges=0;
+    for (int64_t i=0;i<nEdges;++i){
+        pFwdEdgeXlat[i]=nGraphEdges++;
+        pRevEdgeXlat[i]=isPalindrome[i] ? pFwdEdgeXlat[i] : nGraphEdges++;
+    }
 
-    for (uint64_t i=0;i<edges.size();++i){
-        ends.push_back(EdgeEndWrapper(i,edges[i],false,false,K-1));
-        ends.push_back(EdgeEndWrapper(i,edges[i],false,true,K-1));
-        if ( edges[i].getCanonicalForm() != CanonicalForm::PALINDROME ) {
-            ends.push_back(EdgeEndWrapper(i,edges[i],true,false,K-1));
-            ends.push_back(EdgeEndWrapper(i,edges[i],true,true,K-1));
+    //two ends per graph edge, the ends of edge i starting at 2*pFwdEdgeXlat[i]
+    std::vector<EdgeEndWrapper> ends(2*size_t(nGraphEdges));
+    #pragma omp parallel for schedule(dynamic,10000)
+    for (int64_t i=0;i<nEdges;++i){
+        auto itr=ends.begin()+2*size_t(pFwdEdgeXlat[i]);
+        *itr++=EdgeEndWrapper(i,edges[i],false,false,K-1);
+        *itr++=EdgeEndWrapper(i,edges[i],false,true,K-1);
+        if ( !isPalindrome[i] ) {
+            *itr++=EdgeEndWrapper(i,edges[i],true,false,K-1);
+            *itr++=EdgeEndWrapper(i,edges[i],true,true,K-1);
         }
     }
-    std::sort(ends.begin(),ends.end());
+    __gnu_parallel::sort(ends.begin(),ends.end());
 
-
-    //number the vertices and fill a list of vertex numbers for the edges
+    //number the vertices (a new one wherever the end changes) by a prefix sum over chunks of the sorted ends,
+    //and fill a list of vertex numbers for the edges
     std::vector<edge_vertex_list> edge_vertices;
-    edge_vertices.resize(edges.size(),{-1,-1,-1,-1});
-    uint64_t vID=0;
-    //uint64_t ecount[5]={0,0,0,0,0};
-    //uint64_t vcount=0;
-    //Can't be parallel, because vID depends on previous iteration
-    for (auto i=0; i<ends.size(); ++i){
-        if (i>0 and not (ends[i-1]==ends[i])) {
-            vID++;
-            //if (vcount>5) vcount=5;
-            //++ecount[vcount-1];
-            //vcount=0;
-        }
-        //++vcount;
-        if (!ends[i].rc) {
-            if (!ends[i].distal) edge_vertices[ends[i].edge_index].fw_v1=vID;
-            else edge_vertices[ends[i].edge_index].fw_v2=vID;
-        } else {
-            if (!ends[i].distal) edge_vertices[ends[i].edge_index].rc_v1=vID;
-            else edge_vertices[ends[i].edge_index].rc_v2=vID;
+    edge_vertices.resize(nEdges,{-1,-1,-1,-1});
+    int64_t nEnds=ends.size();
+    int64_t nChunks=4*omp_get_max_threads();
+    std::vector<int64_t> chunkFirstVertex(nChunks+1,0);
+    #pragma omp parallel for schedule(dynamic,1)
+    for (int64_t chunk=0; chunk<nChunks; ++chunk){
+        int64_t beg=std::max(nEnds*chunk/nChunks,int64_t(1)), end=nEnds*(chunk+1)/nChunks;
+        for (int64_t i=beg; i<end; ++i)
+            if (not (ends[i-1]==ends[i])) chunkFirstVertex[chunk+1]++;
+    }
+    for (int64_t chunk=0; chunk<nChunks; ++chunk) chunkFirstVertex[chunk+1]+=chunkFirstVertex[chunk];
+    #pragma omp parallel for schedule(dynamic,1)
+    for (int64_t chunk=0; chunk<nChunks; ++chunk){
+        int64_t vID=chunkFirstVertex[chunk];
+        for (int64_t i=nEnds*chunk/nChunks, end=nEnds*(chunk+1)/nChunks; i<end; ++i){
+            if (i>0 and not (ends[i-1]==ends[i])) vID++;
+            edge_vertex_list& ev=edge_vertices[ends[i].edge_index];
+            if (!ends[i].rc) {
+                if (!ends[i].distal) ev.fw_v1=vID;
+                else ev.fw_v2=vID;
+            } else {
+                if (!ends[i].distal) ev.rc_v1=vID;
+                else ev.rc_v2=vID;
+            }
         }
     }
-    ++vID;
+    int64_t nVertices=chunkFirstVertex[nChunks]+1;
+    std::vector<EdgeEndWrapper>().swap(ends);
 
-    //std::cout<<Date()<<": vertices by edge count:  1:"<<ecount[0]<<" 2:"<<ecount[1]
-    //         <<" 3:"<<ecount[2]<<" 4:"<<ecount[3]<<" 5+:"<<ecount[4]<<std::endl;
+    //now the edges, and their rcs, straight into the graph: the edge objects in parallel, then the adjacency
+    //lists, each sorted as AddEdge would have left it
     pHBV->SetK(K);
-    pHBV->AddVertices(vID);
-    pHBV->EdgesMutable().reserve(2*edges.size());
-
-    pFwdEdgeXlat.resize(edges.size(),-1);
-    pRevEdgeXlat.resize(edges.size(),-1);
-
-    //Now add the edges, and their rcs to the graph, this probably shouldn't be parallel neither (data corruption)
-    for (uint64_t i=0;i<edges.size();++i){
-        auto fwEdgeId = pHBV->EdgeObjectCount();
-        bvec edge = edges[i];
-        pHBV->AddEdge(edge_vertices[i].fw_v1,edge_vertices[i].fw_v2,edge);
-        pFwdEdgeXlat[i]=fwEdgeId;
-        if ( edges[i].getCanonicalForm() == CanonicalForm::PALINDROME ) {
-            pRevEdgeXlat[i] = fwEdgeId;
-        }
-        else {
-            auto bwEdgeId = pHBV->EdgeObjectCount();
-            pHBV->AddEdge(edge_vertices[i].rc_v1, edge_vertices[i].rc_v2, edge);
-            pHBV->EdgeObjectMutable(bwEdgeId).ReverseComplement();
-            pRevEdgeXlat[i] = bwEdgeId;
+    std::vector<int> edgeFrom(nGraphEdges), edgeTo(nGraphEdges);
+    vec<bvec>& graphEdges=pHBV->EdgesMutable();
+    graphEdges.resize(nGraphEdges);
+    #pragma omp parallel for schedule(dynamic,10000)
+    for (int64_t i=0;i<nEdges;++i){
+        int fwEdgeId=pFwdEdgeXlat[i];
+        graphEdges[fwEdgeId]=edges[i];
+        edgeFrom[fwEdgeId]=edge_vertices[i].fw_v1;
+        edgeTo[fwEdgeId]=edge_vertices[i].fw_v2;
+        if ( !isPalindrome[i] ) {
+            int bwEdgeId=pRevEdgeXlat[i];
+            graphEdges[bwEdgeId].ReverseComplement(edges[i]);
+            edgeFrom[bwEdgeId]=edge_vertices[i].rc_v1;
+            edgeTo[bwEdgeId]=edge_vertices[i].rc_v2;
         }
     }
+    std::vector<edge_vertex_list>().swap(edge_vertices);
 
-
+    vec<vec<int>>& from=pHBV->FromMutable();
+    vec<vec<int>>& to=pHBV->ToMutable();
+    vec<vec<int>>& fromEdges=pHBV->FromEdgeObjMutable();
+    vec<vec<int>>& toEdges=pHBV->ToEdgeObjMutable();
+    from.resize(nVertices), to.resize(nVertices);
+    fromEdges.resize(nVertices), toEdges.resize(nVertices);
+    std::vector<int> nFrom(nVertices,0), nTo(nVertices,0);
+    #pragma omp parallel for schedule(static,10000)
+    for (int e=0;e<nGraphEdges;++e){
+        #pragma omp atomic
+        nFrom[edgeFrom[e]]++;
+        #pragma omp atomic
+        nTo[edgeTo[e]]++;
+    }
+    #pragma omp parallel for schedule(dynamic,10000)
+    for (int64_t v=0;v<nVertices;++v){
+        fromEdges[v].resize(nFrom[v]), toEdges[v].resize(nTo[v]);
+        nFrom[v]=nTo[v]=0;
+    }
+    #pragma omp parallel for schedule(static,10000)
+    for (int e=0;e<nGraphEdges;++e){
+        int pos;
+        #pragma omp atomic capture
+        pos=nFrom[edgeFrom[e]]++;
+        fromEdges[edgeFrom[e]][pos]=e;
+        #pragma omp atomic capture
+        pos=nTo[edgeTo[e]]++;
+        toEdges[edgeTo[e]][pos]=e;
+    }
+    #pragma omp parallel for schedule(dynamic,10000)
+    for (int64_t v=0;v<nVertices;++v){
+        sortAdjacencies(fromEdges[v],from[v],edgeTo);
+        sortAdjacencies(toEdges[v],to[v],edgeFrom);
+    }
 }
 
 
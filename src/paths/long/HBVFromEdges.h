@@ -24,6 +24,7 @@
 // each edge and its RC (except palindromes).
 // The two optional vec<int> args give you the translation from the original
 // edge index to the HBV edge object index for the fwd and RC cases.
+// Parallel.
 void buildHBVFromEdges( vecbvec const& edges, unsigned K, HyperBasevector* pHBV,
                              std::vector<int> &pFwdEdgeXlat, std::vector<int> &pRevEdgeXlat );
 
@@ -2,38 +2,185 @@
 // Created by Bernardo Clavijo (TGAC) on 22/10/2016.
 //
 #include "ReadPath.h"
+#include "system/System.h"
+#include "system/file/FileReader.h"
+#include "system/file/FileWriter.h"
+#include <sys/mman.h>
 
-void WriteReadPathVec(const ReadPathVec &rpv, const char * filename){
-    std::ofstream f(filename, std::ios::out | std::ios::trunc | std::ios::binary);
-    uint64_t pathcount=rpv.size();
-    f.write((const char *) &pathcount, sizeof(pathcount));
-    uint16_t ps;
-    int mOffset;
-    for (auto const &rp:rpv){
-        mOffset=rp.getOffset();
-        ps=rp.size();
-        f.write((const char *) &mOffset, sizeof(mOffset));
-        f.write((const char *) &ps, sizeof(ps));
-        f.write((const char *) rp.data(),ps*sizeof(int));
+namespace
+{
+
+// "RPV_FLAT": no old-format file could ever have this many paths in its first word
+uint64_t const READPATHVEC_MAGIC = 0x5250565f464c4154ul;
+uint64_t const READPATHVEC_VERSION = 1;
+
+struct ReadPathVecHeader
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t nPaths;
+    uint64_t nEdges;
+};
+
+size_t const WRITE_BUFFER_ENTRIES = 1ul << 20;
+
+template <class T, class Func>
+void writeBuffered( FileWriter& fw, ReadPathVec const& rpv, Func func )
+{
+    std::vector<T> buf;
+    buf.reserve(WRITE_BUFFER_ENTRIES);
+    for ( auto const& rp : rpv )
+    {
+        func(rp,buf);
+        if ( buf.size() >= WRITE_BUFFER_ENTRIES )
+        {   fw.write(buf.data(),buf.size()*sizeof(T));
+            buf.clear(); }
     }
-    f.close();
+    if ( !buf.empty() ) fw.write(buf.data(),buf.size()*sizeof(T));
+}
+
+}
+
+void ReadPath::realloc( size_t cap )
+{
+    size_t sz = size();
+    if ( cap <= INLINE_EDGES )
+    {
+        if ( !onHeap() ) return;
+        int* ptr = mHeap.ptr;
+        std::copy(ptr,ptr+sz,mInline);
+        delete [] ptr;
+        mSizeAndMode = sz;
+        return;
+    }
+    if ( cap > ~HEAP_BIT )
+        FatalErr("ReadPath can't hold " << cap << " edges.");
+    int* ptr = new int[cap];
+    std::copy(begin(),end(),ptr);
+    if ( onHeap() ) delete [] mHeap.ptr;
+    mHeap.ptr = ptr;
+    mHeap.cap = cap;
+    mSizeAndMode = sz | HEAP_BIT;
+}
+
+size_t ReadPath::makeRoom( const_iterator pos, size_t n )
+{
+    size_t idx = pos-data();
+    size_t sz = size();
+    if ( sz+n > capacity() ) realloc(std::max(sz+n,2*sz));
+    int* dat = data();
+    std::copy_backward(dat+idx,dat+sz,dat+sz+n);
+    setSize(sz+n);
+    return idx;
+}
+
+void CompactReadPathVec(ReadPathVec &rpv){
+    #pragma omp parallel for schedule(static,10000)
+    for (uint64_t i=0;i<rpv.size();++i) rpv[i].shrink_to_fit();
+    rpv.shrink_to_fit();
+}
+
+void WriteReadPathVec(const ReadPathVec &rpv, const char * filename){
+    ReadPathVecHeader hdr;
+    hdr.magic = READPATHVEC_MAGIC;
+    hdr.version = READPATHVEC_VERSION;
+    hdr.nPaths = rpv.size();
+    hdr.nEdges = 0;
+    for (auto const &rp:rpv) hdr.nEdges += rp.size();
+
+    FileWriter fw(filename);
+    fw.write(&hdr,sizeof(hdr));
+    uint64_t start = 0;
+    fw.write(&start,sizeof(start));
+    writeBuffered<uint64_t>(fw,rpv,[&start]( ReadPath const& rp, std::vector<uint64_t>& buf )
+                                    { buf.push_back(start += rp.size()); });
+    writeBuffered<int>(fw,rpv,[]( ReadPath const& rp, std::vector<int>& buf )
+                                    { buf.push_back(rp.getOffset()); });
+    writeBuffered<int>(fw,rpv,[]( ReadPath const& rp, std::vector<int>& buf )
+                                    { buf.insert(buf.end(),rp.begin(),rp.end()); });
+    fw.close();
 }
 
 
 void LoadReadPathVec(ReadPathVec &rpv, const char * filename){
+    MappedReadPathVec mrpv(filename);
+    rpv.clear();
+    rpv.resize(mrpv.size());
+    #pragma omp parallel for schedule(static,10000)
+    for (uint64_t i=0;i<mrpv.size();++i){
+        ReadPathRef rp=mrpv[i];
+        rpv[i].setOffset(rp.getOffset());
+        rpv[i].assign(rp.begin(),rp.end());
+    }
+}
+
+MappedReadPathVec::MappedReadPathVec( std::string const& filename )
+: mNPaths(0), mStarts(nullptr), mOffsets(nullptr), mEdges(nullptr), mMap(nullptr), mMapLen(0)
+{
+    FileReader fr(filename);
+    size_t fileSize = fr.getSize();
+    ReadPathVecHeader hdr;
+    if ( fileSize < sizeof(hdr.magic) )
+        FatalErr("Paths file " << filename << " is truncated.");
+    fr.read(&hdr.magic,sizeof(hdr.magic));
+    if ( hdr.magic != READPATHVEC_MAGIC )
+    {
+        fr.close();
+        loadOldFormat(filename);
+        return;
+    }
+    if ( fileSize < sizeof(hdr) )
+        FatalErr("Paths file " << filename << " is truncated.");
+    fr.seek(0).read(&hdr,sizeof(hdr));
+    if ( hdr.version != READPATHVEC_VERSION )
+        FatalErr("Paths file " << filename << " has format version " << hdr.version
+                 << ", but this code reads version " << READPATHVEC_VERSION << '.');
+    size_t expected = sizeof(hdr) + (hdr.nPaths+1)*sizeof(uint64_t)
+                        + (hdr.nPaths+hdr.nEdges)*sizeof(int);
+    if ( fileSize != expected )
+        FatalErr("Paths file " << filename << " should be " << expected
+                 << " bytes long, but it's " << fileSize << '.');
+
+    mMapLen = fileSize;
+    mMap = fr.map(0,mMapLen,true);
+    madvise(mMap,mMapLen,MADV_WILLNEED);
+    char const* base = static_cast<char const*>(mMap);
+    mNPaths = hdr.nPaths;
+    mStarts = reinterpret_cast<uint64_t const*>(base+sizeof(hdr));
+    mOffsets = reinterpret_cast<int const*>(mStarts+mNPaths+1);
+    mEdges = mOffsets+mNPaths;
+    if ( mStarts[mNPaths] != hdr.nEdges )
+        FatalErr("Paths file " << filename << " is corrupt: its path sizes don't add up.");
+}
+
+MappedReadPathVec::~MappedReadPathVec()
+{
+    if ( mMap ) munmap(mMap,mMapLen);
+}
+
+void MappedReadPathVec::loadOldFormat( std::string const& filename )
+{
     std::ifstream f(filename, std::ios::in | std::ios::binary);
     uint64_t pathcount;
-    f.read((const char *) &pathcount, sizeof(pathcount));
-    rpv.resize(pathcount);
+    f.read((char *) &pathcount, sizeof(pathcount));
+    mOwnedStarts.reserve(pathcount+1);
+    mOwnedOffsets.reserve(pathcount);
+    mOwnedStarts.push_back(0);
     uint16_t ps;
     int mOffset;
-    for (auto const &rp:rpv){
-        f.read((const char *) &mOffset, sizeof(mOffset));
-        rp.setOffset(mOffset);
-        f.read((const char *) &ps, sizeof(ps));
-        rp.resize(ps);
-        f.read((const char *) rp.data(),ps*sizeof(int));
+    for (uint64_t i=0;i<pathcount;++i){
+        f.read((char *) &mOffset, sizeof(mOffset));
+        f.read((char *) &ps, sizeof(ps));
+        mOwnedOffsets.push_back(mOffset);
+        size_t oldSize=mOwnedEdges.size();
+        mOwnedEdges.resize(oldSize+ps);
+        f.read((char *) (mOwnedEdges.data()+oldSize),ps*sizeof(int));
+        mOwnedStarts.push_back(mOwnedEdges.size());
     }
+    if ( !f ) FatalErr("Paths file " << filename << " is truncated.");
     f.close();
+    mNPaths = pathcount;
+    mStarts = mOwnedStarts.data();
+    mOffsets = mOwnedOffsets.data();
+    mEdges = mOwnedEdges.data();
 }
-
@@ -17,23 +17,70 @@
 
 #include <vector>
 #include <fstream>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
 
 // A description of a graph traversal by some sequence (a read, let's say).
 // It's just a vector of edge IDs, but it also tells you how many bases at the
 // start of the first edge to skip, and how many bases at the end of the last
 // edge to skip.
-class ReadPath : public std::vector<int>
+// There are hundreds of millions of these, and most have only a few edges, so
+// the edge IDs are kept inside the object itself unless there are more than
+// INLINE_EDGES of them.  The interface is that of a std::vector<int>.
+class ReadPath
 {
 public:
-    ReadPath() :  mOffset(0) {}
+    typedef int value_type;
+    typedef int& reference;
+    typedef int const& const_reference;
+    typedef int* pointer;
+    typedef int const* const_pointer;
+    typedef int* iterator;
+    typedef int const* const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    static unsigned const INLINE_EDGES = 4;
+
+    ReadPath() : mOffset(0), mSizeAndMode(0) {}
     ReadPath( int offset )
-    : mOffset(offset) {}
+    : mOffset(offset), mSizeAndMode(0) {}
 
     ReadPath( int offset, const std::vector<int>& edge_list )
-    : mOffset(offset) {
+    : mOffset(offset), mSizeAndMode(0) {
 	this->assign(edge_list.begin(), edge_list.end());
     }
 
+    ReadPath( ReadPath const& that )
+    : mOffset(that.mOffset), mSizeAndMode(0)
+    { assign(that.begin(),that.end()); }
+
+    ReadPath( ReadPath&& that ) noexcept
+    : mOffset(that.mOffset), mSizeAndMode(that.mSizeAndMode)
+    { if ( that.onHeap() ) { mHeap = that.mHeap; that.mSizeAndMode = 0; }
+      else std::copy(that.mInline,that.mInline+size(),mInline);
+      that.setSize(0); }
+
+    ~ReadPath() { if ( onHeap() ) delete [] mHeap.ptr; }
+
+    ReadPath& operator=( ReadPath const& that )
+    { if ( this != &that ) { mOffset = that.mOffset; assign(that.begin(),that.end()); }
+      return *this; }
+
+    ReadPath& operator=( ReadPath&& that ) noexcept
+    { if ( this != &that ) { ReadPath tmp(std::move(that)); swap(tmp); }
+      return *this; }
+
+    explicit operator std::vector<int>() const { return std::vector<int>(begin(),end()); }
+
     int getOffset() const { return mOffset; }
     void setOffset( int offset ) { mOffset = offset; }
     void addOffset( int add ) { mOffset += add; }
@@ -44,20 +91,213 @@ public:
     unsigned getFirstSkip() const { return (mOffset < 0 ? 0u : static_cast<unsigned>(mOffset)); }
     void setFirstSkip( unsigned firstSkip ) { mOffset = firstSkip; }
 
+    size_t size() const { return mSizeAndMode & ~HEAP_BIT; }
+    bool empty() const { return !size(); }
+    size_t capacity() const { return onHeap() ? mHeap.cap : INLINE_EDGES; }
+    void reserve( size_t cap ) { if ( cap > capacity() ) realloc(cap); }
+
+    // Gives back unused heap space, and moves short paths back inside the object.
+    void shrink_to_fit() { if ( onHeap() && mHeap.cap != size() ) realloc(size()); }
+
+    int* data() { return onHeap() ? mHeap.ptr : mInline; }
+    int const* data() const { return onHeap() ? mHeap.ptr : mInline; }
+
+    iterator begin() { return data(); }
+    const_iterator begin() const { return data(); }
+    const_iterator cbegin() const { return data(); }
+    iterator end() { return data()+size(); }
+    const_iterator end() const { return data()+size(); }
+    const_iterator cend() const { return data()+size(); }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator crend() const { return const_reverse_iterator(begin()); }
+
+    int& operator[]( size_t idx ) { return data()[idx]; }
+    int const& operator[]( size_t idx ) const { return data()[idx]; }
+    int& front() { return *data(); }
+    int const& front() const { return *data(); }
+    int& back() { return end()[-1]; }
+    int const& back() const { return end()[-1]; }
+
+    void clear() { setSize(0); }
+
+    void push_back( int const i )
+    { size_t sz = size();
+      if ( sz == capacity() ) realloc(2*sz);
+      data()[sz] = i; setSize(sz+1); }
+    void pop_back() { setSize(size()-1); }
+
     void push_front(int const i){
         this->insert(this->begin(),i);
     }
+
+    void resize( size_t sz, int const i = 0 )
+    { reserve(sz);
+      if ( sz > size() ) std::fill(end(),data()+sz,i);
+      setSize(sz); }
+
+    template <class Itr>
+    void assign( Itr first, Itr last )
+    { size_t sz = std::distance(first,last);
+      setSize(0); reserve(sz);
+      std::copy(first,last,data()); setSize(sz); }
+    void assign( size_t sz, int const i )
+    { setSize(0); resize(sz,i); }
+    void assign( std::initializer_list<int> list )
+    { assign(list.begin(),list.end()); }
+
+    iterator insert( const_iterator pos, int const i )
+    { return insert(pos,&i,&i+1); }
+    iterator insert( const_iterator pos, size_t n, int const i )
+    { size_t idx = makeRoom(pos,n);
+      std::fill_n(data()+idx,n,i);
+      return data()+idx; }
+    // (only iterators match, so insert(pos,3,7) means three sevens)
+    template <class Itr, class = typename std::iterator_traits<Itr>::iterator_category>
+    iterator insert( const_iterator pos, Itr first, Itr last )
+    { return insertRange(pos,first,last,std::is_convertible<Itr,int const*>()); }
+
+    iterator erase( const_iterator pos ) { return erase(pos,pos+1); }
+    iterator erase( const_iterator first, const_iterator last )
+    { int* dst = data()+(first-data());
+      std::copy(last,cend(),dst);
+      setSize(size()-(last-first));
+      return dst; }
+
+    void swap( ReadPath& that ) noexcept
+    { std::swap(mOffset,that.mOffset);
+      std::swap(mSizeAndMode,that.mSizeAndMode);
+      std::swap(mStorage,that.mStorage); }
+
     bool same_read(ReadPath const& rp){
         return (mOffset==rp.getOffset() and *this==rp);
     }
 
+    // like the std::vector<int> this used to be, comparisons look at the edges and ignore the offset
+    friend bool operator==( ReadPath const& rp1, ReadPath const& rp2 )
+    { return rp1.size() == rp2.size() && std::equal(rp1.begin(),rp1.end(),rp2.begin()); }
+    friend bool operator!=( ReadPath const& rp1, ReadPath const& rp2 )
+    { return !(rp1 == rp2); }
+    friend bool operator<( ReadPath const& rp1, ReadPath const& rp2 )
+    { return std::lexicographical_compare(rp1.begin(),rp1.end(),rp2.begin(),rp2.end()); }
 
 private:
+    static uint32_t const HEAP_BIT = 1u << 31;
+
+    bool onHeap() const { return mSizeAndMode & HEAP_BIT; }
+    void setSize( size_t sz ) { mSizeAndMode = (mSizeAndMode & HEAP_BIT) | sz; }
+    void realloc( size_t cap );
+    size_t makeRoom( const_iterator pos, size_t n );
+
+    template <class Itr>
+    iterator insertRange( const_iterator pos, Itr first, Itr last, std::false_type )
+    { size_t idx = makeRoom(pos,std::distance(first,last));
+      std::copy(first,last,data()+idx);
+      return data()+idx; }
+
+    // a range of our own edges would move, or be freed, as room is made:  copy it out first
+    iterator insertRange( const_iterator pos, int const* first, int const* last, std::true_type )
+    { std::less<int const*> less;
+      if ( first == last || !less(first,cend()) || !less(cbegin(),last) )
+          return insertRange(pos,first,last,std::false_type());
+      ReadPath tmp;
+      tmp.assign(first,last);
+      return insertRange(pos,tmp.cbegin(),tmp.cend(),std::false_type()); }
+
+    struct Heap { int* ptr; uint32_t cap; };
+
     int mOffset;
+    uint32_t mSizeAndMode; // the top bit tells whether the edges are in mInline or on the heap
+    union
+    {
+        int mInline[INLINE_EDGES];
+        Heap mHeap;
+        uint64_t mStorage[2];
+    };
 };
 typedef std::vector<ReadPath> ReadPathVec;
 
+// A read-only ReadPath that points into somebody else's storage.
+class ReadPathRef
+{
+public:
+    typedef int value_type;
+    typedef int const* const_iterator;
+    typedef const_iterator iterator;
+
+    ReadPathRef( int offset, int const* beg, int const* end )
+    : mOffset(offset), mBeg(beg), mEnd(end) {}
+
+    int getOffset() const { return mOffset; }
+    unsigned getFirstSkip() const { return (mOffset < 0 ? 0u : static_cast<unsigned>(mOffset)); }
+
+    size_t size() const { return mEnd-mBeg; }
+    bool empty() const { return mBeg == mEnd; }
+    int operator[]( size_t idx ) const { return mBeg[idx]; }
+    int front() const { return *mBeg; }
+    int back() const { return mEnd[-1]; }
+    int const* data() const { return mBeg; }
+    const_iterator begin() const { return mBeg; }
+    const_iterator end() const { return mEnd; }
+
+    operator ReadPath() const
+    { ReadPath rp(mOffset); rp.assign(mBeg,mEnd); return rp; }
+
+private:
+    int mOffset;
+    int const* mBeg;
+    int const* mEnd;
+};
+
+// The paths of a .paths file, memory-mapped in place.
+// The file holds a header, the prefix sums of the path sizes (one more than there are paths), each path's offset,
+// and then all the edge ids, one path after the other.  Nothing is parsed on opening, so this is the cheap way
+// to look at the paths from code that doesn't change them.  Files in the old per-path format are read into
+// memory instead.
+class MappedReadPathVec
+{
+public:
+    typedef ReadPathRef value_type;
+
+    explicit MappedReadPathVec( std::string const& filename );
+    ~MappedReadPathVec();
+
+    MappedReadPathVec( MappedReadPathVec const& ) = delete;
+    MappedReadPathVec& operator=( MappedReadPathVec const& ) = delete;
+
+    size_t size() const { return mNPaths; }
+    bool empty() const { return !mNPaths; }
+    uint64_t totalEdges() const { return mStarts[mNPaths]; }
+
+    ReadPathRef operator[]( size_t idx ) const
+    { return ReadPathRef(mOffsets[idx],mEdges+mStarts[idx],mEdges+mStarts[idx+1]); }
+
+private:
+    void loadOldFormat( std::string const& filename );
+
+    uint64_t mNPaths;
+    uint64_t const* mStarts;
+    int const* mOffsets;
+    int const* mEdges;
+    void* mMap;
+    size_t mMapLen;
+    std::vector<uint64_t> mOwnedStarts; // for old-format files only
+    std::vector<int> mOwnedOffsets;
+    std::vector<int> mOwnedEdges;
+};
+
+// Shrinks every path's storage to fit (see ReadPath::shrink_to_fit), and the vector itself.  Worth doing after a
+// pass that shortens or renumbers lots of paths.
+void CompactReadPathVec(ReadPathVec &rpv);
+
 void WriteReadPathVec(const ReadPathVec &rpv, const char * filename);
+// reads both the flat format and the old per-path format
+// The paths are copied out of a MappedReadPathVec into ReadPaths, in parallel.  That copy can't be skipped on a
+// --from_step restart:  every step rewrites the paths it's given, so only read-only tools (hbv2gfa) get to use
+// the mapped view directly.
 void LoadReadPathVec(ReadPathVec &rpv, const char * filename);
 
 #endif /* READPATH_H_ */
@@ -18,6 +18,7 @@
 #include "paths/long/Logging.h"
 #include "paths/long/SupportedHyperBasevector.h"
 #include "pairwise_aligners/SmithWatAffine.h"
+#include "pairwise_aligners/SmithWatAffineSIMD.h"
 #include "PrintAlignment.h"
 #include "util/TextTable.h"
 #include "graph/Digraph.h"
@@ -214,7 +215,7 @@ void RestrictedAlign( const basevector& b1, const basevector& b2,
      align a2;
      if (verbose) std::cout << Date( ) << ": alignment starting" << std::endl;
      int nerrors;
-     int err = SmithWatAffineBanded( b1, b2, -offset2, bandwidth2, a2, nerrors );
+     int err = SmithWatAffineBandedSIMD( b1, b2, -offset2, bandwidth2, a2, nerrors );
      if (verbose)
      {    std::cout << Date( ) << ": alignment complete" << std::endl;
           PRINT(err);    }
@@ -251,7 +252,7 @@ void RestrictedAlign( const basevector& b1, const basevector& b2,
                if (verbose)
                {    std::cout << "retrying" << std::endl;
                     PRINT3( err, offset2, bandwidth3 );    }
-               err = SmithWatAffineBanded(b1, b2, -offset2, bandwidth3, a2, nerrors);
+               err = SmithWatAffineBandedSIMD(b1, b2, -offset2, bandwidth3, a2, nerrors);
                int gap = 2 * bandwidth3;
                int min_penalty = gap_open_penalty + (gap-1) * gap_extend_penalty;
                if ( min_penalty > err ) break;    }    }
@@ -260,7 +261,7 @@ void RestrictedAlign( const basevector& b1, const basevector& b2,
 
      if (compare_to_old)
      {    int nerror;
-          int err_old = SmithWatAffineBanded(b1, b2, -offset, bandwidth, a, nerror);
+          int err_old = SmithWatAffineBandedSIMD(b1, b2, -offset, bandwidth, a, nerror);
           if ( !( a2 == a ) ) 
           {    std::cout << "not equal!\n";
                PRINT2( err, err_old );
@@ -1554,7 +1555,7 @@ void EdgesOnRef::CallVariantsGroupedWithProb(int gid, vec<VariantCallGroup> *p_g
                  {    right_ok = True;    }    }
             if ( !left_ok || !right_ok )
             {    alignment al;
-                 SmithWatAffine(branch_base, cell_ref, al, true, true);
+                 SmithWatAffineSIMD(branch_base, cell_ref, al, true, true);
                  a = align(al);    }
 
             if (verbosity >= 2) {
@@ -12,6 +12,7 @@
 #include "Basevector.h"
 #include "CoreTools.h"
 #include "Qualvector.h"
+#include "feudal/Mempool.h"
 #include "kmers/BigKPather.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/LargeKDispatcher.h"
@@ -21,9 +22,11 @@
 #include "paths/long/large/GapToyTools.h"
 #include "paths/long/large/Unsat.h"
 #include "system/SortInPlace.h"
+#include "util/PerfLog.h"
 #include <util/w2rap_timers.h>
 #include <paths/long/LoadCorrectCore.h>
 #include <paths/long/ReadStack.h>
+#include <omp.h>
 
 
 template<int M>
@@ -203,6 +206,26 @@ void FindPidsST(std::vector<int64_t> & pids, const vec<int> &lefts, const vec<in
 
 }
 
+// A rough guess at how much work a blob's local assembly is, used only to order
+// the blobs.  Its pids are drawn from the reads laid out on its lefts and rights,
+// at most pair_sample of them, and the work on them grows with the number of
+// lefts and rights they have to be joined across.
+uint64_t EstimateBlobCost(const vec<int> &lefts, const vec<int> &rights,
+                          const std::vector<std::vector<int>> &layout_pos, const int pair_sample) {
+    uint64_t reads = 0;
+    for (int l = 0; l < lefts.isize(); l++) reads += layout_pos[lefts[l]].size();
+    for (int r = 0; r < rights.isize(); r++) reads += layout_pos[rights[r]].size();
+    return (std::min(reads, (uint64_t) pair_sample) + 1) * (lefts.size() + rights.size());
+}
+
+struct BlobTiming {
+    uint64_t est_cost = 0;
+    size_t pids = 0;
+    int k2_tries = 0;
+    bool solved = false;
+    double seconds = 0;
+};
+
 void CreateLocalReadSet(vecbasevector &gbases,vecqualvector &gquals, PairsManager &gpairs, std::vector<int64_t> & pids,
                         const vecbasevector &bases, VecPQVec const &quals) {
 
@@ -240,10 +263,12 @@ void AssembleGaps2(HyperBasevector &hb, vec<int> &inv2, ReadPathVec &paths2,
                    vecbvec &new_stuff, const Bool CYCLIC_SAVE,
                    const int A2V, const int MAX_PROX_LEFT,
                    const int MAX_PROX_RIGHT, const int MAX_BPATHS, const int pair_sample) {
+    PerfLog::Scope perf_scope("AssembleGaps2");
     // Find clusters of unsatisfied links.
 
     vec<vec<std::pair<int, int> > > xs;
     Unsat(hb, inv2, paths2, xs, work_dir, A2V);
+    PerfLog::lap("Unsat");
 
     //Should print some stats about Unsats here.
 
@@ -282,6 +307,7 @@ void AssembleGaps2(HyperBasevector &hb, vec<int> &inv2, ReadPathVec &paths2,
         EraseIf(LR, lrd);
     }
     std::cout << Date() << ": " << LR.size() << " non-inverted clusters" << std::endl;
+    PerfLog::lap("Clusters");
     // Some setup stuff.
 
     int nedges = hb.EdgeObjectCount();
@@ -303,6 +329,7 @@ void AssembleGaps2(HyperBasevector &hb, vec<int> &inv2, ReadPathVec &paths2,
     hb.ToLeft(to_left), hb.ToRight(to_right);
     vec<vec<basevector> > extras(LR.size());//this is accumulation, generates memory blocks
     vec<HyperBasevector> mhbp(LR.size());//this is accumulation, generates memory blocks
+    PerfLog::lap("LayoutReads");
     std::cout << Date() << ": processing " << LR.size() << " blobs" << std::endl;
     double clockp1 = WallClockTime();
     int nblobs = LR.size();
@@ -311,166 +338,219 @@ void AssembleGaps2(HyperBasevector &hb, vec<int> &inv2, ReadPathVec &paths2,
     //TODO: check local variable usage, should be made minimal!!!
     //Init readstacks, we'll need them!
     readstack::init_LUTs();
-#define BATCH_SIZE 5000
-
-    for (uint64_t bstart = 0; bstart < nblobs; bstart += BATCH_SIZE) {
-        #pragma omp parallel
-        {
-            #pragma omp for schedule(dynamic,1)
-            for (uint64_t bl = bstart; bl < bstart + BATCH_SIZE; ++bl) {
-                if (bl >= nblobs) continue;
-                //First part: create the gbases and gquals. this is locked by memory accesses and very convoluted
-                const vec<int> &lefts = LR[bl].first, &rights = LR[bl].second; //TODO: how big is this? can we copy it?
-
-                //Local readset
-                std::vector<int64_t> pids;
-                vecbasevector gbases;
-                vecqualvector gquals;
-                PairsManager gpairs;
-
-                //Corrected reads
-                VecEFasta corrected;
-                vecbasevector creads;
-                vec<pairing_info> cpartner;
-                vec<int> cid;
-
-                //Local assembly graph
-                HyperBasevector xshb;
-
-                //PART1-------------------------------
-                FindPidsST(pids, lefts, rights, layout_pos, layout_id, layout_or, MAX_PROX_LEFT, MAX_PROX_RIGHT,
-                           pair_sample);
-
-
-                CreateLocalReadSet(gbases, gquals, gpairs, pids, bases, quals);
-                HyperBasevector *mhbp_t = &mhbp[bl];
-
-                //#pragma omp task shared(lefts,rights)
-                //{
-                uint NUM_THREADS = 1;
-                long_heuristics heur("");
-                heur.K2_FLOOR = k2floor_sequence[0];
-                CorrectionSuite(gbases, gquals, gpairs, heur, creads, corrected, cid, cpartner, NUM_THREADS, "",
-                                False);
-
-                for (auto K2_FLOOR_LOCAL: k2floor_sequence) {
-                    SupportedHyperBasevector shb;
-
-                    MakeLocalAssembly2(corrected, lefts, rights, shb, K2_FLOOR_LOCAL, creads, cid, cpartner);
-
-                    if (shb.K() == 0) continue;
-
-                    // Find edges "starts" and "stops" overlapping root edges.
-                    vec<int> starts, stops;
-                    std::vector<basevector> bell;
-                    bell.reserve(shb.EdgeObjectCount() + lefts.isize() + rights.isize());
-                    for (int e = 0; e < shb.EdgeObjectCount(); e++)
-                        bell.push_back(shb.EdgeObject(e));
-                    for (int l = 0; l < lefts.isize(); l++)
-                        bell.push_back(hb.EdgeObject(lefts[l]));
-                    for (int r = 0; r < rights.isize(); r++)
-                        bell.push_back(hb.EdgeObject(rights[r]));
-
-                    BigK::dispatch<MakeStartStopFunctor>(shb.K(), bell, hb, shb, lefts, rights, starts, stops);
-
-                    UniqueSort(starts), UniqueSort(stops);
-
-                    // Reduce shb to those edges between starts and stops.
-
-                    vec<int> yto_left, yto_right;
-                    shb.ToLeft(yto_left), shb.ToRight(yto_right);
-                    vec<int> keep = Intersection(starts, stops);
-                    keep.append(starts);
-                    keep.append(stops);
-                    for (int j1 = 0; j1 < starts.isize(); j1++)
-                        for (int j2 = 0; j2 < stops.isize(); j2++) {
-                            int v = yto_right[starts[j1]], w = yto_left[stops[j2]];
-                            vec<int> b = shb.EdgesSomewhereBetween(v, w);
-                            keep.append(b);
-                        }
-                    UniqueSort(keep);
-                    vec<int> ydels;
-                    for (int e = 0; e < shb.EdgeObjectCount(); e++)
-                        if (!BinMember(keep, e)) ydels.push_back(e);
-                    xshb = shb;
-                    xshb.DeleteEdges(ydels);
-                    xshb.RemoveUnneededVertices();
-                    xshb.RemoveDeadEdgeObjects();
 
+    // Start the most expensive blobs first (longest processing time first), so that a
+    // pathological blob doesn't end up running alone at the end.  Threads just take
+    // the next blob in that order until there are none left.
+    std::vector<BlobTiming> timings(nblobs);
+    std::vector<int> blob_order(nblobs);
+#pragma omp parallel for
+    for (int bl = 0; bl < nblobs; bl++) {
+        timings[bl].est_cost = EstimateBlobCost(LR[bl].first, LR[bl].second, layout_pos, pair_sample);
+        blob_order[bl] = bl;
+    }
+    std::stable_sort(blob_order.begin(), blob_order.end(),
+                     [&timings](int a, int b) { return timings[a].est_cost > timings[b].est_cost; });
+
+#ifdef MEMPOOL_ARENA
+    // Each thread allocates its blobs' reads, corrected reads and local graphs from its own arena, which reuses
+    // what a blob frees while the blob runs, and is rewound for the next one.
+    std::vector<MempoolArena> arenas(omp_get_max_threads());
+#endif
+
+    const uint64_t REPORT_EVERY = 5000;
+    std::atomic_uint_fast64_t processed(0);
+#pragma omp parallel for schedule(dynamic,1)
+    for (int bi = 0; bi < nblobs; ++bi) {
+        const int bl = blob_order[bi];
+#ifdef MEMPOOL_ARENA
+        MempoolArena::Scope arena_scope(arenas[omp_get_thread_num()]);
+#endif
+        double blob_clock = WallClockTime();
+        BlobTiming &timing = timings[bl];
+        //First part: create the gbases and gquals. this is locked by memory accesses and very convoluted
+        const vec<int> &lefts = LR[bl].first, &rights = LR[bl].second; //TODO: how big is this? can we copy it?
+
+        //Local readset
+        std::vector<int64_t> pids;
+        vecbasevector gbases;
+        vecqualvector gquals;
+        PairsManager gpairs;
+
+        //Corrected reads
+        VecEFasta corrected;
+        vecbasevector creads;
+        vec<pairing_info> cpartner;
+        vec<int> cid;
+
+        //Local assembly graph
+        HyperBasevector xshb;
+
+        //PART1-------------------------------
+        FindPidsST(pids, lefts, rights, layout_pos, layout_id, layout_or, MAX_PROX_LEFT, MAX_PROX_RIGHT,
+                   pair_sample);
+
+
+        timing.pids = pids.size();
+        CreateLocalReadSet(gbases, gquals, gpairs, pids, bases, quals);
+        HyperBasevector *mhbp_t = &mhbp[bl];
+
+        //#pragma omp task shared(lefts,rights)
+        //{
+        uint NUM_THREADS = 1;
+        long_heuristics heur("");
+        heur.K2_FLOOR = k2floor_sequence[0];
+        CorrectionSuite(gbases, gquals, gpairs, heur, creads, corrected, cid, cpartner, NUM_THREADS, "",
+                        False);
+
+        for (auto K2_FLOOR_LOCAL: k2floor_sequence) {
+            ++timing.k2_tries;
+            SupportedHyperBasevector shb;
+
+            MakeLocalAssembly2(corrected, lefts, rights, shb, K2_FLOOR_LOCAL, creads, cid, cpartner);
+
+            if (shb.K() == 0) continue;
+
+            // Find edges "starts" and "stops" overlapping root edges.
+            vec<int> starts, stops;
+            std::vector<basevector> bell;
+            bell.reserve(shb.EdgeObjectCount() + lefts.isize() + rights.isize());
+            for (int e = 0; e < shb.EdgeObjectCount(); e++)
+                bell.push_back(shb.EdgeObject(e));
+            for (int l = 0; l < lefts.isize(); l++)
+                bell.push_back(hb.EdgeObject(lefts[l]));
+            for (int r = 0; r < rights.isize(); r++)
+                bell.push_back(hb.EdgeObject(rights[r]));
+
+            BigK::dispatch<MakeStartStopFunctor>(shb.K(), bell, hb, shb, lefts, rights, starts, stops);
+
+            UniqueSort(starts), UniqueSort(stops);
+
+            // Reduce shb to those edges between starts and stops.
+
+            vec<int> yto_left, yto_right;
+            shb.ToLeft(yto_left), shb.ToRight(yto_right);
+            vec<int> keep = Intersection(starts, stops);
+            keep.append(starts);
+            keep.append(stops);
+            for (int j1 = 0; j1 < starts.isize(); j1++)
+                for (int j2 = 0; j2 < stops.isize(); j2++) {
+                    int v = yto_right[starts[j1]], w = yto_left[stops[j2]];
+                    vec<int> b = shb.EdgesSomewhereBetween(v, w);
+                    keep.append(b);
+                }
+            UniqueSort(keep);
+            vec<int> ydels;
+            for (int e = 0; e < shb.EdgeObjectCount(); e++)
+                if (!BinMember(keep, e)) ydels.push_back(e);
+            xshb = shb;
+            xshb.DeleteEdges(ydels);
+            xshb.RemoveUnneededVertices();
+            xshb.RemoveDeadEdgeObjects();
 
-                    if (!CYCLIC_SAVE || xshb.Acyclic()) break;
 
-                }
+            if (!CYCLIC_SAVE || xshb.Acyclic()) break;
+
+        }
 
-                if (xshb.Acyclic() && xshb.N() > 0) {
-
-                    // Make bpaths.  These are all source-sink paths through the
-                    // local graph.
-
-                    vec<basevector> bpaths;
-                    vec<int> sources, sinks;
-                    xshb.Sources(sources), xshb.Sinks(sinks);
-                    vec<int> zto_left, zto_right;
-                    xshb.ToLeft(zto_left), xshb.ToRight(zto_right);
-                    for (int i1 = 0; i1 < sources.isize(); i1++) {
-                        for (int i2 = 0; i2 < sinks.isize(); i2++) {
-                            vec<vec<int>> p;
-                            xshb.EdgePaths(zto_left, zto_right, sources[i1], sinks[i2], p);
-                            for (int l = 0; l < p.isize(); l++) {
-                                basevector b = xshb.EdgeObject(p[l][0]);
-                                for (int m = 1; m < p[l].isize(); m++) {
-                                    b.resize(b.isize() - (xshb.K() - 1));
-                                    b = Cat(b, xshb.EdgeObject(p[l][m]));
-                                }
-                                bpaths.push_back(b);
-                                if (bpaths.isize() > MAX_BPATHS) break;
-                            }
+        if (xshb.Acyclic() && xshb.N() > 0) {
+
+            // Make bpaths.  These are all source-sink paths through the
+            // local graph.
+
+            vec<basevector> bpaths;
+            vec<int> sources, sinks;
+            xshb.Sources(sources), xshb.Sinks(sinks);
+            vec<int> zto_left, zto_right;
+            xshb.ToLeft(zto_left), xshb.ToRight(zto_right);
+            for (int i1 = 0; i1 < sources.isize(); i1++) {
+                for (int i2 = 0; i2 < sinks.isize(); i2++) {
+                    vec<vec<int>> p;
+                    xshb.EdgePaths(zto_left, zto_right, sources[i1], sinks[i2], p);
+                    for (int l = 0; l < p.isize(); l++) {
+                        basevector b = xshb.EdgeObject(p[l][0]);
+                        for (int m = 1; m < p[l].isize(); m++) {
+                            b.resize(b.isize() - (xshb.K() - 1));
+                            b = Cat(b, xshb.EdgeObject(p[l][m]));
                         }
+                        bpaths.push_back(b);
+                        if (bpaths.isize() > MAX_BPATHS) break;
                     }
+                }
+            }
 
-                    if (bpaths.isize() <= MAX_BPATHS) {
-                        // Make more bpaths.
-                        for (int l = 0; l < lefts.isize(); l++) {
-                            Bool ext = False;
-                            for (int m = 0; m < lefts.isize(); m++) {
-                                if (to_right[lefts[m]] == to_left[lefts[l]]) {
-                                    basevector b = hb.EdgeObject(lefts[m]);
-                                    b.resize(b.isize() - (K - 1));
-                                    b = Cat(b, hb.EdgeObject(lefts[l]));
-                                    bpaths.push_back(b);
-                                    ext = True;
-                                }
-                            }
-                            if (!ext) bpaths.push_back(hb.EdgeObject(lefts[l]));
+            if (bpaths.isize() <= MAX_BPATHS) {
+                // Make more bpaths.
+                for (int l = 0; l < lefts.isize(); l++) {
+                    Bool ext = False;
+                    for (int m = 0; m < lefts.isize(); m++) {
+                        if (to_right[lefts[m]] == to_left[lefts[l]]) {
+                            basevector b = hb.EdgeObject(lefts[m]);
+                            b.resize(b.isize() - (K - 1));
+                            b = Cat(b, hb.EdgeObject(lefts[l]));
+                            bpaths.push_back(b);
+                            ext = True;
                         }
-                        for (int r = 0; r < rights.isize(); r++) {
-                            Bool ext = False;
-                            for (int m = 0; m < rights.isize(); m++) {
-                                if (to_left[rights[m]] == to_right[rights[r]]) {
-                                    basevector b = hb.EdgeObject(rights[r]);
-                                    b.resize(b.size() - (K - 1));
-                                    b = Cat(b, hb.EdgeObject(rights[m]));
-                                    bpaths.push_back(b);
-                                    ext = True;
-                                }
-                            }
-                            if (!ext) bpaths.push_back(hb.EdgeObject(rights[r]));
+                    }
+                    if (!ext) bpaths.push_back(hb.EdgeObject(lefts[l]));
+                }
+                for (int r = 0; r < rights.isize(); r++) {
+                    Bool ext = False;
+                    for (int m = 0; m < rights.isize(); m++) {
+                        if (to_left[rights[m]] == to_right[rights[r]]) {
+                            basevector b = hb.EdgeObject(rights[r]);
+                            b.resize(b.size() - (K - 1));
+                            b = Cat(b, hb.EdgeObject(rights[m]));
+                            bpaths.push_back(b);
+                            ext = True;
                         }
-                        // Make the bpaths into a HyperBasevector.
-                        vecbasevector bpathsx;
-                        for (int l = 0; l < bpaths.isize(); l++)
-                            bpathsx.push_back(bpaths[l]);
-                        BasesToGraph(bpathsx, K, *mhbp_t);
-                        ++solved;
                     }
+                    if (!ext) bpaths.push_back(hb.EdgeObject(rights[r]));
                 }
-                //}//---OMP TASK END---
+                // Make the bpaths into a HyperBasevector.
+                vecbasevector bpathsx;
+                for (int l = 0; l < bpaths.isize(); l++)
+                    bpathsx.push_back(bpaths[l]);
+#ifdef MEMPOOL_ARENA
+                MempoolArena::Suspend no_arena; // mhbp outlives the blob
+#endif
+                BasesToGraph(bpathsx, K, *mhbp_t);
+                ++solved;
+                timing.solved = true;
             }
         }
-
-        std::cout << Date() << ": "<< std::min(bstart+BATCH_SIZE,(uint64_t)nblobs) <<" blobs processed, paths found for " << solved << std::endl;
+        //}//---OMP TASK END---
+        timing.seconds = WallClockTime() - blob_clock;
+        uint64_t done = ++processed;
+        if (done % REPORT_EVERY == 0 || done == (uint64_t) nblobs) {
+#pragma omp critical(blob_progress)
+            std::cout << Date() << ": " << done << " blobs processed, paths found for " << solved << std::endl;
+        }
     }
     std::cout << Date() << TimeSince(clockp1) << " spent in local assemblies." << std::endl;
+    PerfLog::lap("LocalAssemblies");
+
+    // One record per blob, so that outliers can be found.
+    if (work_dir != "") {
+        std::ofstream tout((work_dir + "/local_assemblies.timing.tsv").c_str());
+        tout << "blob\tlefts\trights\tpids\test_cost\tk2_tries\tsolved\tseconds" << std::endl;
+        for (int bl = 0; bl < nblobs; bl++) {
+            BlobTiming const &t = timings[bl];
+            tout << bl << "\t" << LR[bl].first.size() << "\t" << LR[bl].second.size() << "\t" << t.pids << "\t"
+                 << t.est_cost << "\t" << t.k2_tries << "\t" << t.solved << "\t" << t.seconds << "\n";
+        }
+    }
+    if (nblobs) {
+        std::vector<int> slowest(blob_order);
+        size_t nshow = std::min(slowest.size(), (size_t) 5);
+        std::partial_sort(slowest.begin(), slowest.begin() + nshow, slowest.end(),
+                          [&timings](int a, int b) { return timings[a].seconds > timings[b].seconds; });
+        std::cout << Date() << ": slowest blobs:";
+        for (size_t i = 0; i < nshow; i++)
+            std::cout << " " << slowest[i] << " (" << timings[slowest[i]].seconds << "s, "
+                      << timings[slowest[i]].pids << " pids)";
+        std::cout << std::endl;
+    }
 
     TIMELOG_REPORT(std::cout,AssembleGaps,AG2_FindPids,AG2_ReadSetCreation,AG2_CorrectionSuite,AG2_LocalAssembly2,AG2_LocalAssemblyEval,AG2_CreateBpaths,AG2_PushBpathsToGraph);
     TIMELOG_REPORT(std::cout,Correct1Pre,C1P_Align,C1P_InitBasesQuals,C1P_Correct,C1P_UpdateBasesQuals);
@@ -478,4 +558,5 @@ void AssembleGaps2(HyperBasevector &hb, vec<int> &inv2, ReadPathVec &paths2,
     // Do the patching.
     const vec<std::pair<int, int> > blobs(LR.size());
     Patch(hb, blobs, mhbp, work_dir, new_stuff);
+    PerfLog::lap("Patch");
 }
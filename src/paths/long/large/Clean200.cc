@@ -16,10 +16,11 @@
 #include "paths/long/ReadPath.h"
 #include "paths/long/large/Clean200.h"
 #include "paths/long/large/GapToyTools.h"
+#include "util/PerfLog.h"
 
 void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const vecbasevector& bases, const VecPQVec& quals, const int verbosity,
-     const int version, const uint min_size )
+     const int version, const uint min_size, const BinnedQualVec* bquals )
 {
      // Start.
 
@@ -42,8 +43,7 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      vec<int> to_right;
      hb.ToRight(to_right);
      HyperBasevectorX hbx(hb);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Look for weak branches.
 
@@ -108,7 +108,7 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
           for ( int64_t i = 0; i < pi.isize( ); i++ )
           {    int64_t id = pi[i].first; 
                int start = pi[i].second;
-               quals[id].unpack(&qv);
+               UnpackQuals( quals, bquals, id, &qv );
                const ReadPath& p = paths[id];
                vec<int> q( N, 0 );
                for ( int pos = 0; pos < depth + hb.K( ) - 1; pos++ )
@@ -153,7 +153,7 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
           for ( int64_t i = 0; i < rpi.isize( ); i++ )
           {    int64_t id = rpi[i].first; 
                int start = rpi[i].second;
-               quals[id].unpack(&qv);
+               UnpackQuals( quals, bquals, id, &qv );
                const ReadPath& p = paths[id];
                vec<int> q( N, 0 );
                for ( int pos = 0; pos < depth + hb.K( ) - 1; pos++ )
@@ -201,17 +201,23 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
 
 void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const vecbasevector& bases, const VecPQVec& quals, const int verbosity,
-     const int version, const uint min_size )
+     const int version, const uint min_size, const BinnedQualVec* bquals )
 {
      // Start.
 
      double clock = WallClockTime( );
+     PerfLog::Scope perf_scope("Clean200x");
 
      // Heuristics.
 
      const int max_exts = 10;
      const int npasses = 2;
 
+     // Index paths.  Cleanup keeps the index current, so it serves both passes.
+
+     EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
+     PerfLog::lap("IndexPaths");
+
      // Run two passes.
 
      for ( int zpass = 1; zpass <= npasses; zpass++ )
@@ -224,8 +230,6 @@ void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      vec<int> to_right;
      hb.ToRight(to_right);
      HyperBasevectorX hbx(hb);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
 
      // Look for weak branches.
 
@@ -292,7 +296,7 @@ void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
           for ( int i = 0; i < pi.isize( ); i++ )
           {    int64_t id = pi[i].first; 
                int start = pi[i].second;
-               quals[id].unpack(&qv);
+               UnpackQuals( quals, bquals, id, &qv );
                const ReadPath& p = paths[id];
                vec<int> q( N, 0 );
                for ( int pos = 0; pos < depth + hb.K( ) - 1; pos++ )
@@ -341,7 +345,7 @@ void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
           for ( int i = 0; i < rpi.isize( ); i++ )
           {    int64_t id = rpi[i].first; 
                int start = rpi[i].second;
-               quals[id].unpack(&qv);
+               UnpackQuals( quals, bquals, id, &qv );
                const ReadPath& p = paths[id];
                vec<int> q( N, 0 );
                for ( int pos = 0; pos < depth + hb.K( ) - 1; pos++ )
@@ -364,6 +368,7 @@ void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
                ReverseSort( scores[j] );
           AnalyzeScores( hbx, inv, v, scores, to_delete, zpass, verbosity,
                version );    }
+     PerfLog::lap("WalkBranches");
 
      // Remove tiny standalone edges
 
@@ -382,9 +387,11 @@ void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      // Clean up.
 
      hb.DeleteEdges(to_delete);
-     Cleanup( hb, inv, paths );    }
+     Cleanup( hb, inv, paths, &paths_index );
+     PerfLog::lap("Cleanup");    }
      TestInvolution( hb, inv );
      Validate( hb, inv, paths );    
+     PerfLog::lap("Validate");
      //std::cout << TimeSince(clock) << " used cleaning large_k-mer graph" << std::endl;
 }
 
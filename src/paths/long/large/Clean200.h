@@ -10,6 +10,7 @@
 #define CLEAN_200_H
 
 #include "CoreTools.h"
+#include "feudal/BinnedQualVec.h"
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
@@ -18,13 +19,16 @@ void AnalyzeScores( const HyperBasevectorX& hb, const vec<int>& inv, const int e
      const vec<vec<int>>& scores, vec<int>& to_delete, const int zpass, 
      const int verbosity, const int version );
 
+// bquals, if given, stands in for quals.
 void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const vecbasevector& bases, const VecPQVec& quals, const int verbosity,
-     const int version, const uint min_size );
+     const int version, const uint min_size,
+     const BinnedQualVec* bquals = nullptr );
 
 void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const vecbasevector& bases, const VecPQVec& quals, const int verbosity,
-     const int version, const uint min_size);
+     const int version, const uint min_size,
+     const BinnedQualVec* bquals = nullptr );
 
 void GetExtensions( const HyperBasevectorX& hb, const int v,
      const int max_exts, vec<vec<int>>& exts, int& depth );
@@ -23,7 +23,9 @@
 #include "math/HoInterval.h"
 #include "paths/long/LoadCorrectCore.h"
 #include "paths/long/large/ExtractReads.h"
+#include "paths/long/large/FastqChunker.h"
 #include "paths/long/large/ReadNameLookup.h"
+#include <thread>
 
 class rs_meta { // read set meta info
      public:
@@ -42,6 +44,39 @@ void GetAmbInt( const vecbitvector& amb, vec< std::pair<int,ho_interval> >& amb_
 void GetCannedReferenceSequences( const String& sample, const String& species,
      const String& work_dir );
 
+// Number of records per fastq batch (per file, when paired).
+
+const size_t FASTQ_BATCH = 200000;
+
+typedef std::pair<FastqChunk const*,size_t> FastqRecordRef;
+
+// Appends the given fastq records, in order, to bases and quals.  Conversion is
+// done in parallel.  Ns are turned into As.
+
+void AppendFastqRecords( std::vector<FastqRecordRef> const& recs, vecbvec& bases,
+     VecPQVec& quals )
+{    size_t const BLOCK = 10000;
+     size_t n = recs.size( ), N0 = bases.size( );
+     bases.resize( N0 + n ), quals.resize( N0 + n );
+     size_t nblocks = ( n + BLOCK - 1 ) / BLOCK;
+     #pragma omp parallel for schedule(dynamic,1)
+     for ( size_t bl = 0; bl < nblocks; bl++ )
+     {    size_t from = bl * BLOCK, to = std::min( n, from + BLOCK );
+          std::vector<qvec> qs( to - from );
+          for ( size_t i = from; i < to; i++ )
+          {    FastqChunk const& c = *recs[i].first;
+               size_t r = recs[i].second;
+               char const* seq = c.line( r, 1 );
+               char const* qual = c.line( r, 3 );
+               size_t len = c.lineLength( r, 1 );
+               bases[N0+i].assign( seq, seq + len, []( char x )
+                    { return Base::char2Val( x == 'N' ? 'A' : x ); } );
+               qvec& q = qs[i-from];
+               q.resize(len);
+               for ( size_t k = 0; k < len; k++ )
+                    q[k] = qual[k] - 33;    }
+          convertCopy( qs.begin( ), qs.end( ), quals.begin( ) + N0 + from );    }    }
+
 void ExtractReads( String reads, const String& work_dir, vec<String>& subsam_names,
      vec<int64_t>& subsam_starts, vecbvec* pReads, VecPQVec* quals )
 {
@@ -374,198 +409,147 @@ void ExtractReads( String reads, const String& work_dir, vec<String>& subsam_nam
                         && infiles_rn[g][j] == infiles_rn[g][j + 1]) {
                     infiles_pairs[g].push(j, j + 1);
                     const String &fn1 = infiles[g][j], &fn2 = infiles[g][j + 1];
-                    String command1 = "cat " + fn1, command2 = "cat " + fn2;
-                    if (fn1.Contains(".gz", -1)) command1 = "z" + command1;
-                    if (fn2.Contains(".gz", -1)) command2 = "z" + command2;
-                    fast_pipe_ifstream in1(command1), in2(command2);
-                    String line1, line2;
                     int64_t total = 0, taken = 0;
                     double frac = infiles_meta[g].frac;
 
-                    // Buffer for quality score compression in batches.
-
-                    const int qbmax = 10000000;
-                    vec<qvec> qualsbuf;
-                    MempoolOwner<char> alloc;
-                    for (int i = 0; i < qbmax; i++)
-                         qualsbuf.emplace_back(alloc);
-                    int qbcount = 0;
+                    // Both files are decompressed on their own threads one
+                    // batch ahead, while the current batch is converted.
 
-                    // Go through the input files.
-
-                    basevector b1, b2;
+                    FastqChunker in1(fn1), in2(fn2);
+                    FastqChunk c1, c2, next1, next2;
+                    size_t r1 = in1.next(c1, FASTQ_BATCH), r2 = in2.next(c2, FASTQ_BATCH);
+                    std::vector<FastqRecordRef> batch;
                     while (1) {
-                         getline(in1, line1), getline(in2, line2);
-                         if (in1.fail() && in2.fail()) break;
-                         if ((in1.fail() && !in2.fail())
-                             || (in2.fail() && !in1.fail())) {
+                         if (r1 != r2 || c1.partialLines() || c2.partialLines()) {
+                              // Both files have a header for record m: the
+                              // shorter one is truncated.  Otherwise one just
+                              // has more records.
+                              size_t m = std::min(r1, r2);
+                              bool h1 = r1 > m || c1.partialLines(), h2 = r2 > m || c2.partialLines();
+                              if (h1 && h2) {
+                                   std::cout << "\nSee incomplete record in " << fn1
+                                   << " or " << fn2 << ".\n" << std::endl;
+                                   Scram(1);
+                              }
                               std::cout << "\nThe files " << fn1 << " and " << fn2
                               << " appear to be paired, yet have "
                               << "different numbers of records.\n" << std::endl;
                               Scram(1);
                          }
-
-                         // Fetch bases.  Turn Ns into As.
-
-                         getline(in1, line1), getline(in2, line2);
-                         if (in1.fail() || in2.fail()) {
-                              std::cout << "\nSee incomplete record in " << fn1
-                              << " or " << fn2 << ".\n" << std::endl;
-                              Scram(1);
-                         }
-                         for (int i = 0; i < line1.isize(); i++)
-                              if (line1[i] == 'N') line1[i] = 'A';
-                         for (int i = 0; i < line2.isize(); i++)
-                              if (line2[i] == 'N') line2[i] = 'A';
-                         b1.SetFromString(line1);
-                         b2.SetFromString(line2);
-
-                         // Skip line.
-
-                         getline(in1, line1), getline(in2, line2);
-                         if (in1.fail() || in2.fail()) {
-                              std::cout << "\nSee incomplete record in " << fn1
-                              << " or " << fn2 << ".\n" << std::endl;
-                              Scram(1);
+                         if (r1 == 0) break;
+                         size_t nr1 = 0, nr2 = 0;
+                         bool more = r1 == FASTQ_BATCH;
+                         std::thread t1, t2;
+                         if (more) {
+                              t1 = std::thread([&]() { nr1 = in1.next(next1, FASTQ_BATCH); });
+                              t2 = std::thread([&]() { nr2 = in2.next(next2, FASTQ_BATCH); });
                          }
 
-                         // Fetch quals.
-
-                         getline(in1, line1), getline(in2, line2);
-                         if (in1.fail() || in2.fail()) {
-                              std::cout << "\nSee incomplete record in " << fn1
-                              << " or " << fn2 << ".\n" << std::endl;
-                              Scram(1);
-                         }
-                         if (b1.size() != line1.size()
-                             || b2.size() != line2.size()) {
-                              std::cout << "\n1: " << b1.size() << " bases "
-                              << ", " << line1.size() << " quals" << std::endl;
-                              std::cout << "2: " << b2.size() << " bases "
-                              << ", " << line2.size() << " quals" << std::endl;
-                              std::cout << "See inconsistent base/quality lengths "
-                              << "in " << fn1 << " or " << fn2 << std::endl;
-                              Scram(1);
+                         // Check lengths and frac, in file order.
+
+                         batch.clear();
+                         for (size_t r = 0; r < r1; r++) {
+                              if (c1.lineLength(r, 1) != c1.lineLength(r, 3)
+                                  || c2.lineLength(r, 1) != c2.lineLength(r, 3)) {
+                                   std::cout << "\n1: " << c1.lineLength(r, 1) << " bases "
+                                   << ", " << c1.lineLength(r, 3) << " quals" << std::endl;
+                                   std::cout << "2: " << c2.lineLength(r, 1) << " bases "
+                                   << ", " << c2.lineLength(r, 3) << " quals" << std::endl;
+                                   std::cout << "See inconsistent base/quality lengths "
+                                   << "in " << fn1 << " or " << fn2 << std::endl;
+                                   Scram(1);
+                              }
+                              if (frac < 1) {
+                                   total++;
+                                   if (double(taken) / double(total) > frac)
+                                        continue;
+                                   taken++;
+                              }
+                              batch.emplace_back(&c1, r), batch.emplace_back(&c2, r);
                          }
-
-                         // Check frac.
-
-                         if (frac < 1) {
-                              total++;
-                              if (double(taken) / double(total) > frac)
-                                   continue;
-                              taken++;
+                         AppendFastqRecords(batch, xbases, xquals);
+                         if (more) {
+                              t1.join(), t2.join();
+                              std::swap(c1, next1), std::swap(c2, next2);
+                              r1 = nr1, r2 = nr2;
                          }
-
-                         // Save.
-
-                         qvec &q1 = qualsbuf[qbcount++];
-                         qvec &q2 = qualsbuf[qbcount++];
-                         q1.resize(line1.size()), q2.resize(line2.size());
-                         if (qbcount == qbmax) {
-                              convertAppendParallel(qualsbuf.begin(),
-                                                    qualsbuf.begin() + qbcount, xquals);
-                              qbcount = 0;
+                         else {
+                              // the short batch was the last one
+                              c1.clear(), c2.clear();
+                              r1 = in1.next(c1, FASTQ_BATCH), r2 = in2.next(c2, FASTQ_BATCH);
                          }
-                         for (int i = 0; i < line1.isize(); i++)
-                              q1[i] = line1[i] - 33;
-                         for (int i = 0; i < line2.isize(); i++)
-                              q2[i] = line2[i] - 33;
-                         xbases.push_back(b1), xbases.push_back(b2);
                     }
-                    convertAppendParallel(qualsbuf.begin(),
-                                          qualsbuf.begin() + qbcount, xquals);
                     j++;
                }
 
                     // Parse unpaired fastq files.
 
                else if (infiles_rn[g][j] != "") {
-                    vecqualvector Q;
                     const String &fn = infiles[g][j];
-                    String command = "cat " + fn;
-                    if (fn.Contains(".gz", -1)) command = "z" + command;
-                    fast_pipe_ifstream in(command);
-                    int64_t total = 0, taken = 0;
+                    int64_t total = 0, taken = 0, nrecords = 0;
                     double frac = infiles_meta[g].frac;
                     Bool skip_next = False;
+                    FastqChunker in(fn);
+                    FastqChunk c, next;
+                    size_t r = in.next(c, FASTQ_BATCH);
+                    std::vector<FastqRecordRef> batch;
                     while (1) {
-                         getline(in, line);
-                         if (in.fail()) break;
-
-                         // Fetch bases.  Turn Ns into As.
-
-                         getline(in, line);
-                         if (in.fail()) {
-                              std::cout << "\nSee incomplete record in " << fn
-                              << ".\n" << std::endl;
-                              Scram(1);
-                         }
-                         for (int i = 0; i < line.isize(); i++)
-                              if (line[i] == 'N') line[i] = 'A';
-                         basevector b(line);
-
-                         // Skip line.
-
-                         getline(in, line);
-                         if (in.fail()) {
-                              std::cout << "\nSee incomplete record in " << fn
-                              << ".\n" << std::endl;
-                              Scram(1);
-                         }
-
-                         // Fetch quals.
-
-                         getline(in, line);
-                         if (in.fail()) {
+                         if (c.partialLines()) {
                               std::cout << "\nSee incomplete record in " << fn
                               << ".\n" << std::endl;
                               Scram(1);
                          }
-                         if (b.size() != line.size()) {
-                              std::cout << "\nSee " << b.size() << " bases "
-                              << ", " << line.size() << " quals" << std::endl;
-                              std::cout << "See inconsistent base/quality lengths "
-                              << "in " << fn << ".\n" << std::endl;
-                              Scram(1);
-                         }
-
-                         // Check frac.
-
-                         if (frac < 1) {
-                              total++;
-                              if (skip_next) {
-                                   skip_next = False;
-                                   continue;
+                         if (r == 0) break;
+                         size_t nr = 0;
+                         bool more = r == FASTQ_BATCH;
+                         std::thread t;
+                         if (more) t = std::thread([&]() { nr = in.next(next, FASTQ_BATCH); });
+                         batch.clear();
+                         for (size_t i = 0; i < r; i++) {
+                              if (c.lineLength(i, 1) != c.lineLength(i, 3)) {
+                                   std::cout << "\nSee " << c.lineLength(i, 1) << " bases "
+                                   << ", " << c.lineLength(i, 3) << " quals" << std::endl;
+                                   std::cout << "See inconsistent base/quality lengths "
+                                   << "in " << fn << ".\n" << std::endl;
+                                   Scram(1);
                               }
-                              if (total % 2 == 1
-                                  && double(taken) / double(total) > frac) {
-                                   skip_next = True;
-                                   continue;
+                              if (frac < 1) {
+                                   total++;
+                                   if (skip_next) {
+                                        skip_next = False;
+                                        continue;
+                                   }
+                                   if (total % 2 == 1
+                                       && double(taken) / double(total) > frac) {
+                                        skip_next = True;
+                                        continue;
+                                   }
+                                   taken++;
                               }
-                              taken++;
+                              batch.emplace_back(&c, i);
+                         }
+                         nrecords += batch.size();
+                         AppendFastqRecords(batch, xbases, xquals);
+                         if (more) {
+                              t.join();
+                              std::swap(c, next);
+                              r = nr;
+                         }
+                         else {
+                              c.clear();
+                              r = in.next(c, FASTQ_BATCH);
                          }
-
-                         // Save.
-
-                         qualvector q(line.size());
-                         for (int i = 0; i < line.isize(); i++)
-                              q[i] = line[i] - 33;
-                         xbases.push_back(b);
-                         Q.push_back(q);
                     }
 
-                    // Check sanity and compress.
+                    // Check sanity.
 
-                    if (infiles_meta[g].type != "long" && Q.size() % 2 != 0) {
+                    if (infiles_meta[g].type != "long" && nrecords % 2 != 0) {
                          std::cout << "\nThe file\n" << fn
                          << "\nshould be interlaced "
                          << "and hence have an even number of entries."
                          << "  It does not.\n" << std::endl;
                          Scram(1);
                     }
-                    convertAppendParallel(
-                            Q.begin(), Q.end(), xquals);
                }
           }
      }
@@ -0,0 +1,61 @@
+//
+// FastqChunker.cc: chunked, in-process decompressing FASTQ reader for ExtractReads.
+//
+
+#include "paths/long/large/FastqChunker.h"
+#include "system/System.h"
+#include <cstring>
+
+FastqChunker::FastqChunker( std::string const& filename )
+: mFilename(filename), mEOF(false)
+{
+    mFile = gzopen(filename.c_str(),"rb");
+    if ( !mFile ) FatalErr("Can't open " << filename << " for reading.");
+    gzbuffer(mFile,BLOCK_SIZE);
+}
+
+FastqChunker::~FastqChunker()
+{
+    gzclose(mFile);
+}
+
+size_t FastqChunker::next( FastqChunk& chunk, size_t maxRecords )
+{
+    chunk.clear();
+    std::vector<char>& text = chunk.mText;
+    text.swap(mLeftover);
+    size_t const maxLines = 4*maxRecords;
+    size_t lineStart = 0, scan = 0;
+    while ( chunk.mLines.size() < maxLines )
+    {
+        char const* nl = scan < text.size() ?
+                (char const*)memchr(&text[scan],'\n',text.size()-scan) : nullptr;
+        if ( nl )
+        {
+            size_t pos = nl-&text[0];
+            chunk.mLines.emplace_back(lineStart,pos-lineStart);
+            lineStart = scan = pos+1;
+            continue;
+        }
+        scan = text.size();
+        if ( mEOF )
+        {   // a last line without a newline still counts
+            if ( lineStart < text.size() )
+            {   chunk.mLines.emplace_back(lineStart,text.size()-lineStart);
+                lineStart = text.size(); }
+            break;
+        }
+        size_t oldSize = text.size();
+        text.resize(oldSize+BLOCK_SIZE);
+        int nRead = gzread(mFile,&text[oldSize],BLOCK_SIZE);
+        if ( nRead < 0 )
+        {   int errNo;
+            FatalErr("Failed to read " << mFilename << ": " << gzerror(mFile,&errNo));
+        }
+        text.resize(oldSize+nRead);
+        if ( !nRead ) mEOF = true;
+    }
+    mLeftover.assign(text.begin()+lineStart,text.end());
+    text.resize(lineStart);
+    return chunk.records();
+}
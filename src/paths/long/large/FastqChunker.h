@@ -0,0 +1,59 @@
+//
+// FastqChunker.h: chunked, in-process decompressing FASTQ reader for ExtractReads.
+//
+
+#ifndef W2RAP_CONTIGGER_FASTQCHUNKER_H
+#define W2RAP_CONTIGGER_FASTQCHUNKER_H
+
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// A batch of whole FASTQ records, as raw text plus the extent of every line.
+class FastqChunk {
+public:
+    size_t records() const { return mLines.size()/4; }
+
+    // lines left over after the last whole record (only at the end of the file)
+    unsigned partialLines() const { return mLines.size()%4; }
+
+    char const* line( size_t record, unsigned which ) const
+    { return &mText[mLines[4*record+which].first]; }
+    size_t lineLength( size_t record, unsigned which ) const
+    { return mLines[4*record+which].second; }
+
+    void clear() { mText.clear(); mLines.clear(); }
+
+private:
+    std::vector<char> mText;
+    std::vector<std::pair<size_t,size_t>> mLines; //start,length
+    friend class FastqChunker;
+};
+
+// Reads a FASTQ file, plain or gzipped (multi-member and BGZF included), in chunks of whole records.
+// Decompression is done in-process by zlib, so a chunker can be driven from its own thread.
+class FastqChunker {
+public:
+    explicit FastqChunker( std::string const& filename );
+    ~FastqChunker();
+
+    FastqChunker( FastqChunker const& ) = delete;
+    FastqChunker& operator=( FastqChunker const& ) = delete;
+
+    // Replaces chunk's content with up to maxRecords records.  Returns the number of whole records read; when it
+    // comes back short the file is finished, and chunk.partialLines() tells if it ended mid-record.
+    size_t next( FastqChunk& chunk, size_t maxRecords );
+
+    std::string const& getFilename() const { return mFilename; }
+
+private:
+    static size_t const BLOCK_SIZE = 4ul << 20;
+
+    std::string mFilename;
+    gzFile mFile;
+    bool mEOF;
+    std::vector<char> mLeftover;
+};
+
+#endif //W2RAP_CONTIGGER_FASTQCHUNKER_H
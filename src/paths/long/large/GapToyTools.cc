@@ -414,7 +414,7 @@ void LogTime( const double clock, const String& what, const String& work_dir )
      else if ( dir != "" )
      {    Echo( TimeSince(clock) + " used " + what, dir + "/clock.log" );    }    }
 
-void CleanupCore( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths )
+void CleanupCore( HyperBasevector& hb, vec<int>& inv, PathEdits& edits )
 {
      vec<Bool> used;
      hb.Used(used);
@@ -432,45 +432,37 @@ void CleanupCore( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths )
      }
      inv = inv2;
 
-     vec<Bool> to_delete( paths.size( ), False );
+     // A path through a dead edge keeps its old number for it.
 
-     #pragma omp parallel for
-     for ( int64_t i = 0; i < (int64_t) paths.size( ); i++ )
-     {
-          std::vector<int>& p = paths[i];
-          for ( int j = 0; j < (int) p.size( ); j++ )
-          {    int n = to_new_id[ p[j] ];
-               if ( n < 0 ) to_delete[i] = True;
-               else p[j] = n;
-          }
-     }
+     if ( inv.size( ) != used.size( ) ) edits.renumber( to_new_id, inv.size( ) );
 
      hb.RemoveDeadEdgeObjects( );
 
      hb.RemoveEdgelessVertices( );
+}
 
-     
-     }
+void CleanupCore( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
+     EdgePathIndex* paths_index )
+{    PathEdits edits;
+     CleanupCore( hb, inv, edits );
+     edits.apply( paths, paths_index );    }
 
-void Cleanup( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths )
-{    
-     //XXX: truncates paths, which should be already done by the graph-modifying functions
-    {
-        vec<Bool> used;
-        hb.Used(used);
-        for (int64_t i = 0; i < (int64_t) paths.size(); i++) {
-            for (int64_t j = 0; j < (int64_t) paths[i].size(); j++) {
-                if (paths[i][j] < 0 || paths[i][j] >= hb.EdgeObjectCount() || !used[paths[i][j]]) {
-                    paths[i].resize(j);
-                    break;
-                }
-            }
-        }
-    }
-    RemoveUnneededVertices2( hb, inv, paths );
-    CleanupCore( hb, inv, paths );
+void Cleanup( HyperBasevector& hb, vec<int>& inv, PathEdits& edits )
+{
+     // truncate the paths at deleted edges, then tidy the graph
+     vec<Bool> used;
+     hb.Used(used);
+     edits.truncate(used);
+     RemoveUnneededVertices2( hb, inv, edits );
+     CleanupCore( hb, inv, edits );
 }
 
+void Cleanup( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
+     EdgePathIndex* paths_index )
+{    PathEdits edits;
+     Cleanup( hb, inv, edits );
+     edits.apply( paths, paths_index );    }
+
 void CleanupLoops( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths )
 {    RemoveUnneededVerticesLoopsOnly( hb, inv, paths );
      CleanupCore( hb, inv, paths );    }
@@ -12,9 +12,12 @@
 #include "Bitvector.h"
 #include "CoreTools.h"
 #include "Intvector.h"
+#include "feudal/BinnedQualVec.h"
 #include "feudal/ObjectManager.h"
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
+#include "paths/long/EdgePathIndex.h"
+#include "paths/long/large/PathEdits.h"
 #include "paths/long/ReadPath.h"
 #include "paths/long/SupportedHyperBasevector.h"
 #include "paths/long/large/GapToyTools2.h"
@@ -132,8 +135,10 @@ void ExtendTerminalEdges( const HyperBasevector& hb,
 void SelectSpecials( const HyperBasevector& hb, vecbasevector& bases,
      VecPQVec const& quals, const ReadPathVec& paths2, const String& work_dir );
 
+// PathVec is ReadPathVec or MappedReadPathVec.
+template <class PathVec>
 void LayoutReads( const HyperBasevector& hb, const vec<int>& inv, 
-     const vecbasevector& bases, const ReadPathVec& paths, 
+     const vecbasevector& bases, const PathVec& paths, 
      std::vector<std::vector<int>>& layout_pos, std::vector<std::vector<int64_t>>& layout_id,
      std::vector<std::vector<bool>>& layout_or );
 
@@ -145,9 +150,10 @@ void SortBlobs( const HyperBasevector& hb,
 void RemoveHangs( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const int max_del );
 
+// bquals, if given, stands in for quals, which may then be empty.
 void Degloop( const int mode, HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const vecbasevector& bases, const VecPQVec& quals, const double min_dist,
-     const int verbosity = 0 );
+     const int verbosity = 0, const BinnedQualVec* bquals = nullptr );
 
 // DegloopCore: H = HyperBasevector or HyperBasevectorX.
 
@@ -155,15 +161,25 @@ template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv,
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
      const VecULongVec& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
-     const vec<int>* ids = NULL );
+     const vec<int>* ids = NULL, const BinnedQualVec* bquals = nullptr );
 
 void Patch( HyperBasevector& hb, const vec< std::pair<int,int> >& blobs, 
      vec<HyperBasevector>& mhbp, const String& work_dir,
      vecbvec& new_stuff );
 
-void CleanupCore( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths );
+// Given paths_index, CleanupCore, Cleanup and RemoveUnneededVertices2 keep it in step with the paths.
+// The versions that take a PathEdits instead change only the graph, and queue the matching path
+// rewrites, so that several clean-ups in a row cost one pass over the paths.
 
-void Cleanup( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths );
+void CleanupCore( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
+     EdgePathIndex* paths_index = NULL );
+
+void CleanupCore( HyperBasevector& hb, vec<int>& inv, PathEdits& edits );
+
+void Cleanup( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
+     EdgePathIndex* paths_index = NULL );
+
+void Cleanup( HyperBasevector& hb, vec<int>& inv, PathEdits& edits );
 
 void CleanupLoops( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths );
 
@@ -176,7 +192,10 @@ void RemoveUnneededVerticesLoopsOnly( HyperBasevector& hb, vec<int>& inv,
      ReadPathVec& paths );
 
 void RemoveUnneededVertices2( HyperBasevector& hb, vec<int>& inv,
-     ReadPathVec& paths, Bool debug = false );
+     ReadPathVec& paths, EdgePathIndex* paths_index = NULL, Bool debug = false );
+
+void RemoveUnneededVertices2( HyperBasevector& hb, vec<int>& inv,
+     PathEdits& edits, Bool debug = false );
 
 void RemoveSmallComponents3( HyperBasevector& hb, 
      const Bool remove_small_cycles = False );
@@ -253,9 +272,21 @@ public:
     // returns true if at any point (qsum of alt path) < (qsum of orig path)
     bool log_read(basevector const&read, qualvector const&qual, ReadPath const&rp, bool bVerbose=false);
 
+    // log_read on every read, in parallel: the supports are collected per chunk of reads, and handed to the
+    // bubbles chunk by chunk, so the result is exactly that of calling log_read on the reads one by one
+    // returns the number of reads for which log_read would have returned true
+    // bquals, if given, stands in for quals
+    size_t log_reads(vecbasevector const&bases, VecPQVec const&quals, ReadPathVec const&paths
+                    , BinnedQualVec const*bquals=nullptr);
+
+    // the supports log_read would add for a read, as (edge,support) in the order it would add them
+    // returns what log_read would
+    bool read_supports(basevector const&read, qualvector const&qual, ReadPath const&rp
+                      , std::vector< std::pair<int,bubble_data_t::support_t> >& supports)const;
+
     //do a gap-free alignment of the read against the graph according to rp
     //returns the sum of read-quality-score at the position the sequence mismatches
-    int getQ(basevector const&read, qualvector const&qual, ReadPath const&rp, const qualvector::value_type min_q=4);
+    int getQ(basevector const&read, qualvector const&qual, ReadPath const&rp, const qualvector::value_type min_q=4)const;
 
     // assign weight to the bubble-branch of an edge
     void addWeight(int edge,bubble_data_t::support_t const&weight){
@@ -285,7 +316,8 @@ private:
 std::ostream& operator<<(std::ostream&os, bubble_logger const& in);
 std::ostream& operator<<(std::ostream& os, bubble_logger::bubble_data_t const&in);
 void PopBubbles( HyperBasevector& hb , const vec<int>& inv2
-               , const vecbasevector& bases, const VecPQVec& quals, const ReadPathVec& paths2);
+               , const vecbasevector& bases, const VecPQVec& quals, const ReadPathVec& paths2
+               , const BinnedQualVec* bquals=nullptr);
 void PrintBubbles( std::ostream& os, HyperBasevector& hb , const vec<int>& inv2
                , const vecbasevector & bases, const VecPQVec& quals, const ReadPathVec& paths2);
 
@@ -346,7 +378,8 @@ void AlignToGenomePerf( const HyperBasevector& hb, const vecbasevector& genome,
      vec<perf_place>& places );
 
 void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
-     ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals );
+     ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
+     const BinnedQualVec* bquals = nullptr );
 
 void Tamp( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const int max_shift );
@@ -471,7 +471,7 @@ void PlaceMore( const HyperBasevector& hb, const vecbasevector& bases,
                {    IntVec x;
                     x.push_back(e);
                     ReadPath& p = paths2[id];
-                    (IntVec&) p = x;
+                    p.assign( x.begin( ), x.end( ) );
                     p.setOffset(offset);
 		    placed.push_back(id);
                     /*
@@ -537,7 +537,7 @@ void ExtraPaths( const HyperBasevector& hb, const vecbasevector& bases,
           {    int edge = locs[l].first, pos = locs[l].second;
                IntVec v;
                v.push_back(edge);
-               (IntVec&) paths2[id] = v;
+               paths2[id].assign( v.begin( ), v.end( ) );
                paths2[id].setOffset(pos);
                int64_t pid = id/2;
                // PRINT5( pid, id, edge, pos, x.ToString( ) );    
@@ -547,8 +547,9 @@ void ExtraPaths( const HyperBasevector& hb, const vecbasevector& bases,
      std::cout << Date( ) << ": placed partners for " << count << " pairs, "
           << PERCENT_RATIO( 3, count, npids ) << " of total" << std::endl;    }
 
+template <class PathVec>
 void LayoutReads(const HyperBasevector &hb, const vec<int> &inv,
-                 const vecbasevector &bases, const ReadPathVec &paths,
+                 const vecbasevector &bases, const PathVec &paths,
                  std::vector<std::vector<int>> &layout_pos, std::vector<std::vector<int64_t>> &layout_id,
                  std::vector<std::vector<bool>> &layout_or) {
      int nedges = hb.EdgeObjectCount();
@@ -587,6 +588,15 @@ void LayoutReads(const HyperBasevector &hb, const vec<int> &inv,
           SortSync(layout_pos[e], layout_or[e], layout_id[e]);
 }
 
+template void LayoutReads(const HyperBasevector &hb, const vec<int> &inv,
+                          const vecbasevector &bases, const ReadPathVec &paths,
+                          std::vector<std::vector<int>> &layout_pos, std::vector<std::vector<int64_t>> &layout_id,
+                          std::vector<std::vector<bool>> &layout_or);
+template void LayoutReads(const HyperBasevector &hb, const vec<int> &inv,
+                          const vecbasevector &bases, const MappedReadPathVec &paths,
+                          std::vector<std::vector<int>> &layout_pos, std::vector<std::vector<int64_t>> &layout_id,
+                          std::vector<std::vector<bool>> &layout_or);
+
 void SortBlobs( const HyperBasevector& hb,
      const vec< triple< std::pair<int,int>, triple<int,vec<int>,vec<int>>, vec<int> > >&
           blobber,
@@ -713,8 +723,7 @@ void Patch(HyperBasevector &hb, const vec<std::pair<int, int> > &blobs,
 
      vec<int> to_right;
      hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Look for weak branches.
 
@@ -915,7 +924,7 @@ template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv,
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
      const VecULongVec& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
-     const vec<int>* ids )
+     const vec<int>* ids, const BinnedQualVec* bquals )
 {
      int K = hb.K( );
      int n = ( pass == 1 ? hb.From(v).size( ) : hb.To(v).size( ) );
@@ -959,7 +968,8 @@ template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv,
                     {    int64_t id = paths_index[x][j];
                          const ReadPath& p = paths[id];
                          const basevector& b = bases[id];
-                         const qualvector& q = qvItr[id];
+                         qvec q;
+                         if ( !bquals ) q = qvItr[id];
 
                          // Set homopolymer base quality to min across it.
 
@@ -1007,13 +1017,14 @@ template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv,
                               {    continue;    }
                               */
 
+                              int qual = ( bquals ? (*bquals)( id, rpos ) : q[rpos] );
                               if ( verbosity >= 3 )
                               {    ForceAssert( ids != NULL );
                                    std::cout << "read " << (*ids)[id]
                                         << " supports edge " << e << " with quality "
-                                        << int(q[rpos]) << std::endl;    }
+                                        << qual << std::endl;    }
 
-                              qs[i].push_back( q[rpos] );    }    }    }
+                              qs[i].push_back(qual);    }    }    }
                ReverseSort( qs[i] );    }
 
           // Assess quality score distribution difference.
@@ -1081,13 +1092,13 @@ template void DegloopCore( const int mode, HyperBasevector& hb, vec<int>& inv,
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
      const VecULongVec& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
-     const vec<int>* ids );
+     const vec<int>* ids, const BinnedQualVec* bquals );
 
 template void DegloopCore( const int mode, HyperBasevectorX& hb, vec<int>& inv, 
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
      const VecULongVec& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
-     const vec<int>* ids );
+     const vec<int>* ids, const BinnedQualVec* bquals );
 
 // Go through branch points.
 // Score branches by computing quality score at Kth base.
@@ -1096,7 +1107,7 @@ template void DegloopCore( const int mode, HyperBasevectorX& hb, vec<int>& inv,
 
 void Degloop( const int mode, HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      const vecbasevector& bases, const VecPQVec& quals, const double min_dist,
-     const int verbosity )
+     const int verbosity, const BinnedQualVec* bquals )
 {    std::cout << Date( ) << ": start degloop" << std::endl;
      std::cout << Date( ) << ": creating path index" << std::endl;
      VecULongVec paths_index;
@@ -1111,7 +1122,7 @@ void Degloop( const int mode, HyperBasevector& hb, vec<int>& inv, ReadPathVec& p
      for ( int v = 0; v < hb.N( ); v++ )
      {    for ( int pass = 1; pass <= 2; pass++ )
           {    DegloopCore( mode, hb, inv, paths, bases, quals, paths_index, 
-                    v, pass, min_dist, EDELS, verbosity );    }    }
+                    v, pass, min_dist, EDELS, verbosity, NULL, bquals );    }    }
      int ed = EDELS.size( );
      for ( int i = 0; i < ed; i++ )
           EDELS.push_back( inv[ EDELS[i] ] );
@@ -84,7 +84,7 @@ void FixPath( ReadPath& p, const vec< triple<int,int,int> >& merges,
      }    // while(1)
 }
 
-void RemoveUnneededVertices2( HyperBasevector& hbv, vec<int>& inv, ReadPathVec& paths, Bool debug )
+void RemoveUnneededVertices2( HyperBasevector& hbv, vec<int>& inv, PathEdits& edits, Bool debug )
 {
     static int debug_serial = 0;
     ++debug_serial;
@@ -268,20 +268,8 @@ void RemoveUnneededVertices2( HyperBasevector& hbv, vec<int>& inv, ReadPathVec&
     //std::cout << "[GapToyTools3.cc]          RemoveUnneededVertices2 updating paths with new edge numbers: " << ctime(&rawtime) << std::endl;
     // update the read paths for the newly created edges
     //std::cout << "[GapToyTools3.cc] Begining RemoveUnneededVertices2 Updating paths to new edge numbers"<< std::endl;
-#pragma omp parallel for
-    for ( int64_t i = 0; i < paths.size(); ++i ) {
-        auto& path = paths[i];
-        if ( path.size() ) {
-            std::vector<int> oldPath = path;
-            path.clear();
-            path.setOffset( path.getOffset() + offsets[oldPath[0]]);
-            //XXX: is this the same scenario?
-            path.push_back( edge_renumber0[ oldPath[0] ] );
-            for ( auto itr = oldPath.begin()+1; itr != oldPath.end(); ++itr )
-                if ( edge_renumber0[ *itr ] != path.back() )
-                    path.push_back( edge_renumber0[ *itr ] );
-        }
-    }
+    // queued even when nothing merged:  the rewrite also squeezes out repeated edges
+    edits.merge( edge_renumber0, offsets, hbv.EdgeObjectCount() );
     //std::cout << "[GapToyTools3.cc] Begining RemoveUnneededVertices2 Finished!"<< std::endl;
     //XXX Optimization END
     //XXX: this is PROPERTY VALIDATION IN PRODUCTION! AWESOME!
@@ -293,6 +281,14 @@ void RemoveUnneededVertices2( HyperBasevector& hbv, vec<int>& inv, ReadPathVec&
     //std::cout << "[GapToyTools3.cc] Remove unneeded vertices toright finishing: " << to_right.size() << std::endl;
 }
 
+void RemoveUnneededVertices2( HyperBasevector& hbv, vec<int>& inv, ReadPathVec& paths,
+                              EdgePathIndex* paths_index, Bool debug )
+{
+    PathEdits edits;
+    RemoveUnneededVertices2( hbv, inv, edits, debug );
+    edits.apply( paths, paths_index );
+}
+
 void RemoveUnneededVerticesLoopsOnly( HyperBasevector& hb, vec<int>& inv,
      ReadPathVec& paths )
 {    double clock1 = WallClockTime( );
@@ -364,8 +360,7 @@ void RemoveUnneededVerticesGeneralizedLoops( HyperBasevector& hb, vec<int>& inv,
 {    double clock1 = WallClockTime( );
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
      vec<Bool> processed( hb.N( ), False );
      vec<int> dels;
      for ( int i = 0; i < hb.N( ); i++ )
@@ -732,8 +727,7 @@ void UnwindThreeEdgePlasmids(HyperBasevector& hb, vec<int>& inv, ReadPathVec& pa
 
      // Set up indices.
 
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
      vec<int> to_right;
      hb.ToRight(to_right);
 
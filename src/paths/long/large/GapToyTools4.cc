@@ -10,6 +10,7 @@
 // MakeDepend: cflags OMP_FLAGS
 
 #include <atomic>
+#include <deque>
 
 #include "CoreTools.h"
 #include "ParallelVecUtilities.h"
@@ -42,91 +43,143 @@
 
 namespace {
 
-// GenerateLookups - generate alignments between two sets of edges
+// Minimizers of edge sequences: of each window of w consecutive k-mers, the
+// one of least hash (the leftmost, on ties).  They're what MapEdgesOnto uses to
+// find an edge inside the edges of another graph, sampling about 2/(w+1) of
+// the positions instead of indexing every K-mer.  Any K-mer contains a whole
+// window, so it shares that window's minimizer with every copy of itself.
+
+struct MinimizerScheme
+{    explicit MinimizerScheme( const int K )
+          : k( Min( K, 24 ) ), w( Max( 1, Min( 40, K - k + 1 ) ) ) { }
+     int k, w;    };
+
+inline uint64_t MinimizerHash( uint64_t x )
+{    x ^= x >> 33;
+     x *= 0xff51afd7ed558ccdul;
+     x ^= x >> 33;
+     x *= 0xc4ceb9fe1a85ec53ul;
+     x ^= x >> 33;
+     return x;    }
+
+// The (hash, position) of the minimizers of b, each once, in order, from the
+// windows that start in [0,stop).
+
+void Minimizers( const basevector& b, const MinimizerScheme& ms, const int stop,
+     vec< std::pair<uint64_t,int> >& mins )
+{    mins.clear( );
+     const int nwin = Min( stop, b.isize( ) - ms.k - ms.w + 2 );
+     if ( nwin <= 0 ) return;
+     const int nkmers = nwin + ms.w - 1;
+     const uint64_t mask = ( 1ul << 2*ms.k ) - 1;
+     vec<uint64_t> h(nkmers);
+     uint64_t x = 0;
+     for ( int i = 0; i < nkmers + ms.k - 1; i++ )
+     {    x = ( ( x << 2 ) | b[i] ) & mask;
+          if ( i >= ms.k - 1 ) h[ i - ms.k + 1 ] = MinimizerHash(x);    }
+     std::deque<int> q;
+     for ( int i = 0; i < nkmers; i++ )
+     {    while ( !q.empty( ) && h[ q.back( ) ] > h[i] ) q.pop_back( );
+          q.push_back(i);
+          if ( q.front( ) <= i - ms.w ) q.pop_front( );
+          if ( i >= ms.w - 1 && ( mins.empty( ) || mins.back( ).second != q.front( ) ) )
+               mins.push( h[ q.front( ) ], q.front( ) );    }    }
+
+struct EdgeMinimizer
+{    uint64_t hash;
+     int edge, pos;
+     friend bool operator<( const EdgeMinimizer& m1, const EdgeMinimizer& m2 )
+     {    if ( m1.hash != m2.hash ) return m1.hash < m2.hash;
+          if ( m1.edge != m2.edge ) return m1.edge < m2.edge;
+          return m1.pos < m2.pos;    }    };
+
+// MapEdgesOnto - find the edges of an old graph in a new one
 //
-// given a vecbasevector trans[] where the first hb.EdgeObjectCount() entries are
-// either edges from hb or zero-size and the remaining entries are edges from
-// hb3 (or zero-size).  Generate 200-mer based alignments (offset-only) between
-// hb edges and hb3 edges.  These go into X.
-//
-// on exit, X is vec of triple( id1, offset, id2 )
-//
-void GenerateLookups( vecbasevector const& trans, HyperBasevector const& hb,
-          vec<triple<int,int,int>>& X, Bool debug = False )
-{
-     const int K = 200;
-     ForceAssertEq(K, hb.K());
-     int n_id1 = hb.EdgeObjectCount();
-     vec< triple<kmer<K>,int,int> > kmers_plus;
-     MakeKmerLookup0( trans, kmers_plus );
-#ifdef __linux
-     std::cout << "after kmers_plus creation, peak mem usage = "
-          << PeakMemUsageGBString( ) << std::endl;
-#endif
-     for ( int64_t i = 0; i < kmers_plus.jsize( ); i++ )
-     {    int64_t j;
-          for ( j = i + 1; j < kmers_plus.jsize( ); j++ )
-               if ( kmers_plus[j].first != kmers_plus[i].first ) break;
-          for ( int64_t k1 = i; k1 < j; k1++ )
-          for ( int64_t k2 = i; k2 < j; k2++ )
-          {    int id1 = kmers_plus[k1].second;
-               int id2 = kmers_plus[k2].second - n_id1;
-               // do we map an hb edge to an hb3 edge?
-               if ( id1 >= n_id1 || id2 < 0 ) continue;
-               int offset = kmers_plus[k1].third - kmers_plus[k2].third;
-               X.push( id1, offset, id2 );
-          }
-          i = j - 1;    }
-     ParallelUniqueSort(X);
-     if ( debug ) {
-          for ( auto const& x : X ) {
-               int id1 = x.first; int offset = x.second; int id2 = x.third;
-               PRINT3(id1,offset,id2);
-          }
-     }
-}
+// The new graph hb3 must have been built from (at least) the sequences of the
+// old edges, with the same K, so that each old edge of length >= K is spelled by
+// a path in hb3.  For each old edge e, this finds that path, to3[e], and the
+// start of e on its first edge, left3[e]; an edge shorter than K maps nowhere.
+// The first K-mer of e is found through a minimizer index of hb3's edges, and
+// confirmed by comparing sequence; the path then follows from hb3's vertices,
+// since successive edges each start where the last one's final K-1 bases do,
+// and each step is again checked against the sequence of e.
+
+void MapEdgesOnto( const vecbasevector& old_edges, const HyperBasevector& hb3,
+     vec<vec<int>>& to3, vec<int>& left3 )
+{    const int K = hb3.K( );
+     const MinimizerScheme ms(K);
+     const int n3 = hb3.EdgeObjectCount( );
+
+     vec<int64_t> start( n3 + 1, 0 );
+     vec< vec<EdgeMinimizer> > per_edge(n3);
+     #pragma omp parallel
+     {    vec< std::pair<uint64_t,int> > mins;
+          #pragma omp for schedule(dynamic, 1000)
+          for ( int e = 0; e < n3; e++ )
+          {    Minimizers( hb3.EdgeObject(e), ms, hb3.EdgeObject(e).isize( ), mins );
+               per_edge[e].reserve( mins.size( ) );
+               for ( auto const& m : mins )
+                    per_edge[e].push_back( EdgeMinimizer{ m.first, e, m.second } );
+               start[e+1] = mins.size( );    }    }
+     for ( int e = 0; e < n3; e++ )
+          start[e+1] += start[e];
+     vec<EdgeMinimizer> index( start[n3] );
+     #pragma omp parallel for schedule(dynamic, 1000)
+     for ( int e = 0; e < n3; e++ )
+     {    std::copy( per_edge[e].begin( ), per_edge[e].end( ), index.begin( ) + start[e] );
+          vec<EdgeMinimizer>( ).swap( per_edge[e] );    }
+     ParallelSort(index);
 
-
-void GenerateLookupsNaif( vecbasevector const& trans, HyperBasevector const& hb,
-          vec<triple<int,int,int>>& X, Bool debug = False )
-{
-     const int K = 200;
-     typedef Kmer248 Kmer_t;    // must be >= K
-     ForceAssertEq(K, hb.K());
-     int n_id1 = hb.EdgeObjectCount();
-
-     size_t NUM_THREADS = configNumThreads(0);
-
-     KmerAligns p;
-     KernelAllKmerAligns<Kmer_t> kpa( trans, n_id1, K, &p,
-               true /* ignore palindromes */, true /* ignore relative RC */ );
-     naif_kmerize(&kpa, NUM_THREADS, debug);
-
-     // push and pop to avoid double-memory or make naif_kmer use the same
-     // type
-     // -- could just make Unique() also more flexible
-     X.clear();
-     p.ReverseMe();
-     while ( p.size() ) {
-          if ( X.size() == 0 ||
-                    X.back().first != p.back().first ||
-                         X.back().second != p.back().second ||
-                              X.back().third  != p.back().third ) {
-               X.push_back(p.back());
-          }
-          p.pop_back();
-     }
-
-
-#if 0
-     if ( debug ) std::cout << "BEFORE X.size()=" << p.size() << std::endl;
-     Unique(p);
-     if ( debug ) std::cout << "AFTER X.size()=" << p.size() << std::endl;
-
-     X.clear_and_resize(p.size());
-     for ( size_t i = 0; i < p.size(); ++i ) X[i] = p[i];
-#endif
-}
+     vec<int> to_right;
+     hb3.ToRight(to_right);
+     const int64_t nold = old_edges.size( );
+     to3.clear_and_resize(nold);
+     left3.assign( nold, 0 );
+     #pragma omp parallel
+     {    vec< std::pair<uint64_t,int> > mins;
+          #pragma omp for schedule(dynamic, 1000)
+          for ( int64_t i = 0; i < nold; i++ )
+          {    const basevector& x = old_edges[i];
+               if ( x.isize( ) < K ) continue;
+
+               // Place the first K-mer.
+
+               Minimizers( x, ms, 1, mins );
+               ForceAssertEq( mins.size( ), 1u );
+               const int p = mins[0].second;
+               EdgeMinimizer lo{ mins[0].first, 0, 0 };
+               int e3 = -1, offset = 0;
+               for ( auto itr = std::lower_bound( index.begin( ), index.end( ), lo );
+                    itr != index.end( ) && itr->hash == lo.hash; ++itr )
+               {    const basevector& y = hb3.EdgeObject( itr->edge );
+                    int o = itr->pos - p;
+                    if ( o < 0 || o + K > y.isize( ) ) continue;
+                    if ( std::equal( x.begin( ), x.begin(K), y.begin(o) ) )
+                    {    e3 = itr->edge, offset = o;
+                         break;    }    }
+               if ( e3 < 0 )
+                    FatalErr( "Edge " << i << " has no counterpart in the new graph." );
+
+               // Follow it through the graph.
+
+               left3[i] = offset;
+               to3[i].push_back(e3);
+               int pos = 0, len = Min( x.isize( ), hb3.EdgeLengthBases(e3) - offset );
+               ForceAssert( std::equal( x.begin( ), x.begin(len), hb3.EdgeObject(e3).begin(offset) ) );
+               while ( pos + len < x.isize( ) )
+               {    pos += len - (K-1);
+                    const int v = to_right[e3];
+                    e3 = -1;
+                    for ( int j = 0; j < hb3.From(v).isize( ); j++ )
+                    {    int f = hb3.EdgeObjectIndexByIndexFrom( v, j );
+                         if ( hb3.EdgeObject(f)[K-1] == x[ pos + K - 1 ] )
+                         {    e3 = f;
+                              break;    }    }
+                    ForceAssertGe( e3, 0 );
+                    len = Min( x.isize( ) - pos, hb3.EdgeLengthBases(e3) );
+                    ForceAssert( std::equal( x.begin(pos), x.begin(pos+len),
+                         hb3.EdgeObject(e3).begin( ) ) );
+                    to3[i].push_back(e3);    }    }    }    }
 
 }; // end of anonymous namespace
 
@@ -223,7 +276,6 @@ void AddNewStuff( vecbvec& new_stuff, HyperBasevector& hb, vec<int>& inv2,
      vec<vec<int>> to3( hb.EdgeObjectCount( ) );
      vec<int> left3( hb.EdgeObjectCount( ) );
      {
-          ReadPathVec allx_paths;
           vecbasevector allx;
           BuildAll( allx, hb, new_stuff.size( ) );
           // add in "new_stuff" to allx
@@ -235,22 +287,20 @@ void AddNewStuff( vecbvec& new_stuff, HyperBasevector& hb, vec<int>& inv2,
                << std::endl;
           double clock2 = WallClockTime( );
           const int coverage = 4;
-          buildBigKHBVFromReads( K, allx, coverage, &hb3, &allx_paths);
+          buildBigKHBVFromReads( K, allx, coverage, &hb3 );
           std::cout << Date( ) << ": back from buildBigKHBVFromReads" << std::endl;
 
-          // build to3 and left3 from allx_paths
+          // build to3 and left3 by finding the old edges in hb3
 
-          for ( int64_t i = 0; i < hb.EdgeObjectCount(); ++i ) 
-          {    for ( auto const& p : allx_paths[i] )
-                    to3[i].push_back( p );
-               left3[i] = allx_paths[i].getFirstSkip();    }
+          allx.resize( hb.EdgeObjectCount( ) );
+          MapEdgesOnto( allx, hb3, to3, left3 );
 
           std::cout << TimeSince(clock2) << " used in new stuff 2 test" << std::endl;
 
           if ( trace_edges.size() ) 
           {    std::cout << "BigKHBV EDGE-PATHS:" << std::endl;
                for ( auto const& edge : trace_edges )
-                    std::cout << edge << ": " << allx_paths[edge] << std::endl;    }    }
+                    std::cout << edge << ": " << to3[edge] << std::endl;    }    }
 #ifdef __linux
      std::cout << "peak mem usage = " << PeakMemUsageGBString( ) << std::endl;
 #endif
@@ -465,6 +515,14 @@ void bubble_logger::bubble_data_t::addSupport(size_t branch, bubble_logger::bubb
 // and collect the result
 // returns true if at any point (qsum of alt path) < (qsum of orig path)
 bool bubble_logger::log_read(basevector const&read, qualvector const&qual, ReadPath const&rp, bool bVerbose){
+    std::vector< std::pair<int,bubble_data_t::support_t> > supports;
+    const bool bErr = read_supports(read,qual,rp,supports);
+    for(const auto& entry: supports){ this->addWeight(entry.first,entry.second); }
+    return bErr;
+}
+
+bool bubble_logger::read_supports(basevector const&read, qualvector const&qual, ReadPath const&rp
+                                 , std::vector< std::pair<int,bubble_data_t::support_t> >& supports)const{
     bool bErr = false;
     for(size_t rr=0;rr<rp.size();++rr){
         const int edge = rp[rr];
@@ -483,15 +541,43 @@ bool bubble_logger::log_read(basevector const&read, qualvector const&qual, ReadP
             if( q_cur > q_alt){
                 bErr = true;
                 // if(bVerbose) std::cout << "WARNING: read-path of this read is not the lowest error path, q_alt < q_cur " << q_alt << " " << q_cur << std::endl;
-                this->addWeight(other_edge,bubble_data_t::support_t(q_alt,q_cur-q_alt));
+                supports.push_back(std::make_pair(other_edge,bubble_data_t::support_t(q_alt,q_cur-q_alt)));
             }
             else{
-                this->addWeight(edge,bubble_data_t::support_t(q_cur,q_alt-q_cur));
+                supports.push_back(std::make_pair(edge,bubble_data_t::support_t(q_cur,q_alt-q_cur)));
             }
         }
     }
     return bErr;
 }
+
+size_t bubble_logger::log_reads(vecbasevector const&bases, VecPQVec const&quals, ReadPathVec const&paths
+                                , BinnedQualVec const*bquals){
+    // a chunk of the schedule below is worked by one thread, in read order, so buffering the supports by chunk
+    // and handing them on chunk by chunk keeps them in read order
+    const uint64_t nReads = bases.size();
+    const uint64_t chunkSize = 10000;
+    std::vector< std::vector< std::pair<int,bubble_data_t::support_t> > > chunk_supports((nReads+chunkSize-1)/chunkSize);
+    size_t nErr = 0;
+    #pragma omp parallel reduction(+:nErr)
+    {
+        qualvector qual;
+        #pragma omp for schedule(dynamic,chunkSize)
+        for(uint64_t rr=0;rr<nReads;++rr){
+            ReadPath const& rp = paths[rr];
+            if( std::none_of(rp.begin(),rp.end(),[this](int edge){ return this->alt(edge)>=0; }) ) continue;
+            UnpackQuals(quals,bquals,rr,&qual);
+            if( read_supports(bases[rr],qual,rp,chunk_supports[rr/chunkSize]) ) ++nErr;
+        }
+    }
+
+    for(auto& supports: chunk_supports){
+        for(const auto& entry: supports){ this->addWeight(entry.first,entry.second); }
+        std::vector< std::pair<int,bubble_data_t::support_t> >().swap(supports);
+    }
+    return nErr;
+}
+
 bubble_logger::bubble_logger(const HyperBasevector& hb, const vec<int>& inv)
                             :hb_(hb)
                             ,edge_alt_(hb.EdgeObjectCount(),-1)
@@ -587,7 +673,7 @@ bubble_logger::bubble_logger(const HyperBasevector& hb, const vec<int>& inv)
 
 //do a gap-free alignment of the read against the graph according to rp
 //returns the sum of read-quality-score at the position the sequence mismatches
-int bubble_logger::getQ(basevector const&read, qualvector const&qual, ReadPath const&rp, const qualvector::value_type min_q){
+int bubble_logger::getQ(basevector const&read, qualvector const&qual, ReadPath const&rp, const qualvector::value_type min_q)const{
     int out=0;
     int bp=0;
     int shift=rp.getOffset();
@@ -648,77 +734,19 @@ std::ostream& operator<<(std::ostream& os, bubble_logger::bubble_data_t const&in
 
 namespace{
 
-typedef size_t work_item_t;
-
-class LogBubblesProcessor
-{
-public:
-    LogBubblesProcessor( bubble_logger& logger
-                       , vecbasevector const&bases, vecqualvector const&quals, ReadPathVec const& paths2)
-                       : logger_(logger)
-                       , bases_(bases)
-                       , quals_(quals)
-                       , paths2_(paths2){}
-    void operator()(work_item_t const&item){
-         if( logger_.log_read(bases_[item], quals_[item], paths2_[item]) ){
-             SpinLocker ml(message_lock);
-             if( nWarnings < nMaxVerbose ){
-                 // std::cout << "WARNING: read-path of read " << item << " is not the lowest error path, q_alt < q_cur " << std::endl;
-                 if(nWarnings+1==nMaxVerbose){
-                     // std::cout << "WARNING: read-path warning silenced" << std::endl;
-                 }
-             }
-             ++nWarnings;
-         }
-    }
-    static std::atomic<size_t> nWarnings;
-private:
-    bubble_logger& logger_;
-    vecbasevector const& bases_;
-    vecqualvector const& quals_;
-    ReadPathVec const&paths2_;
-    static const size_t nMaxVerbose=10;
-    static SpinLockedData message_lock;
-
-};
-std::atomic<size_t> LogBubblesProcessor::nWarnings(0);
-SpinLockedData LogBubblesProcessor::message_lock;
-
 void LogBubbles( bubble_logger& logger, HyperBasevector& hb , const vec<int>& inv2
-               , const vecbasevector & bases, const VecPQVec& quals, const ReadPathVec& paths2){
-     ForceAssertEq( bases.size(), quals.size() );
+               , const vecbasevector & bases, const VecPQVec& quals, const ReadPathVec& paths2
+               , const BinnedQualVec* bquals=nullptr){
+     ForceAssertEq( bases.size(), bquals ? bquals->size() : quals.size() );
      ForceAssertEq( bases.size(), paths2.size() );
      ForceAssert(hb.EdgeObjectCount()==inv2.isize());
 
-
-     //parallelized version -- not turn on at this moment to order the read-path warnings
-/*
-     parallelFor(0ul,bases.size(),LogBubblesProcessor(logger,bases,quals,paths2));
-     if(LogBubblesProcessor::nWarnings>0){
-         std::cout << "WARNING: " << LogBubblesProcessor::nWarnings << " suspicious read-paths." << std::endl;
-     }
-*/
-
-     const size_t nMaxVerbose=10;
-     size_t nWarnings=0;
-     auto qvItr = quals.begin();
-     for(int64_t rr=0;rr<bases.size();++rr,++qvItr){
-         if( logger.log_read(bases[rr], *qvItr, paths2[rr]) ){
-             if( nWarnings < nMaxVerbose ){
-                 // std::cout << "WARNING: read-path of read " << rr << " is not the lowest error path, q_alt < q_cur " << std::endl;
-                 if( nWarnings+1 == nMaxVerbose){
-                     // std::cout << "WARNING: read-path warning silenced" << std::endl;
-                 }
-             }
-             ++nWarnings;
-         }
-     }
+     const size_t nWarnings = logger.log_reads(bases,quals,paths2,bquals);
      if(nWarnings>0){
          std::cout << "WARNING: " << nWarnings << " suspicious read-paths." << std::endl;
      }
 }
 
-
 }
 
 void PrintBubbles( std::ostream& os, HyperBasevector& hb , const vec<int>& inv2
@@ -729,11 +757,12 @@ void PrintBubbles( std::ostream& os, HyperBasevector& hb , const vec<int>& inv2
 }
 
 void PopBubbles( HyperBasevector& hb , const vec<int>& inv2
-               , const vecbasevector & bases, const VecPQVec& quals, const ReadPathVec& paths2){
+               , const vecbasevector & bases, const VecPQVec& quals, const ReadPathVec& paths2
+               , const BinnedQualVec* bquals){
 
      // set up bubble logger, then go through each read
      bubble_logger logger( hb , inv2 );
-     LogBubbles(logger,hb,inv2,bases,quals,paths2);
+     LogBubbles(logger,hb,inv2,bases,quals,paths2,bquals);
 
      auto sum_expected_number_of_reads=[]( vec<bubble_logger::bubble_data_t::support_t>const& branch0
                                          , vec<bubble_logger::bubble_data_t::support_t>const& branch1
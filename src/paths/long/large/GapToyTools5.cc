@@ -21,6 +21,7 @@
 #include "kmers/KmerRecord.h"
 #include "kmers/MakeLookup.h"
 #include "math/Functions.h"
+#include "paths/FrozenHBV.h"
 #include "paths/HyperBasevector.h"
 #include "paths/RemodelGapTools.h"
 #include "paths/long/ReadPath.h"
@@ -414,13 +415,13 @@ void AlignToGenomePerf( const HyperBasevector& hb, const vecbasevector& genome,
      LogTime( clock, "aligning to genome perf" );    }
 
 void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
-     ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals )
+     ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
+     const BinnedQualVec* bquals )
 {
      // Create indices.
 
      double clock = WallClockTime( );
-     vec<int> to_left, to_right;
-     hb.ToLeft(to_left), hb.ToRight(to_right);
+     FrozenHBV g(hb);
 
      // Begin reroute.
 
@@ -439,9 +440,9 @@ void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
           vec<int> s( p.size( ) );
           s[0] = p.getOffset( );
           for ( int j = 1; j < (int) p.size( ); j++ )
-               s[j] = s[j-1] - hb.EdgeLengthKmers( p[j-1] );
+               s[j] = s[j-1] - g.Kmers( p[j-1] );
           int n = bases[id].size( );
-          if ( s.back( ) + n > hb.EdgeLengthBases( p.back( ) ) ) continue;
+          if ( s.back( ) + n > g.Bases( p.back( ) ) ) continue;
 
           // Find possible starts for the read.
 
@@ -452,17 +453,14 @@ void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
           for ( int i = 0; i < starts.isize( ); i++ )
           {    if ( depth[i] == max_depth ) continue;
                int e = starts[i].first, start = starts[i].second;
-               int v = to_left[e], w = to_right[e];
-               for ( int j = 0; j < hb.To(v).isize( ); j++ )
-               {    int ex = hb.EdgeObjectIndexByIndexTo( v, j );
-                    int startx = start + hb.EdgeLengthKmers(ex);
+               for ( int ex : g.Prev(e) )
+               {    int startx = start + g.Kmers(ex);
                     if ( !Member( startsx, std::make_pair( ex, startx ) ) )
                     {    starts.push( ex, startx );
                          startsx.insert( std::make_pair( ex, startx ) );
                          depth.push_back( depth[i] + 1 );    }    }
-               for ( int j = 0; j < hb.From(w).isize( ); j++ )
-               {    int ex = hb.EdgeObjectIndexByIndexFrom( w, j );
-                    int startx = start - hb.EdgeLengthKmers(e);
+               for ( int ex : g.Next(e) )
+               {    int startx = start - g.Kmers(e);
                     if ( !Member( startsx, std::make_pair( ex, startx ) ) )
                     {    starts.push( ex, startx );
                          startsx.insert( std::make_pair( ex, startx ) );
@@ -473,7 +471,7 @@ void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
           vec<ReadPath> ps;
           for ( int i = 0; i < starts.isize( ); i++ )
           {    if ( starts[i].second < 0 
-                    || starts[i].second >= hb.EdgeLengthBases( starts[i].first ) )
+                    || starts[i].second >= g.Bases( starts[i].first ) )
                {    continue;    }
                ReadPath q;
                q.push_back( starts[i].first );
@@ -488,14 +486,13 @@ void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
                vec<int> s( ps[i].size( ) );
                s[0] = ps[i].getOffset( );
                for ( int j = 1; j < (int) ps[i].size( ); j++ )
-                    s[j] = s[j-1] - hb.EdgeLengthKmers( ps[i][j-1] );
+                    s[j] = s[j-1] - g.Kmers( ps[i][j-1] );
                int n = bases[id].size( );
-               if ( s.back( ) + n <= hb.EdgeLengthBases( ps[i].back( ) ) ) continue;
+               if ( s.back( ) + n <= g.Bases( ps[i].back( ) ) ) continue;
                to_delete[i] = True;
-               int v = to_right[ ps[i].back( ) ];
-               for ( int j = 0; j < hb.From(v).isize( ); j++ )
+               for ( int ex : g.Next( ps[i].back( ) ) )
                {    ReadPath r(ps[i]);
-                    r.push_back( hb.EdgeObjectIndexByIndexFrom( v, j ) );
+                    r.push_back(ex);
                     ps.push_back(r);    
                     to_delete.push_back(False);    }    }
           if ( ps.isize( ) > max_paths ) continue;
@@ -507,7 +504,7 @@ void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
           vec< std::pair<int,int> > qsum( ps.size( ), std::make_pair(0,0) );
           const basevector& r = bases[id];
           qvec qv;
-          quals[id].unpack(&qv);
+          UnpackQuals( quals, bquals, id, &qv );
           for ( int i = 0; i < ps.isize( ); i++ )
           {    const ReadPath& q = ps[i];
                qsum[i].second = -q.size( );
@@ -612,8 +609,7 @@ void Tamp( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      time_t now = time(0);
      //std::cout << "[GapToyTools5.cc] Begining Tamp: " << ctime(&now) << std::endl;
      double clock = WallClockTime( );
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
      int K = hb.K( );
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
@@ -1130,7 +1126,7 @@ void PlacePartners( const HyperBasevector& hb, const vec<int>& inv,
           {    SerfVec<int> x;
                x.push_back(e);
                ReadPath p;
-               (SerfVec<int>&) p = x;
+               p.assign( x.begin( ), x.end( ) );
                p.setOffset(start);
                const int EXT_MODE = 1;
                ExtendPath( p, ids[i], hb, to_right, bases[i], qvItr[i],
@@ -520,7 +520,8 @@ template<int L> void ImprovePathsCoreCore( const vec<int>& to_left,
      const vec<int>& rstarts,
      ReadPathVec& paths, const HyperBasevector& hb,
      const vec<int>& inv, const vecbasevector& bases, const VecPQVec& quals,
-     const vec<int64_t>& ids, const path_improver& pimp )
+     const vec<int64_t>& ids, const path_improver& pimp,
+     const BinnedQualVec* bquals )
 {
      // Improve paths.
 
@@ -531,9 +532,11 @@ template<int L> void ImprovePathsCoreCore( const vec<int>& to_left,
      for ( int64_t id = 0; id < (int64_t) bases.size( ); id++ )
      {    path_improver::path_status status;
           int64_t true_id = ( ids.empty( ) ? id : ids[id] );
+          qvec q;
+          UnpackQuals( quals, bquals, id, &q );
 
           ImprovePath( rstarts, locsx, paths, id, paths[id], true_id, hb, inv,
-               to_left, to_right, bases[id], quals.begin()[id], kmers_plus, pimp,
+               to_left, to_right, bases[id], q, kmers_plus, pimp,
                status );
 
           if (track_results) // slow
@@ -570,7 +573,8 @@ template<int L> void BuildLookup( vec< triple<kmer<L>,int,int> >& kmers_plus,
 void ImprovePaths( ReadPathVec& paths, const HyperBasevector& hb,
      const vec<int>& inv, const vecbasevector& bases, const VecPQVec& quals,
      const vec<int64_t>& ids, const path_improver& pimp,
-     const Bool IMPROVE_PATHS_LARGE, const Bool BETSYBOB )
+     const Bool IMPROVE_PATHS_LARGE, const Bool BETSYBOB,
+     const BinnedQualVec* bquals )
 {
      // Build indices.
 
@@ -648,19 +652,19 @@ void ImprovePaths( ReadPathVec& paths, const HyperBasevector& hb,
                vec< triple<kmer<L>,int,int> > kmers_plus;
                BuildLookup( kmers_plus, hb );
                ImprovePathsCoreCore( to_left, to_right, kmers_plus, locsx,
-                    rstarts, paths, hb, inv, bases, quals, ids, pimp );    }
+                    rstarts, paths, hb, inv, bases, quals, ids, pimp, bquals );    }
           if ( pass == 2 )
           {    const int L = 40;
                const vec<int> rstarts = {0};
                vec< triple<kmer<L>,int,int> > kmers_plus;
                BuildLookup( kmers_plus, hb );
                ImprovePathsCoreCore( to_left, to_right, kmers_plus, locsx,
-                    rstarts, paths, hb, inv, bases, quals, ids, pimp );    }
+                    rstarts, paths, hb, inv, bases, quals, ids, pimp, bquals );    }
           if ( pass == 3 )
           {    const int L = 80;
                const vec<int> rstarts = {0,80};
                vec< triple<kmer<L>,int,int> > kmers_plus;
                BuildLookup( kmers_plus, hb );
                ImprovePathsCoreCore( to_left, to_right, kmers_plus, locsx,
-                    rstarts, paths, hb, inv, bases, quals, ids, pimp );    }    }
+                    rstarts, paths, hb, inv, bases, quals, ids, pimp, bquals );    }    }
      std::cout << Date( ) << ": done" << std::endl;    }
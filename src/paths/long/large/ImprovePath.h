@@ -11,6 +11,7 @@
 
 #include "CoreTools.h"
 #include "Qualvector.h"
+#include "feudal/BinnedQualVec.h"
 #include "feudal/PQVec.h"
 #include "kmers/KmerRecord.h"
 #include "paths/HyperBasevector.h"
@@ -49,6 +50,10 @@ void ImprovePaths( ReadPathVec& paths, const HyperBasevector& hb,
      const vec<int64_t>& ids, 
 
      const path_improver& pimp, const Bool IMPROVE_PATHS_LARGE, 
-     const Bool BETSYBOB );
+     const Bool BETSYBOB,
+
+     // bquals: if given, stands in for quals.
+
+     const BinnedQualVec* bquals = nullptr );
 
 #endif
@@ -13,6 +13,7 @@
 #include "efasta/EfastaTools.h"
 #include "math/Functions.h"
 #include "graph/FindCells.h"
+#include "paths/FrozenHBV.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
 #include "paths/long/large/GapToyTools.h"
@@ -23,8 +24,7 @@
 void FindLines( const HyperBasevector& hb, const vec<int>& inv,
      vec<vec<vec<vec<int>>>>& lines, const int64_t max_cell_paths, const int max_depth )
 {    double clock = WallClockTime( );
-     vec<int> to_left, to_right;
-     hb.ToLeft(to_left), hb.ToRight(to_right);
+     FrozenHBV g( hb, &inv );
 
      // Heuristics.
 
@@ -37,7 +37,7 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
      {    int max_cell_verts = verts_mul * max_cell_paths;
           vec< std::pair<int,int> > bounds0;
           // std::cout << Date( ) << ": finding cells" << std::endl;
-          FindSomeCells( hb, max_cell_verts, max_depth, bounds0 );
+          FindSomeCells( g, max_cell_verts, max_depth, bounds0 );
 
           // Symmetrize cells.
 
@@ -45,8 +45,8 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
           int nb = bounds0.size( );     
           for ( int i = 0; i < nb; i++ )
           {    int v = bounds0[i].first, w = bounds0[i].second;
-               int rv = to_right[ inv[ hb.IFrom(v,0) ] ];
-               int rw = to_left[ inv[ hb.ITo(w,0) ] ];
+               int rv = g.ToRight( g.Inv( g.IFrom(v,0) ) );
+               int rw = g.ToLeft( g.Inv( g.ITo(w,0) ) );
                bounds0.push( rw, rv );    }
           ParallelUniqueSort(bounds0);
 
@@ -58,8 +58,7 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
           #pragma omp parallel for
           for ( int i = 0; i < bounds0.isize( ); i++ )
           {    int v = bounds0[i].first, w = bounds0[i].second;
-               Bool OK = hb.EdgePaths( to_left, to_right, v, w, xpaths[i], -1, 
-                    max_cell_paths );
+               Bool OK = g.EdgePaths( v, w, xpaths[i], -1, max_cell_paths );
                int64_t nxpaths = xpaths[i].size( );
                if ( !OK || nxpaths > max_cell_paths ) xdel[i] = True;    }
           EraseIf( xpaths, xdel ), EraseIf( bounds, xdel );    }
@@ -74,7 +73,7 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
      for ( int i = 0; i < bounds.isize( ); i++ )
      {    int v = bounds[i].first, w = bounds[i].second;
           e.clear();
-          e.push_back(hb.IFrom(v,0)).push_back(hb.ITo(w,0));
+          e.push_back(g.IFrom(v,0)).push_back(g.ITo(w,0));
           for ( int64_t j = 0; j < xpaths[i].isize( ); j++ )
             for ( int64_t k = 0; k < xpaths[i][j].isize( ); k++ )
                e.push_back( xpaths[i][j][k] );
@@ -106,11 +105,11 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
      //vec<vec<int>> with a single empty element.
      vec<vec<int>> x(1);
      for ( int e = 0; e < nobj; e++ )
-     {    int v = to_right[e];
-          if ( !hb.To(v).solo( ) || !hb.From(v).solo( ) ) continue;
-          int f = hb.IFrom( v, 0 ), w = hb.From(v)[0];
-          if ( hb.EdgeLengthBases(f) != 0 ) continue;
-          if ( !hb.To(w).solo( ) || !hb.From(w).solo( ) ) continue;
+     {    int v = g.ToRight(e);
+          if ( !g.To(v).solo( ) || !g.From(v).solo( ) ) continue;
+          int f = g.IFrom( v, 0 ), w = g.From(v)[0];
+          if ( g.Bases(f) != 0 ) continue;
+          if ( !g.To(w).solo( ) || !g.From(w).solo( ) ) continue;
           bounds.push( v, w );
           xpaths.push_back(x);    }
 
@@ -126,8 +125,8 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
 
      vec<int> ids( nobj, vec<int>::IDENTITY );
      std::sort(ids.begin(),ids.end(),
-             [&hb](int i1,int i2)
-             {return hb.EdgeObject(i1).size()>hb.EdgeObject(i2).size();});
+             [&g](int i1,int i2)
+             {return g.Bases(i1)>g.Bases(i2);});
 
      // Go through the edges and build lines.
 
@@ -136,7 +135,7 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
      // #pragma omp parallel for // seems unsafe and doesn't save time
      for ( int ie = 0; ie < nobj; ie++ )
      {    int e = ids[ie];
-          if ( hb.EdgeLengthBases(e) == 0 ) continue;
+          if ( g.Bases(e) == 0 ) continue;
           if ( !used[e] ) continue;
           if ( marked[e] ) continue;
           marked[e] = True;
@@ -146,12 +145,12 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
           vec< vec< vec<int> > > line = {{{e}}};
           Bool circle = False;
           while(1)
-          {    int w = to_left[ line.front( )[0][0] ];
-               if ( !hb.From(w).solo( ) || !right_ind[w].solo( ) ) break;
+          {    int w = g.ToLeft( line.front( )[0][0] );
+               if ( !g.From(w).solo( ) || !right_ind[w].solo( ) ) break;
                int bid = right_ind[w][0];
                int v = bounds[bid].first;
                line.push_front( xpaths[bid] );
-               int eb = hb.ITo(v, 0);
+               int eb = g.ITo(v, 0);
                line.push_front( {{eb}} );
                marked[eb] = True;
                for ( int64_t i = 0; i < xpaths[bid].isize( ); i++ )
@@ -162,11 +161,11 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
                     break;     }    }
           if ( !circle )
           {    while(1)
-               {    int v = to_right[ line.back( )[0][0] ];
-                    if ( !hb.To(v).solo( ) || !left_ind[v].solo( ) ) break;
+               {    int v = g.ToRight( line.back( )[0][0] );
+                    if ( !g.To(v).solo( ) || !left_ind[v].solo( ) ) break;
                     int bid = left_ind[v][0];
                     int w = bounds[bid].second;
-                    int eb = hb.IFrom(w, 0);
+                    int eb = g.IFrom(w, 0);
                     line.push_back( xpaths[bid], {{eb}} );
                     if ( eb == e ) std::cout << "CIRCLE!" << std::endl;
                     marked[eb] = True;
@@ -442,17 +441,19 @@ double RawCoverage( const int e, const HyperBasevector& hb,
 void ComputeCoverage( const HyperBasevector& hb, const vec<int>& inv, 
      const ReadPathVec& paths, const vec<vec<vec<vec<int>>>>& lines,
      const vec<int64_t>& subsam_starts, vec<vec<covcount>>& covs )
+{    EdgePathIndex paths_index( paths, hb.EdgeObjectCount( ) );
+     ComputeCoverage( hb, inv, paths, paths_index, lines, subsam_starts, covs );    }
+
+void ComputeCoverage( const HyperBasevector& hb, const vec<int>& inv, 
+     const ReadPathVec& paths, const VecULongVec& paths_index,
+     const vec<vec<vec<vec<int>>>>& lines,
+     const vec<int64_t>& subsam_starts, vec<vec<covcount>>& covs )
 {
      // Heuristics.
 
      const int min_line = 1000;
      const int top_group = 50;
 
-     // Index paths (better done outside this program).
-
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
-
      // Compute pairs touching each line.
 
      int ns = subsam_starts.size( );
@@ -685,8 +686,7 @@ void DumpLineFiles( const vec<vec<vec<vec<int>>>>& lines, const HyperBasevector&
 
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.E( ) );
+     EdgePathIndex paths_index( paths, hb.E( ) );
      Ofstream( out1, dir + "/a.lines.efasta" );
      Ofstream( out2, dir + "/a.lines.fasta" );
      for ( int i = 0; i < lines.isize( ); i++ )
@@ -163,6 +163,13 @@ void ComputeCoverage( const HyperBasevector& hb, const vec<int>& inv,
      const ReadPathVec& paths, const vec<vec<vec<vec<int>>>>& lines,
      const vec<int64_t>& subsam_starts, vec<vec<covcount>>& covs );
 
+// Same, with the paths indexed already.
+
+void ComputeCoverage( const HyperBasevector& hb, const vec<int>& inv, 
+     const ReadPathVec& paths, const VecULongVec& paths_index,
+     const vec<vec<vec<vec<int>>>>& lines,
+     const vec<int64_t>& subsam_starts, vec<vec<covcount>>& covs );
+
 void TestLineSymmetry( const vec<vec<vec<vec<int>>>>& lines, const vec<int>& inv );
 
 // Sort lines so that they are in reverse order by length, and each line is
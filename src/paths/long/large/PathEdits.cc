@@ -0,0 +1,122 @@
+//
+// PathEdits.cc: read path rewrites queued behind graph clean-ups, applied in one pass.
+//
+
+#include "paths/long/large/PathEdits.h"
+#include <algorithm>
+
+void PathEdits::truncate( vec<Bool> const& keep )
+{
+    mStages.push_back(Stage());
+    Stage& stage = mStages.back();
+    stage.kind = TRUNCATE;
+    stage.keep = keep;
+    stage.nEdges = keep.size();
+}
+
+void PathEdits::merge( vec<int> const& newEdge, vec<int> const& offsets, size_t nEdges )
+{
+    mStages.push_back(Stage());
+    Stage& stage = mStages.back();
+    stage.kind = MERGE;
+    stage.newEdge = newEdge;
+    stage.offsets = offsets;
+    stage.nEdges = nEdges;
+}
+
+void PathEdits::renumber( vec<int> const& newEdge, size_t nEdges )
+{
+    mStages.push_back(Stage());
+    Stage& stage = mStages.back();
+    stage.kind = RENUMBER;
+    stage.newEdge = newEdge;
+    stage.nEdges = nEdges;
+}
+
+void PathEdits::runStage( Stage const& stage, std::vector<int>& edges, int& offset )
+{
+    size_t nnn = edges.size();
+    switch ( stage.kind )
+    {
+    case TRUNCATE:
+        for ( size_t idx = 0; idx != nnn; ++idx )
+        {   int edge = edges[idx];
+            if ( edge < 0 || edge >= stage.keep.isize() || !stage.keep[edge] )
+            {   edges.resize(idx);
+                break; } }
+        break;
+    case MERGE:
+    {
+        if ( !nnn ) break;
+        if ( !stage.offsets.empty() ) offset += stage.offsets[edges[0]];
+        size_t out = 0;
+        for ( size_t idx = 0; idx != nnn; ++idx )
+        {   int edge = stage.newEdge.empty() ? edges[idx] : stage.newEdge[edges[idx]];
+            if ( !out || edge != edges[out-1] ) edges[out++] = edge; }
+        edges.resize(out);
+        break;
+    }
+    case RENUMBER:
+        for ( int& edge : edges )
+        {   int n = stage.newEdge[edge];
+            if ( n >= 0 ) edge = n; }
+        break;
+    }
+}
+
+void PathEdits::apply( ReadPathVec& paths, EdgePathIndex* paths_index )
+{
+    if ( mStages.empty() ) return;
+
+    // The index's lists move with each renumbering.  Which paths belong on them
+    // is then sorted out path by path, below.
+    bool relocated = false;
+    if ( paths_index )
+        for ( Stage const& stage : mStages )
+        {
+            if ( stage.kind == MERGE && paths_index->size() < stage.nEdges )
+                paths_index->resize(stage.nEdges);
+            else if ( stage.kind == RENUMBER )
+            {   paths_index->renumberEdges(stage.newEdge,stage.nEdges);
+                relocated = true; }
+        }
+
+    EdgePathIndex::Updater index_updater(paths_index);
+    int64_t nPaths = paths.size();
+    #pragma omp parallel
+    {
+        std::vector<int> edges, indexed;
+        #pragma omp for schedule(static,10000)
+        for ( int64_t id = 0; id < nPaths; ++id )
+        {
+            ReadPath& path = paths[id];
+            if ( path.empty() ) continue;
+            edges.assign(path.begin(),path.end());
+            int offset = path.getOffset();
+            for ( Stage const& stage : mStages )
+                runStage(stage,edges,offset);
+            bool changed = offset != path.getOffset() || edges.size() != path.size()
+                            || !std::equal(edges.begin(),edges.end(),path.begin());
+            if ( paths_index && (changed || relocated) )
+            {
+                // the lists the path is on now:  its old edges, carried along with their lists
+                indexed.clear();
+                for ( int edge : path )
+                {
+                    bool alive = edge >= 0;
+                    for ( auto itr = mStages.begin(); alive && itr != mStages.end(); ++itr )
+                    {   if ( itr->kind != RENUMBER ) continue;
+                        if ( edge < itr->newEdge.isize() ) edge = itr->newEdge[edge];
+                        alive = edge >= 0 && size_t(edge) < itr->nEdges; }
+                    if ( alive ) indexed.push_back(edge);
+                }
+                index_updater.replace(id,indexed,edges);
+            }
+            if ( changed )
+            {   path.assign(edges.begin(),edges.end());
+                path.setOffset(offset); }
+        }
+    }
+    index_updater.apply();
+    mStages.clear();
+}
@@ -0,0 +1,55 @@
+//
+// PathEdits.h: read path rewrites queued behind graph clean-ups, applied in one pass.
+//
+
+#ifndef W2RAP_CONTIGGER_PATHEDITS_H
+#define W2RAP_CONTIGGER_PATHEDITS_H
+
+#include "Vec.h"
+#include "paths/long/EdgePathIndex.h"
+#include "paths/long/ReadPath.h"
+#include <vector>
+
+// The changes to the read paths that follow from graph clean-ups (truncation at deleted edges, the merges of
+// RemoveUnneededVertices2, the renumbering of CleanupCore), held as translation tables rather than carried out
+// at once.  Each table is indexed by the edge numbers current when it was queued, and apply() runs every path
+// through all of them in order, so a run of clean-ups costs a single pass over the paths, and gives exactly what
+// doing each in turn would have.  While edits are pending, the graph has moved on and the paths haven't:  they
+// mustn't be used until apply() is called.
+class PathEdits
+{
+public:
+    // Cut each path just before its first edge that's negative, not less than keep.size(), or not kept.
+    void truncate( vec<Bool> const& keep );
+
+    // Replace each edge e of a nonempty path by newEdge[e], skipping it if that repeats the last edge
+    // written, and advance the path's offset by offsets[first edge].  nEdges is the edge count afterwards.
+    // Empty tables mean every edge keeps its number and offset (though repeats are still squeezed out).
+    void merge( vec<int> const& newEdge, vec<int> const& offsets, size_t nEdges );
+
+    // Replace each edge e by newEdge[e], unless that's negative.  nEdges is the edge count afterwards.
+    void renumber( vec<int> const& newEdge, size_t nEdges );
+
+    bool empty() const { return mStages.empty(); }
+
+    // Carries out the queued edits, in parallel, and keeps paths_index in step if one is given.
+    void apply( ReadPathVec& paths, EdgePathIndex* paths_index = nullptr );
+
+private:
+    enum Kind { TRUNCATE, MERGE, RENUMBER };
+
+    struct Stage
+    {
+        Kind kind;
+        vec<Bool> keep;
+        vec<int> newEdge;
+        vec<int> offsets;
+        size_t nEdges;
+    };
+
+    static void runStage( Stage const& stage, std::vector<int>& edges, int& offset );
+
+    std::vector<Stage> mStages;
+};
+
+#endif //W2RAP_CONTIGGER_PATHEDITS_H
@@ -12,6 +12,7 @@
 #ifndef PULLAPARTER_H_
 #define PULLAPARTER_H_
 #include "paths/HyperBasevector.h"
+#include "paths/long/EdgePathIndex.h"
 #include "paths/long/ReadPath.h"
 
 #include "paths/long/large/GapToyTools.h"
@@ -21,7 +22,7 @@
 class PullAparter {
      public:
           PullAparter( HyperBasevector& hbv, vec<int>& inv,
-                    ReadPathVec& paths, VecULongVec& invPaths,
+                    ReadPathVec& paths, EdgePathIndex& invPaths,
 		    vec<int> trace_edges = vec<int>{},
                     bool debug = false,
                     int min_reads = 5, float min_mult = 5.0) :
@@ -92,8 +93,10 @@ class PullAparter {
                ForceAssertEq(readPathIndices.size()%2,0u);
                for ( auto itr = readPathIndices.cbegin();
                          itr != readPathIndices.cend(); advance(itr,2) ) {
-                    std::vector<int> readPath = mPaths[itr[0]];
-                    std::vector<int> readPath1 = inversePath(mPaths[itr[1]]);
+                    ReadPath const& path = mPaths[itr[0]];
+                    std::vector<int> readPath(path.begin(), path.end());
+                    ReadPath const path1 = inversePath(mPaths[itr[1]]);
+                    std::vector<int> readPath1(path1.begin(), path1.end());
 
                     OverlapAppend(readPath, readPath1);
 
@@ -352,7 +355,7 @@ class PullAparter {
                mHBV.ToRight(mToRight);
                // std::cout << mHBV.EdgeObjectCount() <<  "/" << mHBV.N() <<
                //  " edges/vertices before removing unneeded vertices" << std::endl;
-               RemoveUnneededVertices2(mHBV, mInv, mPaths);
+               RemoveUnneededVertices2(mHBV, mInv, mPaths, &mEdgeToPathIds);
 
                double clock2 = WallClockTime();
 
@@ -383,23 +386,26 @@ class PullAparter {
                {    if ( inv >= 0 ) inv = renumber_edges[inv];    }
 
                // fix ReadPaths and ReadPaths index
-               // ReadPaths are broken due to removal of dead edge objects
-               // ReadPaths index was broken by removing unneeded vertices
-               mEdgeToPathIds.clear();
-               mEdgeToPathIds.resize(mHBV.EdgeObjectCount());
+               // both are broken due to removal of dead edge objects
+               mEdgeToPathIds.renumberEdges(renumber_edges, mHBV.EdgeObjectCount());
+               EdgePathIndex::Updater index_updater(&mEdgeToPathIds);
                for ( size_t readid = 0; readid < mPaths.size(); ++readid ) {
                     ReadPath& path = mPaths[readid];
-                    for ( auto& edge : path ) {
-                        if ( renumber_edges[edge] != -1 ) {
-                            edge = renumber_edges[edge];
-                            mEdgeToPathIds[edge].push_back(readid);
-                        } else {
-                            std::cout << "WARNING: read " << readid <<
-                                    " contains a dead edge " << edge << std::endl;
-                            path.clear(); /// NIW MUST ALSO REMOVE FROM INDEX
-                        }
+                    auto dead = std::find_if( path.begin(), path.end(),
+                            [&renumber_edges]( int edge ) { return renumber_edges[edge] == -1; } );
+                    if ( dead != path.end() ) {
+                        std::cout << "WARNING: read " << readid <<
+                                " contains a dead edge " << *dead << std::endl;
+                        for ( auto const edge : path )
+                            if ( renumber_edges[edge] != -1 )
+                                index_updater.remove(readid, renumber_edges[edge]);
+                        path.clear();
+                        continue;
                     }
+                    for ( auto& edge : path )
+                        edge = renumber_edges[edge];
                }
+               index_updater.apply();
                std::cout << TimeSince(clock2) << " used in fixing mToLeft, mToRight, "
                          << "and mEdgeToPathIds" << std::endl;
                // std::cout << mHBV.EdgeObjectCount() <<  "/" << mHBV.N() <<
@@ -442,10 +448,10 @@ class PullAparter {
                         if ( ldebug ) std::cout << "... readpath already nulled" << std::endl;
                         continue;       // may have been nulled earlier
                     }
-                    std::vector<int> extReadPath = readPath;
+                    std::vector<int> extReadPath(readPath.begin(), readPath.end());
                     int pair_offset = ( *itr % 2 == 0 ) ? +1 : -1 ;
-                    std::vector<int> extReadPath1;
-                    extReadPath1 = inversePath(mPaths[*itr + pair_offset]);
+                    ReadPath const readPath1 = inversePath(mPaths[*itr + pair_offset]);
+                    std::vector<int> extReadPath1(readPath1.begin(), readPath1.end());
 
                     // make the read path contain the paired read's edges, too.
                     OverlapAppend(extReadPath, extReadPath1);
@@ -525,7 +531,7 @@ class PullAparter {
           HyperBasevector& mHBV;
           vec<int>& mInv;
           ReadPathVec& mPaths;
-          VecULongVec& mEdgeToPathIds;
+          EdgePathIndex& mEdgeToPathIds;
           vec<int> mToLeft;
           vec<int> mToRight;
           vec<int> mTraceEdges;
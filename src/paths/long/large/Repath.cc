@@ -19,6 +19,101 @@
 #include "paths/long/LongProtoTools.h"
 #include "paths/long/ReadPath.h"
 #include "system/SortInPlace.h"
+#include "util/PerfLog.h"
+
+namespace
+{
+
+// Repathing places, one after the other in a single array of edge ids.
+class PlaceArena
+{
+public:
+    PlaceArena() : mStarts(1,0) {}
+
+    size_t size() const { return mStarts.size()-1; }
+    size_t length( size_t idx ) const { return mStarts[idx+1]-mStarts[idx]; }
+    int const* begin( size_t idx ) const { return mEdges.data()+mStarts[idx]; }
+    int const* end( size_t idx ) const { return mEdges.data()+mStarts[idx+1]; }
+
+    template <class Itr>
+    void push_back( Itr first, Itr last )
+    { mEdges.insert(mEdges.end(),first,last); mStarts.push_back(mEdges.size()); }
+
+    std::vector<int> mEdges;
+    std::vector<uint64_t> mStarts;
+};
+
+// A path is a place only if it implies at least K2 bases.
+bool IsPlace( ReadPath const& p, const vecbasevector& edges, const int K, const int K2 )
+{    if ( p.empty( ) ) return false;
+     int nkmers = 0;
+     for ( int e : p )
+          nkmers += edges[e].size( ) - ( K - 1 );
+     return nkmers + ( K - 1 ) >= K2;    }
+
+// Is the inverse of the path lexicographically smaller than the path?
+bool InverseIsSmaller( ReadPath const& p, const vec<int>& inv )
+{    for ( size_t j = 0, n = p.size( ); j < n; j++ )
+     {    int y = inv[ p[n-j-1] ];
+          if ( y != p[j] ) return y < p[j];    }
+     return false;    }
+
+// Sorts the places lexicographically and removes duplicates.  Returns, for each
+// original place, its index among the unique places.
+std::vector<uint64_t> UniqueSortPlaces( PlaceArena& places )
+{
+     // The sort key has the first two edges of the place (a missing edge sorting
+     // first), so that most comparisons don't have to look at the arena.
+     struct KeyId { uint64_t key; uint64_t id; };
+     const int64_t n = places.size( );
+     std::vector<KeyId> order(n);
+     #pragma omp parallel for schedule(static,10000)
+     for ( int64_t i = 0; i < n; i++ )
+     {    int const* p = places.begin(i);
+          uint64_t key = uint64_t( uint32_t( p[0] ) ) << 32;
+          if ( places.length(i) > 1 ) key |= uint64_t( p[1] ) + 1;
+          order[i] = { key, uint64_t(i) };    }
+     auto compare = [&places]( KeyId const& a, KeyId const& b )
+     {    if ( a.key != b.key ) return a.key < b.key ? -1 : 1;
+          int const *pa = places.begin(a.id), *ea = places.end(a.id);
+          int const *pb = places.begin(b.id), *eb = places.end(b.id);
+          for ( ; pa != ea && pb != eb; ++pa, ++pb )
+               if ( *pa != *pb ) return *pa < *pb ? -1 : 1;
+          return pa != ea ? 1 : pb != eb ? -1 : 0;    };
+     sortInPlaceParallel( order.begin( ), order.end( ), compare );
+
+     // Mark the first of each run of equal places, and number them.
+     std::vector<uint64_t> uniqueIdx(n);
+     #pragma omp parallel for schedule(static,10000)
+     for ( int64_t i = 0; i < n; i++ )
+          uniqueIdx[i] = ( i == 0 || compare( order[i-1], order[i] ) != 0 );
+     uint64_t nUnique = 0;
+     for ( int64_t i = 0; i < n; i++ )
+     {    bool isNew = uniqueIdx[i];
+          nUnique += isNew;
+          uniqueIdx[i] = nUnique - 1;    }
+
+     // Copy the unique places into a new arena, in sorted order.
+     PlaceArena uniq;
+     uniq.mStarts.assign( nUnique + 1, 0 );
+     for ( int64_t i = 0; i < n; i++ )
+          uniq.mStarts[ uniqueIdx[i] + 1 ] = places.length( order[i].id );
+     for ( uint64_t u = 0; u < nUnique; u++ )
+          uniq.mStarts[u+1] += uniq.mStarts[u];
+     uniq.mEdges.resize( uniq.mStarts[nUnique] );
+     std::vector<uint64_t> rank(n);
+     #pragma omp parallel for schedule(static,10000)
+     for ( int64_t i = 0; i < n; i++ )
+     {    uint64_t id = order[i].id, u = uniqueIdx[i];
+          rank[id] = u;
+          if ( i == 0 || uniqueIdx[i-1] != u )
+               std::copy( places.begin(id), places.end(id),
+                    uniq.mEdges.begin( ) + uniq.mStarts[u] );    }
+     places = std::move(uniq);
+     return rank;
+}
+
+}
 
 void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
              const vec<int>& inv, ReadPathVec& paths, const int K, const int K2,
@@ -31,6 +126,7 @@ void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
      // (b) if the inverse of a path is smaller we use it instead;
      // (c) places are unique sorted.
 
+     PerfLog::Scope perf_scope("RepathInMemory");
      std::cout << Date( ) << ": beginning repathing "<<edges.size()<<" edges from K="<<K<<" to K2="<<K2<< std::endl;
      std::cout << Date( ) << ": constructing places from "<<paths.size()<<" paths" << std::endl;
      uint64_t pathed=0,multipathed=0;
@@ -39,35 +135,44 @@ void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
           if (p.size()>2 ) multipathed++;
      }
      std::cout << Date() << ": " <<pathed<<" / "<<paths.size()<<" reads pathed, "<< multipathed << " spanning junctions"<< std::endl;
-     std::vector< std::vector<int> > places;
-     places.reserve( paths.size( ) );
 
-     const int batch = 10000;
+     // Each path that is a place gets an entry in the arena, in path order.  The
+     // entries of each batch of paths are counted first, so that the batches can
+     // then be written in parallel with no locking.
+     const int64_t batch = 10000;
+     const int64_t nbatches = ( (int64_t) paths.size( ) + batch - 1 ) / batch;
+     std::vector<uint64_t> batchEntries( nbatches + 1, 0 ), batchEdges( nbatches + 1, 0 );
      #pragma omp parallel for
-     for (int64_t m = 0; m < (int64_t) paths.size(); m += batch) {
-          std::vector<std::vector<int> > placesm;
-          placesm.reserve(batch);
-          std::vector<int> x, y;
-          int64_t n = Min(m + batch, (int64_t) paths.size());
-          for (int64_t i = m; i < n; i++) {
-               x.clear(), y.clear();
-               for (int64_t j = 0; j < (int64_t) paths[i].size(); j++)
-                    x.push_back(paths[i][j]);
-               int nkmers = 0;
-               for (int j = 0; j < x.size(); j++)
-                    nkmers += edges[x[j]].size() - ((int) K - 1);
-               if (nkmers + ((int) K - 1) < K2) continue;
-               for (int j = x.size() - 1; j >= 0; j--)
-                    y.push_back(inv[x[j]]);
-               placesm.push_back(x < y ? x : y);
-          }
-          #pragma omp critical
-          { places.insert(places.end(),placesm.begin(),placesm.end()); }
-     }
+     for ( int64_t b = 0; b < nbatches; b++ )
+     {    int64_t last = Min( (b+1) * batch, (int64_t) paths.size( ) );
+          for ( int64_t i = b * batch; i < last; i++ )
+          {    if ( !IsPlace( paths[i], edges, K, K2 ) ) continue;
+               batchEntries[b+1]++;
+               batchEdges[b+1] += paths[i].size( );    }    }
+     for ( int64_t b = 0; b < nbatches; b++ )
+     {    batchEntries[b+1] += batchEntries[b];
+          batchEdges[b+1] += batchEdges[b];    }
+     PlaceArena places;
+     places.mStarts.resize( batchEntries[nbatches] + 1 );
+     places.mEdges.resize( batchEdges[nbatches] );
+     #pragma omp parallel for
+     for ( int64_t b = 0; b < nbatches; b++ )
+     {    int64_t last = Min( (b+1) * batch, (int64_t) paths.size( ) );
+          uint64_t entry = batchEntries[b], pos = batchEdges[b];
+          for ( int64_t i = b * batch; i < last; i++ )
+          {    const ReadPath& p = paths[i];
+               if ( !IsPlace( p, edges, K, K2 ) ) continue;
+               if ( InverseIsSmaller( p, inv ) )
+               {    for ( int j = p.size( ) - 1; j >= 0; j-- )
+                         places.mEdges[pos++] = inv[ p[j] ];    }
+               else
+               {    for ( int e : p )
+                         places.mEdges[pos++] = e;    }
+               places.mStarts[++entry] = pos;    }    }
+
+     PerfLog::lap("Places");
      std::cout << Date() << ": sorting "<<places.size()<<" places" << std::endl;
-     sortInPlaceParallel(places.begin(), places.end());
-     places.erase(std::unique(places.begin(),places.end()),places.end());
-     places.shrink_to_fit();
+     std::vector<uint64_t> place_of = UniqueSortPlaces(places);
      std::cout << Date() << ": "<<places.size()<<" unique places" << std::endl;
      // Add extended places.
 
@@ -75,9 +180,11 @@ void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
      {    std::cout << Date( ) << ": begin extending paths" << std::endl;
           vec<int> to_left, to_right;
           hb.ToLeft(to_left), hb.ToRight(to_right);
-          std::vector<std::vector<int>> eplaces;
-          for ( auto i = 0; i < places.size( ); i++ )
-          {    vec<int> p = places[i];
+          // Extended places are added after the unique ones, whose indices thus
+          // don't change until they are sorted again.
+          const size_t nplaces = places.size( );
+          for ( size_t i = 0; i < nplaces; i++ )
+          {    vec<int> p( places.begin(i), places.end(i) );
                int v = to_left[ p.front( ) ], w = to_right[ p.back( ) ];
                while( hb.To(v).solo( ) )
                {    int e = hb.EdgeObjectIndexByIndexTo( v, 0 );
@@ -87,46 +194,48 @@ void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
                {    int e = hb.EdgeObjectIndexByIndexFrom( w, 0 );
                     if ( !Member( p, e ) ) p.push_back(e);
                     else break;    }
-               if ( p.size( ) > places[i].size( ) ) eplaces.push_back(p);    }
-          places.insert(places.end(),eplaces.begin(),eplaces.end());
+               if ( p.size( ) > places.length(i) ) places.push_back( p.begin( ), p.end( ) );    }
           std::cout << Date( ) << ": resorting" << std::endl;
-          sortInPlaceParallel(places.begin(),places.end());
-          places.erase(std::unique(places.begin(),places.end()),places.end());
-          places.shrink_to_fit();
+          std::vector<uint64_t> eplace_of = UniqueSortPlaces(places);
+          #pragma omp parallel for schedule(static,10000)
+          for ( int64_t i = 0; i < (int64_t) place_of.size( ); i++ )
+               place_of[i] = eplace_of[ place_of[i] ];
           std::cout << Date( ) << ": done extending paths" << std::endl;    }
 
      // Convert places to bases.  For paths of length > 1, we truncate at the
-     // beginning and end so that they each contribute at most K2 bases.
+     // beginning and end so that they each contribute at most K2 bases.  Each
+     // edge but the last loses the K-1 bases it shares with the next one.
 
+     PerfLog::lap("SortPlaces");
      std::cout << Date( ) << ": building all" << std::endl;
      vecbasevector all( places.size( ) );
      vec<int> left_trunc( places.size( ), 0 ), right_trunc( places.size( ), 0 );
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic,10000)
      for ( int64_t i = 0; i < (int64_t) places.size( ); i++ )
-     {    vec<int> e;
-          for ( int j = 0; j < (int) places[i].size( ); j++ )
-               e.push_back( places[i][j] );
-          basevector b = edges[ e[0] ];
-          for ( int l = 1; l < e.isize( ); l++ )
-          {    b.resize( b.isize( ) - ( K - 1 ) );
-               b = Cat( b, edges[ e[l] ] );    }
-          if ( e.size( ) > 1 )
-          {    int x = e.back( );
-               if ( edges[x].isize( ) > K2 )
-               {    b.resize( b.isize( ) - ( edges[x].size( ) - K2 ) );
-                    right_trunc[i] = edges[x].isize( ) - K2;    }
-               x = e.front( );
-               if ( edges[x].isize( ) > K2 )
-               {    b.SetToSubOf( b, edges[x].size( ) - K2,
-                                  b.isize( ) - ( edges[x].size( ) - K2 ) );
-                    left_trunc[i] = edges[x].isize( ) - K2;    }    }
-          all[i] = b;    }
+     {    int const* e = places.begin(i);
+          const int n = places.length(i);
+          if ( n > 1 )
+          {    int x = e[n-1];
+               if ( edges[x].isize( ) > K2 ) right_trunc[i] = edges[x].isize( ) - K2;
+               x = e[0];
+               if ( edges[x].isize( ) > K2 ) left_trunc[i] = edges[x].isize( ) - K2;    }
+          int64_t len = - left_trunc[i] - right_trunc[i] - (int64_t) ( n - 1 ) * ( K - 1 );
+          for ( int l = 0; l < n; l++ )
+               len += edges[ e[l] ].size( );
+          basevector& b = all[i];
+          b.reserve(len);
+          for ( int l = 0; l < n; l++ )
+          {    const basevector& E = edges[ e[l] ];
+               int start = ( l == 0 ? left_trunc[i] : 0 );
+               int stop = ( l == n - 1 ? E.isize( ) - right_trunc[i] : E.isize( ) - ( K - 1 ) );
+               b.append( E.begin(start), E.begin(stop) );    }    }
 
      // Build HyperBasevector.
 
      //HyperBasevector hb2;
      vecKmerPath xpaths;
      HyperKmerPath h2;
+     PerfLog::lap("BuildAll");
      std::cout << Date( ) << ": calling LongReadsToPaths" << std::endl;
      unsigned const COVERAGE = 2u;
      LongReadsToPaths( all, K2, COVERAGE, &hb2, &h2, &xpaths );
@@ -137,6 +246,7 @@ void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
      vec<int> inv2;
      hb2.Involution(inv2);
 
+     PerfLog::lap("LongReadsToPaths");
      // Translate paths to the K=200 graph.  Translation method is very ugly.
      if (REPATH_TRANSLATE)
      {    std::cout << Date( ) << ": translating paths" << std::endl;
@@ -210,42 +320,37 @@ void RepathInMemory( const HyperBasevector& hb, const vecbasevector& edges,
 
           std::cout << Date( ) << ": final stage of path translation" << std::endl;
 
-          // Parallelizing this loop does not speed it up.  Perhaps to speed it up
-          // we have to do something smarter, so as to eliminate the binary search
-          // inside the loop.
-          for ( int64_t id = 0; id < (int64_t) paths.size( ); id++ )
-          {    if ( paths[id].empty( ) ) continue;
-
-               // Note that we have more info here: paths[id].getOffset( )
-               // is the start position of the read on the original path.
-
-               vec<int> x, y;
-               for ( int64_t j = 0; j < (int64_t) paths[id].size( ); j++ )
-                    x.push_back( paths[id][j] );
-               int nkmers = 0;
-               for ( int j = 0; j < x.isize( ); j++ )
-                    nkmers += edges[x[j]].isize( ) - ( (int) K - 1 );
-               if ( nkmers + ( (int) K - 1 ) < K2 ) continue;
-               for ( int j = x.isize( ) - 1; j >= 0; j-- )
-                    y.push_back( inv[ x[j] ] );
-               Bool rc = ( y < x );
-               x = Min( x, y );
-               long pos = BinPosition( places, x );
-               long n = ipaths2[pos].size( );
-
-               paths2[id].resize(n);
-
-               int offset;
-               if ( !rc )
-                    offset = paths[id].getOffset( ) + starts[pos] - left_trunc[pos];
-               else offset = paths[id].getOffset( ) + stops[pos] - right_trunc[pos];
-               paths2[id].setOffset(offset);
-
-               if ( !rc )
-               {    for ( int j = 0; j < n; j++ )
-                         paths2[id][j] = ipaths2[pos][j];    }
-               else
-               {    for ( int j = 0; j < n; j++ )
-                         paths2[id][j] = inv2[ ipaths2[pos][n-j-1] ];    }    }
+          // Each path that was made into a place knows where its place went, so
+          // there's no searching for it.
+          #pragma omp parallel for
+          for ( int64_t b = 0; b < nbatches; b++ )
+          {    int64_t last = Min( (b+1) * batch, (int64_t) paths.size( ) );
+               uint64_t entry = batchEntries[b];
+               for ( int64_t id = b * batch; id < last; id++ )
+               {    const ReadPath& p = paths[id];
+                    if ( !IsPlace( p, edges, K, K2 ) ) continue;
+
+                    // Note that we have more info here: paths[id].getOffset( )
+                    // is the start position of the read on the original path.
+
+                    Bool rc = InverseIsSmaller( p, inv );
+                    long pos = place_of[ entry++ ];
+                    long n = ipaths2[pos].size( );
+
+                    paths2[id].resize(n);
+
+                    int offset;
+                    if ( !rc )
+                         offset = p.getOffset( ) + starts[pos] - left_trunc[pos];
+                    else offset = p.getOffset( ) + stops[pos] - right_trunc[pos];
+                    paths2[id].setOffset(offset);
+
+                    if ( !rc )
+                    {    for ( int j = 0; j < n; j++ )
+                              paths2[id][j] = ipaths2[pos][j];    }
+                    else
+                    {    for ( int j = 0; j < n; j++ )
+                              paths2[id][j] = inv2[ ipaths2[pos][n-j-1] ];    }    }    }
+          PerfLog::lap("TranslatePaths");
      }
 }
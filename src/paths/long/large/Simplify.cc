@@ -18,6 +18,7 @@
 #include "paths/long/large/ImprovePath.h"
 #include "paths/long/large/PullAparter.h"
 #include "paths/long/large/Simplify.h"
+#include "util/PerfLog.h"
 
 void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
               ReadPathVec &paths, const vecbasevector &bases, const VecPQVec &quals,
@@ -28,12 +29,20 @@ void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
               const Bool PULL_APART_VERBOSE, const vec<int> &PULL_APART_TRACE,
               const int DEGLOOP_MODE, const double DEGLOOP_MIN_DIST,
               const Bool IMPROVE_PATHS, const Bool IMPROVE_PATHS_LARGE,
-              const Bool FINAL_TINY, const Bool UNWIND3, const bool RUN_PATHFINDER, const bool dump_pf_files) {
+              const Bool FINAL_TINY, const Bool UNWIND3, const bool RUN_PATHFINDER, const bool dump_pf_files,
+              const BinnedQualVec *bquals) {
+    PerfLog::Scope perf_scope("Simplify");
     // Improve read placements and delete funky pairs.
     std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
     std::cout << "Simplify: rerouting paths" << std::endl;
-    ReroutePaths(hb, inv, paths, bases, quals);
+    ReroutePaths(hb, inv, paths, bases, quals, bquals);
     DeleteFunkyPathPairs(hb, inv, bases, paths, False);
+    PerfLog::lap("ReroutePaths");
+
+    // Through the clean-ups below, the path rewrites they call for are queued
+    // in edits, and only carried out before something that looks at the paths.
+
+    PathEdits edits;
 
     // Remove unsupported edges in certain situations.
     std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
@@ -89,24 +98,28 @@ void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
             }
         }
         hb.DeleteEdges(dels);
-        Cleanup(hb, inv, paths);
+        Cleanup(hb, inv, edits);
     }
+    PerfLog::lap("RemoveUnsupported");
 
     std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
     std::cout << "Simplify: removing small Components" << std::endl;
     // Clean up assembly.
 
     RemoveSmallComponents3(hb);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
 
     if (TAMP_EARLY) {
+        edits.apply(paths);
         std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
         std::cout << "Simplify: Tamping" << std::endl;
         Tamp(hb, inv, paths, 0);
     }
 
     RemoveHangs(hb, inv, paths, 100);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
+    edits.apply(paths);
+    PerfLog::lap("EarlyCleanup");
 
     std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
     std::cout << "Simplify: analysing branches" << std::endl;
@@ -114,80 +127,78 @@ void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
     hb.ToRight(to_right);
 
     AnalyzeBranches(hb, to_right, inv, paths, True, MIN_RATIO2, ANALYZE_BRANCHES_VERBOSE2);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
     RemoveHangs(hb, inv, paths, MAX_DEL2);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
     RemoveSmallComponents3(hb);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
+    edits.apply(paths);
+    PerfLog::lap("AnalyzeBranches");
 
     std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
     std::cout << "Simplify: popping bubbles" << std::endl;
-    PopBubbles(hb, inv, bases, quals, paths);
+    PopBubbles(hb, inv, bases, quals, paths, bquals);
     Cleanup(hb, inv, paths);
 
     DeleteFunkyPathPairs(hb, inv, bases, paths, False);
+    PerfLog::lap("PopBubbles");
 
     std::cout << "Edge count: " << hb.EdgeObjectCount() << " Path count:" << paths.size() << std::endl;
     std::cout << "Simplify: Tamping (700)" << std::endl;
 
     Tamp(hb, inv, paths, 10);
     RemoveHangs(hb, inv, paths, 700);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
     RemoveSmallComponents3(hb);
-    Cleanup(hb, inv, paths);
+    Cleanup(hb, inv, edits);
+    edits.apply(paths);
+    PerfLog::lap("Tamp");
 
-    // Pull apart.
+    // Pull apart.  From here through PathFinder, the edits keep the paths
+    // index up to date, so it's only built once.
 
     {
         std::cout << Date() << ": making paths index for pull apart" << std::endl;
-        VecULongVec invPaths;
-        invert(paths, invPaths, hb.EdgeObjectCount());
+        EdgePathIndex invPaths(paths, hb.EdgeObjectCount());
         std::cout << Date() << ": pulling apart repeats" << std::endl;
         PullAparter pa(hb, inv, paths, invPaths, PULL_APART_TRACE, PULL_APART_VERBOSE, 5, 5.0);
         size_t count = pa.SeparateAll();
         std::cout << Date() << ": there were " << count << " repeats pulled apart." << std::endl;
         std::cout << Date() << ": there were " << pa.getRemovedReadPaths() << " read paths removed during separation."
                   << std::endl;
-    }
-
-    if (RUN_PATHFINDER) {
-        std::cout << Date() << ": making paths index for PathFinder" << std::endl;
-        VecULongVec invPaths;
-        invert(paths, invPaths, hb.EdgeObjectCount());
-        if (dump_pf_files) {
-            BinaryWriter::writeFile(fin_dir + "/pf_start.hbv", hb);
-            //paths.WriteAll(fin_dir + "/pf_start.paths");
-            WriteReadPathVec(paths,(fin_dir + "/pf_start.paths").c_str());
-        }
+        PerfLog::lap("PullApart");
 
-        std::cout << Date() << ": PathFinder: unrolling loops" << std::endl;
-        PathFinder(hb, inv, paths, invPaths).unroll_loops(800);
-        std::cout << "Removing Unneded Vertices" << std::endl;
-        RemoveUnneededVertices2(hb, inv, paths);
-        Cleanup(hb, inv, paths);
+        if (RUN_PATHFINDER) {
+            if (dump_pf_files) {
+                BinaryWriter::writeFile(fin_dir + "/pf_start.hbv", hb);
+                //paths.WriteAll(fin_dir + "/pf_start.paths");
+                WriteReadPathVec(paths,(fin_dir + "/pf_start.paths").c_str());
+            }
 
-        if (dump_pf_files) {
-            BinaryWriter::writeFile(fin_dir + "/pf_unrolled_loops.hbv", hb);
-            //paths.WriteAll(fin_dir + "/pf_unrolled_loops.paths");
-            WriteReadPathVec(paths,(fin_dir + "/pf_unrolled_loops.paths").c_str());
-        }
-        invPaths.clear();
-        invert( paths, invPaths, hb.EdgeObjectCount( ) );
-        std::cout << Date() << ": PathFinder: analysing single-direction repeats" << std::endl;
-        PathFinder(hb, inv, paths, invPaths).untangle_complex_in_out_choices(700);
-        std::cout << "Removing Unneded Vertices" << std::endl;
-        RemoveUnneededVertices2(hb, inv, paths);
-        Cleanup(hb, inv, paths);
+            std::cout << Date() << ": PathFinder: unrolling loops" << std::endl;
+            PathFinder(hb, inv, paths, invPaths).unroll_loops(800);
+            std::cout << "Removing Unneded Vertices" << std::endl;
+            RemoveUnneededVertices2(hb, inv, paths, &invPaths);
+            Cleanup(hb, inv, paths, &invPaths);
 
-        if (dump_pf_files) {
-            BinaryWriter::writeFile(fin_dir + "/pf_end.hbv", hb);
-            //paths.WriteAll(fin_dir + "/pf_end.paths");
-            WriteReadPathVec(paths,(fin_dir + "/pf_end.paths").c_str());
+            if (dump_pf_files) {
+                BinaryWriter::writeFile(fin_dir + "/pf_unrolled_loops.hbv", hb);
+                //paths.WriteAll(fin_dir + "/pf_unrolled_loops.paths");
+                WriteReadPathVec(paths,(fin_dir + "/pf_unrolled_loops.paths").c_str());
+            }
+            std::cout << Date() << ": PathFinder: analysing single-direction repeats" << std::endl;
+            PathFinder(hb, inv, paths, invPaths).untangle_complex_in_out_choices(700);
+            std::cout << "Removing Unneded Vertices" << std::endl;
+            RemoveUnneededVertices2(hb, inv, paths, &invPaths);
+            Cleanup(hb, inv, paths, &invPaths);
+
+            if (dump_pf_files) {
+                BinaryWriter::writeFile(fin_dir + "/pf_end.hbv", hb);
+                //paths.WriteAll(fin_dir + "/pf_end.paths");
+                WriteReadPathVec(paths,(fin_dir + "/pf_end.paths").c_str());
+            }
+            PerfLog::lap("PathFinder");
         }
-
-
-
-
     }
     // Improve paths.
 
@@ -195,7 +206,8 @@ void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
         path_improver pimp;
         vec<int64_t> ids;
         ImprovePaths(paths, hb, inv, bases, quals, ids, pimp,
-                     IMPROVE_PATHS_LARGE, False);
+                     IMPROVE_PATHS_LARGE, False, bquals);
+        PerfLog::lap("ImprovePaths");
     }
 
     // Extend paths.
@@ -204,28 +216,30 @@ void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
         vec<int> to_left;
         hb.ToLeft(to_left), hb.ToRight(to_right);
         int ext = 0;
-        auto qvItr = quals.begin();
-        for (int64_t id = 0; id < (int64_t) paths.size(); id++, ++qvItr) {
+        qvec qv;
+        for (int64_t id = 0; id < (int64_t) paths.size(); id++) {
             Bool verbose = False;
             const int min_gain = 20;
             ReadPath p = paths[id];
-            ExtendPath2(paths[id], id, hb, to_left, to_right, bases[id], *qvItr,
+            UnpackQuals(quals, bquals, id, &qv);
+            ExtendPath2(paths[id], id, hb, to_left, to_right, bases[id], qv,
                         min_gain, verbose, EXT_FINAL_MODE);
             if (p != paths[id]) ext++;
         }
         std::cout << ext << " paths extended" << std::endl;
+        PerfLog::lap("ExtendPaths");
     }
 
     // Degloop.
 
     if (DEGLOOP) {
-        Degloop(DEGLOOP_MODE, hb, inv, paths, bases, quals, DEGLOOP_MIN_DIST);
+        Degloop(DEGLOOP_MODE, hb, inv, paths, bases, quals, DEGLOOP_MIN_DIST, 0, bquals);
         std::cout << Date() << ": removing Hangs" << std::endl;
         RemoveHangs(hb, inv, paths, 700);
         std::cout << Date() << ": cleanup" << std::endl;
         Cleanup(hb, inv, paths);
         std::cout << Date() << ": cleanup finished" << std::endl;
-
+        PerfLog::lap("Degloop");
     }
 
     // Unwind three-edge plasmids.
@@ -240,5 +254,6 @@ void Simplify(const String &fin_dir, HyperBasevector &hb, vec<int> &inv,
         Cleanup(hb, inv, paths);
         CleanupLoops(hb, inv, paths);
         RemoveUnneededVerticesGeneralizedLoops(hb, inv, paths);
+        PerfLog::lap("FinalTiny");
     }
 }
@@ -13,10 +13,12 @@
 // MakeDepend: cflags OMP_FLAGS
 
 #include "CoreTools.h"
+#include "feudal/BinnedQualVec.h"
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
 
+// bquals, if given, stands in for quals, which may then be empty.
 void Simplify( const String& fin_dir, HyperBasevector& hb, vec<int>& inv, 
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
      const int MAX_SUPP_DEL, const Bool TAMP_EARLY, const int MIN_RATIO2, 
@@ -26,6 +28,7 @@ void Simplify( const String& fin_dir, HyperBasevector& hb, vec<int>& inv,
      const Bool PULL_APART_VERBOSE, const vec<int>& PULL_APART_TRACE,
      const int DEGLOOP_MODE, const double DEGLOOP_MIN_DIST, 
      const Bool IMPROVE_PATHS, const Bool IMPROVE_PATHS_LARGE,
-     const Bool FINAL_TINY, const Bool UNWIND3, const bool RUN_PATHFINDER, const bool dump_pf_files );
+     const Bool FINAL_TINY, const Bool UNWIND3, const bool RUN_PATHFINDER, const bool dump_pf_files,
+     const BinnedQualVec* bquals = nullptr );
 
 #endif
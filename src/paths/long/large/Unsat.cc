@@ -16,26 +16,24 @@
 //#include "ParallelVecUtilities.h"
 #include "ParseSet.h"
 #include "VecUtilities.h"
+#include "paths/FrozenHBV.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/MakeKmerStuff.h"
 #include "paths/long/ReadPath.h"
 #include "paths/long/large/Unsat.h"
 #include "system/SortInPlace.h"
 
-vec<int> Nhood( const HyperBasevector& hb, const vec<int>& to_left,
-     const vec<int>& to_right, const int e, const int radius )
+vec<int> Nhood( const FrozenHBV& g, const int e, const int radius )
 {    vec<int> x = {e};
      for ( int r = 0; r < radius; r++ )
      {    vec<int> x2 = x;
           for ( int l = 0; l < x.isize( ); l++ )
-          {    int w = to_right[ x[l] ];
-               for ( int j = 0; j < hb.From(w).isize( ); j++ )
-                    x2.push_back( hb.IFrom( w, j ) );    }
+               for ( int f : g.Next( x[l] ) )
+                    x2.push_back(f);
           x = x2;
           for ( int l = 0; l < x.isize( ); l++ )
-          {    int w = to_left[ x[l] ];
-               for ( int j = 0; j < hb.To(w).isize( ); j++ )
-                    x2.push_back( hb.ITo( w, j ) );    }
+               for ( int f : g.Prev( x[l] ) )
+                    x2.push_back(f);
           x = x2;    }
      UniqueSort(x);
      return x;    }
@@ -121,8 +119,9 @@ void PrintClusters( const vec< vec< std::pair<int,int> > >& xs,
           UniqueSort(all);
           out << printSeq(all) << std::endl;    }    }
 
+template <class PathVec>
 void Unsat( const HyperBasevector& hb, const vec<int>& inv, 
-     const ReadPathVec& paths, vec< vec< std::pair<int,int> > >& xs,
+     const PathVec& paths, vec< vec< std::pair<int,int> > >& xs,
      const String& work_dir, const int A2V )
 {
      std::cout<<Date()<<": Finding unsatisfied path clusters"<<std::endl;
@@ -139,8 +138,7 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
 
      // Set up data structures.
 
-     vec<int> to_left, to_right;
-     hb.ToLeft(to_left), hb.ToRight(to_right);
+     FrozenHBV g(hb);
 
      // Phase 1.  Find unsatisfied links.
 
@@ -148,7 +146,7 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
      vec<Bool> u( paths.size( ) / 2, False );
      #pragma omp parallel for
      for ( int64_t i = 0; i < (int64_t) paths.size( ); i += 2 )
-     {    const ReadPath &p1 = paths[i], &p2 = paths[i+1];
+     {    auto const &p1 = paths[i], &p2 = paths[i+1];
           if ( p1.size( ) == 0 || p2.size( ) == 0 ) continue;
           vec<int> x1, x2;
           for ( int i = 0; i < (int) p1.size( ); i++ )
@@ -156,7 +154,7 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
           for ( int i = ( (int) p2.size( ) ) - 1; i >= 0; i-- )
                x2.push_back( inv[ p2[i] ] );
           if ( Meet2( x1, x2 ) ) continue;
-          int v = to_right[ x1.back( ) ], w = to_left[ x2.front( ) ];
+          int v = g.ToRight( x1.back( ) ), w = g.ToLeft( x2.front( ) );
           if ( v == w ) continue;
           Bool sat = False;
           vec<int> s = {v};
@@ -164,9 +162,8 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
           {    vec<int> s2;
                for ( int l = 0; l < s.isize( ); l++ )
                {    const int x = s[l];
-                    for ( int j = 0; j < hb.From(x).isize( ); j++ )
-                    {    int y = hb.From(x)[j];
-                         if ( y == w )
+                    for ( int y : g.From(x) )
+                    {    if ( y == w )
                          {    sat = True;
                               break;    }
                          else s2.push_back(y);    }
@@ -178,7 +175,7 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
           u[i/2] = True;    }
      for ( int64_t i = 0; i < (int64_t) paths.size( ); i += 2 )
      {    if ( !u[i/2] ) continue;
-          const ReadPath &p1 = paths[i], &p2 = paths[i+1];
+          auto const &p1 = paths[i], &p2 = paths[i+1];
           if ( p1.back( ) == p2.back( ) ) continue;
           unsats[ p1.back( ) ].push( inv[ p2.back( ) ], i/2 );
           unsats[ p2.back( ) ].push( inv[ p1.back( ) ], i/2 );    }
@@ -208,8 +205,9 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
 
      // Form neighborhoods.
      vec<vec<int>> n( hb.EdgeObjectCount( ) );
+     #pragma omp parallel for schedule(dynamic, 10000)
      for ( int e = 0; e < hb.EdgeObjectCount( ); e++ )
-          n[e] = Nhood( hb, to_left, to_right, e, radius );
+          n[e] = Nhood( g, e, radius );
 
      // Form initial clusters.
 
@@ -380,3 +378,10 @@ void Unsat( const HyperBasevector& hb, const vec<int>& inv,
      // Print clusters.
 
      }
+
+template void Unsat( const HyperBasevector& hb, const vec<int>& inv,
+     const ReadPathVec& paths, vec< vec< std::pair<int,int> > >& xs,
+     const String& work_dir, const int A2V );
+template void Unsat( const HyperBasevector& hb, const vec<int>& inv,
+     const MappedReadPathVec& paths, vec< vec< std::pair<int,int> > >& xs,
+     const String& work_dir, const int A2V );
@@ -13,8 +13,10 @@
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
 
+// PathVec is ReadPathVec or MappedReadPathVec.
+template <class PathVec>
 void Unsat( const HyperBasevector& hb, const vec<int>& inv, 
-     const ReadPathVec& paths, vec< vec< std::pair<int,int> > >& xs,
+     const PathVec& paths, vec< vec< std::pair<int,int> > >& xs,
      const String& work_dir, const int A2V );
 
 #endif
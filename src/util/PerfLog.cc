@@ -0,0 +1,238 @@
+//
+// PerfLog.cc: per-phase performance telemetry, written as JSON lines.
+//
+
+#include "util/PerfLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <dirent.h>
+#include <omp.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+bool PerfLog::gOpen = false;
+
+namespace
+{
+
+struct Sample
+{
+    double wall;
+    double user, sys;
+    long rss, hwm; // bytes
+    long rchar, wchar, readBytes, writeBytes;
+    std::vector<std::pair<int,double>> threadCPU; // (tid,seconds), sorted by tid
+};
+
+struct Frame
+{
+    std::string path;
+    Sample start;
+    Sample lapStart;
+    long peak;
+    long lapPeak;
+};
+
+std::ofstream gOut;
+std::vector<Frame> gFrames; // gFrames[0] is the whole run, for laps outside any scope
+double gClockTicks = double(sysconf(_SC_CLK_TCK));
+
+double wallSeconds()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count()*1e-6;
+}
+
+// value of a "Key: value" line in a /proc file, scaled
+void readProcFields( char const* filename, std::vector<std::pair<char const*,long*>> const& fields, long scale )
+{
+    for ( auto const& field : fields ) *field.second = 0;
+    FILE* f = fopen(filename,"r");
+    if ( !f ) return;
+    char line[256];
+    while ( fgets(line,sizeof(line),f) )
+        for ( auto const& field : fields )
+        {   size_t len = strlen(field.first);
+            if ( !strncmp(line,field.first,len) && line[len] == ':' )
+                *field.second = atol(line+len+1)*scale; }
+    fclose(f);
+}
+
+void readThreadCPU( std::vector<std::pair<int,double>>& threadCPU )
+{
+    threadCPU.clear();
+    DIR* dir = opendir("/proc/self/task");
+    if ( !dir ) return;
+    while ( dirent* ent = readdir(dir) )
+    {
+        if ( ent->d_name[0] == '.' ) continue;
+        std::string statName = std::string("/proc/self/task/") + ent->d_name + "/stat";
+        FILE* f = fopen(statName.c_str(),"r");
+        if ( !f ) continue; // thread went away
+        char buf[1024];
+        size_t len = fread(buf,1,sizeof(buf)-1,f);
+        fclose(f);
+        buf[len] = 0;
+        // the command name is in parentheses and may hold anything:  fields count from the last ')'
+        char const* pos = strrchr(buf,')');
+        unsigned long utime, stime;
+        if ( pos && sscanf(pos+2,"%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",&utime,&stime) == 2 )
+            threadCPU.emplace_back(atoi(ent->d_name),(utime+stime)/gClockTicks);
+    }
+    closedir(dir);
+    std::sort(threadCPU.begin(),threadCPU.end());
+}
+
+void takeSample( Sample& sample )
+{
+    sample.wall = wallSeconds();
+    rusage ru;
+    getrusage(RUSAGE_SELF,&ru);
+    sample.user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec*1e-6;
+    sample.sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec*1e-6;
+    readProcFields("/proc/self/status",{{"VmRSS",&sample.rss},{"VmHWM",&sample.hwm}},1024);
+    readProcFields("/proc/self/io",{{"rchar",&sample.rchar},{"wchar",&sample.wchar},
+                                    {"read_bytes",&sample.readBytes},{"write_bytes",&sample.writeBytes}},1);
+    readThreadCPU(sample.threadCPU);
+}
+
+// Folds now into the peak of every open phase.  The kernel's high-water mark is left alone (it's the process
+// peak everyone else reports), so a phase only gets it if it rose since the phase began, which means the peak
+// was reached within the phase; otherwise the phase gets the highest RSS sampled at its boundaries and those of
+// the phases nested in it.
+void foldPeak( Sample const& now )
+{
+    for ( Frame& frame : gFrames )
+    {   frame.peak = std::max(frame.peak,now.hwm > frame.start.hwm ? now.hwm : now.rss);
+        frame.lapPeak = std::max(frame.lapPeak,now.hwm > frame.lapStart.hwm ? now.hwm : now.rss); }
+}
+
+std::string jsonString( std::string const& str )
+{
+    std::string result("\"");
+    for ( char c : str )
+    {
+        if ( c == '"' || c == '\\' ) { result += '\\'; result += c; }
+        else if ( static_cast<unsigned char>(c) < 0x20 )
+        {   char buf[8]; snprintf(buf,sizeof(buf),"\\u%04x",c); result += buf; }
+        else result += c;
+    }
+    return result += '"';
+}
+
+void writeRecord( char const* event, std::string const& path, size_t depth,
+                    Sample const& from, Sample const& to, long peak )
+{
+    std::ostringstream os;
+    os.precision(6);
+    os << std::fixed;
+    char const* name = strrchr(path.c_str(),'/');
+    name = name ? name+1 : path.c_str();
+    os << "{\"event\":" << jsonString(event) << ",\"name\":" << jsonString(name)
+       << ",\"path\":" << jsonString(path) << ",\"depth\":" << depth
+       << ",\"start_s\":" << from.wall-gFrames[0].start.wall
+       << ",\"wall_s\":" << to.wall-from.wall
+       << ",\"cpu_s\":" << (to.user+to.sys)-(from.user+from.sys)
+       << ",\"user_s\":" << to.user-from.user << ",\"sys_s\":" << to.sys-from.sys
+       << ",\"rss_bytes\":" << to.rss << ",\"peak_rss_bytes\":" << peak
+       << ",\"read_bytes\":" << to.rchar-from.rchar << ",\"write_bytes\":" << to.wchar-from.wchar
+       << ",\"disk_read_bytes\":" << to.readBytes-from.readBytes
+       << ",\"disk_write_bytes\":" << to.writeBytes-from.writeBytes
+       << ",\"threads\":" << to.threadCPU.size() << ",\"thread_busy_s\":[";
+    // threads that started during the phase count from 0
+    auto itr = from.threadCPU.begin(), end = from.threadCPU.end();
+    bool first = true;
+    for ( auto const& thread : to.threadCPU )
+    {
+        while ( itr != end && itr->first < thread.first ) ++itr;
+        double busy = thread.second - (itr != end && itr->first == thread.first ? itr->second : 0.);
+        os << (first ? "" : ",") << busy;
+        first = false;
+    }
+    os << "]}\n";
+    gOut << os.str() << std::flush;
+}
+
+}
+
+void PerfLog::open( std::string const& filename )
+{
+    if ( gOpen ) close();
+    gOut.open(filename.c_str(),std::ios::out|std::ios::app);
+    if ( !gOut )
+    {   std::cout << "Warning: can't open " << filename << ", no performance log will be written." << std::endl;
+        return; }
+    gFrames.clear();
+    gFrames.emplace_back();
+    Frame& root = gFrames.back();
+    takeSample(root.start);
+    root.lapStart = root.start;
+    root.peak = root.lapPeak = root.start.rss;
+    std::ostringstream os;
+    os << "{\"event\":\"start\",\"pid\":" << getpid() << ",\"omp_threads\":" << omp_get_max_threads()
+       << ",\"rss_bytes\":" << root.start.rss << "}\n";
+    gOut << os.str() << std::flush;
+    gOpen = true;
+}
+
+void PerfLog::close()
+{
+    if ( !gOpen ) return;
+    while ( gFrames.size() > 1 ) end(gFrames.size());
+    Sample now;
+    takeSample(now);
+    foldPeak(now);
+    writeRecord("run","run",0,gFrames[0].start,now,gFrames[0].peak);
+    gOut.close();
+    gFrames.clear();
+    gOpen = false;
+}
+
+void PerfLog::lap( char const* name )
+{
+    if ( !gOpen || omp_in_parallel() ) return;
+    Frame& frame = gFrames.back();
+    Sample now;
+    takeSample(now);
+    foldPeak(now);
+    std::string path = gFrames.size() > 1 ? frame.path + '/' + name : std::string(name);
+    writeRecord("lap",path,gFrames.size()-1,frame.lapStart,now,frame.lapPeak);
+    frame.lapStart = now;
+    frame.lapPeak = now.rss;
+}
+
+size_t PerfLog::begin( char const* name )
+{
+    if ( omp_in_parallel() ) return 0;
+    Sample now;
+    takeSample(now);
+    foldPeak(now);
+    std::string path = gFrames.size() > 1 ? gFrames.back().path + '/' + name : std::string(name);
+    gFrames.emplace_back();
+    Frame& frame = gFrames.back();
+    frame.path = path;
+    frame.start = frame.lapStart = now;
+    frame.peak = frame.lapPeak = now.rss;
+    return gFrames.size();
+}
+
+void PerfLog::end( size_t depth )
+{
+    // a scope that outlived the log (or the log it was opened in) has nothing to write
+    if ( !gOpen || gFrames.size() != depth ) return;
+    Sample now;
+    takeSample(now);
+    foldPeak(now);
+    Frame const& frame = gFrames.back();
+    writeRecord("scope",frame.path,depth-2,frame.start,now,frame.peak);
+    gFrames.pop_back();
+    Frame& parent = gFrames.back();
+    parent.lapStart = now;
+    parent.lapPeak = now.rss;
+}
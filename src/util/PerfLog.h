@@ -0,0 +1,58 @@
+//
+// PerfLog.h: per-phase performance telemetry, written as JSON lines.
+//
+
+#ifndef W2RAP_CONTIGGER_PERFLOG_H
+#define W2RAP_CONTIGGER_PERFLOG_H
+
+#include <string>
+#include <cstddef>
+
+// Nested, scoped phase timers.  Each phase that ends writes one JSON object per line to the log with its wall
+// time, CPU time (user and system), current and peak RSS, bytes read and written (by syscalls and from disk),
+// and the CPU time each thread of the process spent in it.  Peak RSS is the process's high-water mark
+// if that rose within the phase, otherwise the highest RSS sampled at the boundaries of the phase and its
+// subphases (so a spike in a phase that stays below an earlier peak is missed).
+//
+//     PerfLog::open(out_dir + "/" + out_prefix + ".perf.jsonl");
+//     {   PerfLog::Scope step("step5");
+//         AssembleGaps2(...);            // which may open scopes of its own
+//         PerfLog::lap("AssembleGaps2"); // a phase from the scope's start (or the last lap) to now
+//         ...
+//     }
+//
+// Sampling costs a handful of small /proc reads per phase boundary and nothing at all while no log is open.
+// Scopes and laps are for serial code:  inside a parallel region they're ignored.
+class PerfLog {
+public:
+    // Starts (appending to) a log.  Anything already open is closed first.
+    static void open( std::string const& filename );
+
+    // Logs all open scopes as ending now, innermost first, and closes the log.
+    static void close();
+
+    static bool isOpen() { return gOpen; }
+
+    // Logs the phase since the start of the innermost scope, or since the last lap or nested scope in it.
+    static void lap( char const* name );
+
+    class Scope {
+    public:
+        explicit Scope( char const* name ) : mDepth(gOpen ? begin(name) : 0) {}
+        ~Scope() { if ( mDepth ) end(mDepth); }
+
+        Scope( Scope const& ) = delete;
+        Scope& operator=( Scope const& ) = delete;
+
+    private:
+        size_t mDepth; // 0 if the scope isn't being logged
+    };
+
+private:
+    static size_t begin( char const* name );
+    static void end( size_t depth );
+
+    static bool gOpen;
+};
+
+#endif //W2RAP_CONTIGGER_PERFLOG_H